@@ -14,9 +14,22 @@
 #include "Device.hpp"
 #include "DdmPreferences.hpp"
 #include "IShellOutputReceiver.hpp"
+#include "IRawOutputReceiver.hpp"
 #include "Log.hpp"
 #include "RawImage.hpp"
 #include "AndroidDebugBridge.hpp"
+#include "TransferScheduler.hpp"
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 namespace ddmlib {
 
@@ -28,14 +41,12 @@ AdbHelper::AdbHelper() {
 AdbHelper::~AdbHelper() {
 }
 
-std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::open(const Poco::Net::SocketAddress& adbSockAddr,
+std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::open(const AdbServerAddress& adbSockAddr,
 		std::tr1::shared_ptr<Device> device, int devicePort) {
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	try {
-		adbChan->setNoDelay(true);
-
 		// if the device is not -1, then we first tell adb we're looking to
 		// talk to a specific device
 		setDevice(adbChan, device.get());
@@ -63,12 +74,11 @@ std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::open(const Poco::Net::S
 	return adbChan;
 }
 
-std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::createPassThroughConnection(const Poco::Net::SocketAddress& adbSockAddr,
+std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::createPassThroughConnection(const AdbServerAddress& adbSockAddr,
 		std::tr1::shared_ptr<Device> device, int pid) {
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 	try {
-		adbChan->setNoDelay(true);
 		// if the device is not -1, then we first tell adb we're looking to
 		// talk to a specific device
 		setDevice(adbChan, device.get());
@@ -176,95 +186,95 @@ AdbHelper::AdbResponse AdbHelper::readAdbResponse(std::tr1::shared_ptr<Poco::Net
 	return resp;
 }
 
-std::tr1::shared_ptr<RawImage> AdbHelper::getFrameBuffer(const Poco::Net::SocketAddress& adbSockAddr,
+std::tr1::shared_ptr<RawImage> AdbHelper::getFrameBuffer(const AdbServerAddress& adbSockAddr,
 		std::tr1::shared_ptr<Device> device) {
 
 	std::tr1::shared_ptr<RawImage> imageParams(new RawImage());
+	if (readFrameBuffer(adbSockAddr, device.get(), *imageParams) == false) {
+		return std::tr1::shared_ptr<RawImage>();
+	}
+	return imageParams;
+}
+
+bool AdbHelper::readFrameBuffer(const AdbServerAddress& adbSockAddr, Device* device, RawImage& image) {
 	std::vector<unsigned char> request = formAdbRequest("framebuffer:"); 
-	std::vector<unsigned char> nudge(1,0);
-	std::vector<unsigned char> reply;
+	unsigned char nudge[1] = { 0 };
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	// if the device is not -1, then we first tell adb we're looking to talk
 	// to a specific device
-	setDevice(adbChan, device.get());
+	setDevice(adbChan, device);
 
 	write(adbChan, request);
 
 	AdbResponse resp = readAdbResponse(adbChan, false/*readDiagString*/);
 	if (resp.okay == false) {
-		if (adbChan != nullptr) {
-			adbChan->close();
-		}
+		adbChan->close();
 		throw AdbCommandRejectedException(resp.message);
 	}
 
-	// first the protocol version.
-	reply.resize(4);
-
-	read(adbChan, reply);
+	int timeOut = DdmPreferences::getTimeOut();
 
-	unsigned char temp[4];
-	std::copy(reply.begin(), reply.end(), temp);
+	// first the protocol version.
+	unsigned char versionBytes[4];
+	read(adbChan, versionBytes, 4, timeOut);
 
-	std::tr1::shared_ptr<ByteBuffer> buf(ByteBuffer::wrap(temp, 4));
+	std::tr1::shared_ptr<ByteBuffer> buf(ByteBuffer::wrap(versionBytes, 4));
 	buf->setSwapEndianness(false);
 
 	int version = buf->getInt();
 
 	// get the header size (this is a count of int)
 	int headerSize = RawImage::getHeaderSize(version);
+	if (headerSize <= 0) {
+		adbChan->close();
+		Log::e("Screenshot", "Unsupported protocol: " + Poco::NumberFormatter::format(version));
+		return false;
+	}
 
-	// read the header
-	reply.resize(headerSize * 4);
-
-	read(adbChan, reply);
-
-	unsigned char *temp2 = new unsigned char[headerSize * 4];
-	std::copy(reply.begin(), reply.end(), temp2);
+	// read the header. The buffer only wraps the vector, which owns the memory.
+	std::vector<unsigned char> header(headerSize * 4);
+	read(adbChan, &header[0], (int) header.size(), timeOut);
 
-	buf = std::tr1::shared_ptr<ByteBuffer>(ByteBuffer::wrap(temp2, headerSize * 4));
+	buf = std::tr1::shared_ptr<ByteBuffer>(ByteBuffer::wrap(&header[0], header.size()));
 	buf->setSwapEndianness(false);
 
 	// fill the RawImage with the header
-	if (imageParams->readHeader(version, buf) == false) {
-
-		if (adbChan != nullptr) {
-			adbChan->close();
-		}
+	if (image.readHeader(version, buf) == false) {
+		adbChan->close();
 		Log::e("Screenshot", "Unsupported protocol: " + Poco::NumberFormatter::format(version));
-		return std::tr1::shared_ptr<RawImage>();
+		return false;
 	}
-	delete []temp2;
 
 	Log::d("ddms",
-			"image params: bpp=" + Poco::NumberFormatter::format(imageParams->bpp) + ", size="
-					+ Poco::NumberFormatter::format(imageParams->size) + ", width="
-					+ Poco::NumberFormatter::format(imageParams->width) + ", height="
-					+ Poco::NumberFormatter::format(imageParams->height));
-
-	write(adbChan, nudge);
+			"image params: bpp=" + Poco::NumberFormatter::format(image.bpp) + ", size="
+					+ Poco::NumberFormatter::format(image.size) + ", width="
+					+ Poco::NumberFormatter::format(image.width) + ", height="
+					+ Poco::NumberFormatter::format(image.height));
 
-	imageParams->data.resize(imageParams->size);
-	read(adbChan, imageParams->data);
+	write(adbChan, nudge, 1, timeOut);
 
-	if (adbChan != nullptr) {
-		adbChan->close();
+	// no-op if the size didn't change since the last frame read into this image.
+	image.data.resize(image.size);
+	if (image.size > 0) {
+		read(adbChan, &image.data[0], image.size, timeOut);
 	}
-	return imageParams;
+
+	adbChan->close();
+	return true;
 }
 
-void AdbHelper::executeRemoteCommand(const Poco::Net::SocketAddress& adbSockAddr, const std::string& command,
+void AdbHelper::executeRemoteCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
 		std::tr1::shared_ptr<Device> device, std::tr1::shared_ptr<IShellOutputReceiver> rcvr, int maxTimeToOutputResponse) {
 	executeRemoteCommand(adbSockAddr, command, device.get(), rcvr.get(), maxTimeToOutputResponse);
 }
 
-void AdbHelper::executeRemoteCommand(const Poco::Net::SocketAddress& adbSockAddr, const std::string& command,
+void AdbHelper::executeRemoteCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
 		Device *device, IShellOutputReceiver *rcvr, int maxTimeToOutputResponse) {
 	Log::v("ddms", "execute: running " + command);
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	Poco::Timespan::TimeDiff timeout(maxTimeToOutputResponse * 1000);
 	adbChan->setReceiveTimeout(timeout);
@@ -346,24 +356,109 @@ void AdbHelper::executeRemoteCommand(const Poco::Net::SocketAddress& adbSockAddr
 	}
 }
 
-void AdbHelper::runEventLogService(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
+std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbHelper::openExecChannel(const AdbServerAddress& adbSockAddr,
+		const std::string& command, Device *device) {
+	Log::v("ddms", "exec: running " + command);
+
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
+
+	try {
+		// if the device is not -1, then we first tell adb we're looking to
+		// talk to a specific device
+		setDevice(adbChan, device);
+
+		std::vector<unsigned char> request = formAdbRequest("exec:" + command);
+		write(adbChan, request);
+
+		AdbResponse resp = readAdbResponse(adbChan, false /* readDiagString */);
+		if (resp.okay == false) {
+			Log::e("ddms", "ADB rejected exec command (" + command + "): " + resp.message);
+			throw AdbCommandRejectedException(resp.message);
+		}
+	} catch (...) {
+		adbChan->close();
+		throw;
+	}
+
+	return adbChan;
+}
+
+void AdbHelper::executeRawCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
+		std::tr1::shared_ptr<Device> device, std::tr1::shared_ptr<IRawOutputReceiver> rcvr, int maxTimeToOutputResponse) {
+	executeRawCommand(adbSockAddr, command, device.get(), rcvr.get(), maxTimeToOutputResponse);
+}
+
+void AdbHelper::executeRawCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
+		Device *device, IRawOutputReceiver *rcvr, int maxTimeToOutputResponse) {
+	// the stream can't be half-closed: adb ends the command as soon as our side is shut down.
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan = openExecChannel(adbSockAddr, command, device);
+
+	bool eof = false;
+	try {
+		eof = pumpRawOutput(adbChan, rcvr, maxTimeToOutputResponse);
+	} catch (...) {
+		adbChan->close();
+		throw;
+	}
+	adbChan->close();
+
+	if (eof == false) {
+		Log::v("ddms", "exec '" + command + "': stopped before EOF");
+	}
+}
+
+bool AdbHelper::pumpRawOutput(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, IRawOutputReceiver *rcvr,
+		int maxTimeToOutputResponse) {
+	// a real blocking read: no spin-wait, the timeout is the time allowed between two blocks.
+	chan->setReceiveTimeout(Poco::Timespan((Poco::Timespan::TimeDiff) maxTimeToOutputResponse * 1000));
+
+	std::vector<unsigned char> buf(RAW_BUFFER_SIZE);
+	while (true) {
+		if (rcvr != nullptr && rcvr->isCancelled()) {
+			Log::v("ddms", "exec: cancelled");
+			return false;
+		}
+
+		int count = 0;
+		try {
+			count = chan->receiveBytes(&buf[0], RAW_BUFFER_SIZE);
+		} catch (Poco::TimeoutException& e) {
+			Log::v("ddms", "exec: returning due to timeout exceed");
+			return false;
+		}
+
+		if (count <= 0) {
+			// graceful shutdown, the command is done.
+			if (rcvr != nullptr) {
+				rcvr->done();
+			}
+			return true;
+		}
+
+		if (rcvr != nullptr) {
+			rcvr->addOutput(&buf[0], count);
+		}
+	}
+}
+
+void AdbHelper::runEventLogService(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
 		std::tr1::shared_ptr<LogReceiver> rcvr) {
 	runEventLogService(adbSockAddr, device.get(), rcvr.get());
 }
 
-void AdbHelper::runEventLogService(const Poco::Net::SocketAddress& adbSockAddr, Device *device, LogReceiver *rcvr) {
+void AdbHelper::runEventLogService(const AdbServerAddress& adbSockAddr, Device *device, LogReceiver *rcvr) {
 	runLogService(adbSockAddr, device, "events", rcvr);
 }
 
-void AdbHelper::runLogService(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
+void AdbHelper::runLogService(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
 		const std::string& logName, std::tr1::shared_ptr<LogReceiver> rcvr) {
 	runLogService(adbSockAddr, device.get(), logName, rcvr.get());
 }
 
-void AdbHelper::runLogService(const Poco::Net::SocketAddress& adbSockAddr, Device *device,
+void AdbHelper::runLogService(const AdbServerAddress& adbSockAddr, Device *device,
 		const std::string& logName, LogReceiver *rcvr) {
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	// if the device is not -1, then we first tell adb we're looking to talk
 	// to a specific device
@@ -380,8 +475,12 @@ void AdbHelper::runLogService(const Poco::Net::SocketAddress& adbSockAddr, Devic
 		throw AdbCommandRejectedException(resp.message);
 	}
 
-	const int length = 16384;
-	unsigned char buf[length];
+	// a live log is interactive: bulk transfers to the device make way for it.
+	std::tr1::shared_ptr<TransferScheduler> scheduler;
+	if (device != nullptr) {
+		scheduler = device->getTransferScheduler();
+	}
+
 	while (true) {
 		int count = 0;
 
@@ -390,12 +489,15 @@ void AdbHelper::runLogService(const Poco::Net::SocketAddress& adbSockAddr, Devic
 			break;
 		}
 		try {
+			// receive straight into the blocks of the receiver, where the entries are parsed.
+			int length = 0;
+			unsigned char* buf = rcvr->getReceiveBuffer(length);
 			count = adbChan->receiveBytes(buf, length);
 			if (count > 0) {
-							// send data to receiver if present
-							if (rcvr != nullptr) {
-								rcvr->parseNewData(buf, 0, count);
-							}
+				if (scheduler != nullptr) {
+					scheduler->record(TransferScheduler::PRIORITY_INTERACTIVE, (unsigned int) count);
+				}
+				rcvr->commitReceived(count);
 			} else if (count < 0) {
                 Log::v("ddms", "Log service '" + logName + "' on '" + device->toString() + "' : EOF hit. Read: "
                         + Poco::NumberFormatter::format(count));
@@ -418,10 +520,10 @@ void AdbHelper::runLogService(const Poco::Net::SocketAddress& adbSockAddr, Devic
 	}
 }
 
-void AdbHelper::createForward(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
+void AdbHelper::createForward(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
 		int remotePort) {
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	std::vector<unsigned char> request = formAdbRequest(
 			"host-serial:" + device->getSerialNumber() + ":forward:tcp:" + Poco::NumberFormatter::format(localPort)
@@ -439,10 +541,10 @@ void AdbHelper::createForward(const Poco::Net::SocketAddress& adbSockAddr, std::
 	}
 }
 
-void AdbHelper::removeForward(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
+void AdbHelper::removeForward(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
 		int remotePort) {
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	std::vector<unsigned char> request = formAdbRequest(
 			"host-serial:" + device->getSerialNumber() + ":killforward:tcp:" + Poco::NumberFormatter::format(localPort)
@@ -509,6 +611,21 @@ void AdbHelper::read(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, std::ve
 	delete []temp;
 }
 
+void AdbHelper::read(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, unsigned char* data, int length,
+		int timeout) {
+	chan->setReceiveTimeout(Poco::Timespan(timeout * 1000));
+
+	int received = 0;
+	while (received < length) {
+		int count = chan->receiveBytes(data + received, length - received);
+		if (count <= 0) {
+			Log::d("ddms", "read: channel EOF");
+			throw Poco::IOException("channel EOF");
+		}
+		received += count;
+	}
+}
+
 void AdbHelper::write(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const std::vector<unsigned char>& data) {
 	write(chan, data, -1, DdmPreferences::getTimeOut());
 }
@@ -540,6 +657,94 @@ void AdbHelper::write(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const
 
 }
 
+void AdbHelper::write(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const unsigned char* data, int length,
+		int timeout) {
+	chan->setSendTimeout(Poco::Timespan(timeout * 1000));
+
+	int sent = 0;
+	while (sent < length) {
+		int count = chan->sendBytes(data + sent, length - sent);
+		if (count < 0) {
+			Log::d("ddms", "write: channel EOF");
+			throw Poco::IOException("channel EOF");
+		}
+		sent += count;
+	}
+}
+
+#ifndef _WIN32
+void AdbHelper::writeFileRegion(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const unsigned char* header,
+		int headerLength, int fd, long long offset, int length, int timeout) {
+#ifdef __linux__
+	chan->setSendTimeout(Poco::Timespan(timeout * 1000));
+	int sockfd = chan->impl()->sockfd();
+
+	int sent = 0;
+	while (sent < headerLength) {
+		ssize_t count = ::send(sockfd, header + sent, headerLength - sent, MSG_MORE | MSG_NOSIGNAL);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				throw Poco::TimeoutException("write: timeout");
+			}
+			throw Poco::IOException(std::string("write: ") + strerror(errno));
+		}
+		sent += count;
+	}
+
+	off_t position = (off_t) offset;
+	int remaining = length;
+	while (remaining > 0) {
+		ssize_t count = ::sendfile(sockfd, fd, &position, remaining);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno == EINVAL || errno == ENOSYS) && remaining == length) {
+				// sendfile can't be used with this socket/file pair, copy the data instead.
+				break;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				throw Poco::TimeoutException("write: timeout");
+			}
+			throw Poco::IOException(std::string("sendfile: ") + strerror(errno));
+		}
+		if (count == 0) {
+			throw Poco::IOException("sendfile: unexpected end of file");
+		}
+		remaining -= count;
+	}
+	if (remaining == 0) {
+		return;
+	}
+	// the header is already out.
+	headerLength = 0;
+#endif
+
+	std::vector<unsigned char> buffer(headerLength + length);
+	std::copy(header, header + headerLength, buffer.begin());
+
+	int filled = 0;
+	while (filled < length) {
+		ssize_t count = ::pread(fd, &buffer[headerLength + filled], length - filled, (off_t) (offset + filled));
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw Poco::IOException(std::string("pread: ") + strerror(errno));
+		}
+		if (count == 0) {
+			throw Poco::IOException("pread: unexpected end of file");
+		}
+		filled += count;
+	}
+
+	write(chan, &buffer[0], (int) buffer.size(), timeout);
+}
+#endif
+
 void AdbHelper::setDevice(std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan, Device *device) {
 	// if the device is not -1, then we first tell adb we're looking to talk
 	// to a specific device
@@ -556,7 +761,7 @@ void AdbHelper::setDevice(std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan,
 	}
 }
 
-void AdbHelper::reboot(const std::string &into, const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device) {
+void AdbHelper::reboot(const std::string &into, const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device) {
 	std::vector<unsigned char> request;
 	if (into.empty()) {
 		request = formAdbRequest("reboot:"); 
@@ -564,7 +769,7 @@ void AdbHelper::reboot(const std::string &into, const Poco::Net::SocketAddress&
 		request = formAdbRequest("reboot:" + into); 
 	}
 
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(adbSockAddr));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(adbSockAddr.connect());
 
 	// if the device is not -1, then we first tell adb we're looking to talk
 	// to a specific device
@@ -578,7 +783,7 @@ void AdbHelper::reboot(const std::string &into, const Poco::Net::SocketAddress&
 }
 
 void AdbHelper::restartInTcpip(std::tr1::shared_ptr<Device> device, int port) {
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(AndroidDebugBridge::getSocketAddress()));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(device->getServerAddress().connect());
 
 	std::vector<unsigned char> request = formAdbRequest("tcpip:" + Poco::NumberFormatter::format(port));
 	setDevice(adbChan, device.get());
@@ -594,7 +799,7 @@ void AdbHelper::restartInTcpip(std::tr1::shared_ptr<Device> device, int port) {
 }
 
 void AdbHelper::restartInUSB(std::tr1::shared_ptr<Device> device) {
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(AndroidDebugBridge::getSocketAddress()));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(device->getServerAddress().connect());
 
 	std::vector<unsigned char> request = formAdbRequest("usb:");
 	setDevice(adbChan, device.get());
@@ -610,7 +815,7 @@ void AdbHelper::restartInUSB(std::tr1::shared_ptr<Device> device) {
 }
 
 std::string AdbHelper::connectToNetworkDevice(const std::string &address) {
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(AndroidDebugBridge::getSocketAddress()));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(AndroidDebugBridge::getSocketAddress().connect());
 
 	std::vector<unsigned char> request = formAdbRequest("host:connect:" + address);
 	write(adbChan, request);
@@ -626,7 +831,7 @@ std::string AdbHelper::connectToNetworkDevice(const std::string &address) {
 }
 
 std::string AdbHelper::disconnectFromNetworkDevice(const std::string &address) {
-	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(new Poco::Net::StreamSocket(AndroidDebugBridge::getSocketAddress()));
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChan(AndroidDebugBridge::getSocketAddress().connect());
 
 	std::vector<unsigned char> request = formAdbRequest("host:disconnect:" + address);
 	write(adbChan, request);
@@ -8,12 +8,14 @@
 #ifndef ADBHELPER_HPP_
 #define ADBHELPER_HPP_
 #include "ddmlib.hpp"
+#include "AdbServerAddress.hpp"
 
 namespace ddmlib {
 
 class Device;
 class LogReceiver;
 class IShellOutputReceiver;
+class IRawOutputReceiver;
 class RawImage;
 
 class DDMLIB_API AdbHelper {
@@ -21,6 +23,7 @@ public:
 	// public static final long kOkay = 0x59414b4fL;
 	// public static final long kFail = 0x4c494146L;
 	const static int WAIT_TIME = 5; // spin-wait sleep, in ms
+	const static int RAW_BUFFER_SIZE = 64 * 1024; // read size for exec: streams
 	const static std::string DEFAULT_ENCODING;
 
 	struct AdbResponse {
@@ -45,7 +48,7 @@ public:
 	 * @throws IOException in case of I/O error on the connection.
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 */
-	static std::tr1::shared_ptr<Poco::Net::StreamSocket> open(const Poco::Net::SocketAddress& adbSockAddr,
+	static std::tr1::shared_ptr<Poco::Net::StreamSocket> open(const AdbServerAddress& adbSockAddr,
 			std::tr1::shared_ptr<Device> device, int devicePort);
 
 	/**
@@ -60,7 +63,7 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static std::tr1::shared_ptr<Poco::Net::StreamSocket> createPassThroughConnection(const Poco::Net::SocketAddress& adbSockAddr,
+	static std::tr1::shared_ptr<Poco::Net::StreamSocket> createPassThroughConnection(const AdbServerAddress& adbSockAddr,
 			std::tr1::shared_ptr<Device> device, int pid);
 
 	/**
@@ -104,9 +107,20 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static std::tr1::shared_ptr<RawImage> getFrameBuffer(const Poco::Net::SocketAddress& adbSockAddr,
+	static std::tr1::shared_ptr<RawImage> getFrameBuffer(const AdbServerAddress& adbSockAddr,
 			std::tr1::shared_ptr<Device> device);
 
+	/**
+	 * Retrieve the frame buffer from the device into an existing image.
+	 * <p/>The pixels are read from the connection straight into the data of
+	 * <var>image</var>, which is only reallocated if the frame size changed.
+	 * @return false if the framebuffer protocol of the device is not supported.
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws AdbCommandRejectedException if adb rejects the command
+	 * @throws IOException in case of I/O error on the connection.
+	 */
+	static bool readFrameBuffer(const AdbServerAddress& adbSockAddr, Device* device, RawImage& image);
+
 	/**
 	 * Executes a shell command on the device and retrieve the output. The output is
 	 * handed to <var>rcvr</var> as it arrives.
@@ -128,11 +142,62 @@ public:
 	 *
 	 * @see DdmPreferences#getTimeOut()
 	 */
-	static void executeRemoteCommand(const Poco::Net::SocketAddress& adbSockAddr, const std::string& command,
+	static void executeRemoteCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
 			std::tr1::shared_ptr<Device> device, std::tr1::shared_ptr<IShellOutputReceiver> rcvr, int maxTimeToOutputResponse);
-	static void executeRemoteCommand(const Poco::Net::SocketAddress& adbSockAddr, const std::string& command,
+	static void executeRemoteCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
 			Device *device, IShellOutputReceiver *rcvr, int maxTimeToOutputResponse);
 
+	/**
+	 * Opens a connection running <var>command</var> through the <code>exec:</code> service.
+	 * <p/>Contrary to <code>shell:</code>, <code>exec:</code> does not allocate a PTY on the
+	 * device, so the stream is binary-clean in both directions. The returned socket can be
+	 * written to (the command's stdin) and read from (its stdout) until either side closes it.
+	 * <p/>adb doesn't support half-closed streams: shutting down the sending side closes the
+	 * stream and kills the command, with its output cut off.
+	 *
+	 * @param adbSockAddr the socket address to connect to adb
+	 * @param command the command to execute
+	 * @param device the {@link Device} on which to execute the command.
+	 * @throws TimeoutException in case of timeout on the connection when sending the command.
+	 * @throws AdbCommandRejectedException if adb rejects the command
+	 * @throws IOException in case of I/O error on the connection.
+	 */
+	static std::tr1::shared_ptr<Poco::Net::StreamSocket> openExecChannel(const AdbServerAddress& adbSockAddr,
+			const std::string& command, Device *device);
+
+	/**
+	 * Executes a command on the device through the <code>exec:</code> service and hands the
+	 * raw output to <var>rcvr</var> as it arrives.
+	 * <p/>This call is blocking until the command finishes, <var>rcvr</var> is cancelled or
+	 * no output was received for <var>maxTimeToOutputResponse</var> ms.
+	 * <p/>The stdin of the command stays open and never sees EOF: commands reading their input
+	 * must redirect it, as in <code>cmd &lt;/dev/null</code>.
+	 *
+	 * @param adbSockAddr the socket address to connect to adb
+	 * @param command the command to execute
+	 * @param device the {@link Device} on which to execute the command.
+	 * @param rcvr the {@link IRawOutputReceiver} that will receive the output of the command
+	 * @param maxTimeToOutputResponse max time between command output. A value of 0 means the
+	 *            method will wait forever for command output.
+	 * @throws TimeoutException in case of timeout on the connection when sending the command.
+	 * @throws AdbCommandRejectedException if adb rejects the command
+	 * @throws IOException in case of I/O error on the connection.
+	 */
+	static void executeRawCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
+			std::tr1::shared_ptr<Device> device, std::tr1::shared_ptr<IRawOutputReceiver> rcvr, int maxTimeToOutputResponse);
+	static void executeRawCommand(const AdbServerAddress& adbSockAddr, const std::string& command,
+			Device *device, IRawOutputReceiver *rcvr, int maxTimeToOutputResponse);
+
+	/**
+	 * Reads <var>chan</var> until EOF, handing every block to <var>rcvr</var>.
+	 * @param chan a connected stream, e.g. one returned by {@link #openExecChannel}.
+	 * @param rcvr the receiver of the data. Can be null, in which case the data is dropped.
+	 * @param maxTimeToOutputResponse max time between two blocks of data, in ms. 0 waits forever.
+	 * @return true if EOF was reached, false if the read was cancelled or timed out.
+	 */
+	static bool pumpRawOutput(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, IRawOutputReceiver *rcvr,
+			int maxTimeToOutputResponse);
+
 	/**
 	 * Runs the Event log service on the {@link Device}, and provides its output to the
 	 * {@link LogReceiver}.
@@ -144,9 +209,9 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static void runEventLogService(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
+	static void runEventLogService(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
 			std::tr1::shared_ptr<LogReceiver> rcvr);
-	static void runEventLogService(const Poco::Net::SocketAddress& adbSockAddr, Device *device,
+	static void runEventLogService(const AdbServerAddress& adbSockAddr, Device *device,
 			LogReceiver *rcvr);
 
 	/**
@@ -160,9 +225,9 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static void runLogService(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
+	static void runLogService(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device,
 			const std::string& logName, std::tr1::shared_ptr<LogReceiver> rcvr);
-	static void runLogService(const Poco::Net::SocketAddress& adbSockAddr, Device *device,
+	static void runLogService(const AdbServerAddress& adbSockAddr, Device *device,
 					const std::string& logName, LogReceiver *rcvr);
 
 	/**
@@ -175,7 +240,7 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static void createForward(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
+	static void createForward(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
 			int remotePort);
 
 	/**
@@ -188,7 +253,7 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static void removeForward(const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
+	static void removeForward(const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device, int localPort,
 			int remotePort);
 
 	/**
@@ -230,6 +295,18 @@ public:
 	static void read(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, std::vector<unsigned char>& data, int length,
 			int timeout);
 
+	/**
+	 * Reads exactly <var>length</var> bytes into <var>data</var>, without intermediate copy.
+	 * @param chan the opened socket to read from.
+	 * @param data the buffer to store the read data into, at least <var>length</var> long.
+	 * @param length the number of bytes to read.
+	 * @param timeout The timeout value. A timeout of zero means "wait forever".
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws IOException in case of I/O error on the connection, or if it closed early.
+	 */
+	static void read(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, unsigned char* data, int length,
+			int timeout);
+
 	/**
 	 * Write until all data in "data" is written or the connection fails or times out.
 	 * <p/>This uses the default time out value.
@@ -254,6 +331,41 @@ public:
 	static void write(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const std::vector<unsigned char>& data, int length,
 			int timeout);
 
+	/**
+	 * Write until <var>length</var> bytes starting at <var>data</var> are written. Unlike the
+	 * vector versions, the data is sent in place without an intermediate copy.
+	 * @param chan the opened socket to write to.
+	 * @param data the bytes to send.
+	 * @param length the number of bytes to send.
+	 * @param timeout The timeout value. A timeout of zero means "wait forever".
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws IOException in case of I/O error on the connection.
+	 */
+	static void write(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const unsigned char* data, int length,
+			int timeout);
+
+#ifndef _WIN32
+	/**
+	 * Writes a frame header followed by a region of a file.
+	 * <p/>On Linux the file data is moved by the kernel with sendfile(2), the header being
+	 * corked so that both leave in the same segment. Elsewhere (or if sendfile is not supported
+	 * for this socket) the region is read with pread(2) right behind the header and sent with
+	 * a single write.
+	 * @param chan the opened socket to write to.
+	 * @param header the frame header.
+	 * @param headerLength the length of the header.
+	 * @param fd a file descriptor opened for reading.
+	 * @param offset the offset of the region in the file.
+	 * @param length the length of the region.
+	 * @param timeout The timeout value. A timeout of zero means "wait forever".
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws IOException in case of I/O error on the connection or the file, or if the file
+	 *      is shorter than expected.
+	 */
+	static void writeFileRegion(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, const unsigned char* header,
+			int headerLength, int fd, long long offset, int length, int timeout);
+#endif
+
 	/**
 	 * tells adb to talk to a specific device
 	 *
@@ -273,7 +385,7 @@ public:
 	 * @throws AdbCommandRejectedException if adb rejects the command
 	 * @throws IOException in case of I/O error on the connection.
 	 */
-	static void reboot(const std::string &into, const Poco::Net::SocketAddress& adbSockAddr, std::tr1::shared_ptr<Device> device);
+	static void reboot(const std::string &into, const AdbServerAddress& adbSockAddr, std::tr1::shared_ptr<Device> device);
 
 
 	/**
@@ -0,0 +1,147 @@
+/*
+ * AdbServerAddress.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "AdbServerAddress.hpp"
+#include <Poco\Net\StreamSocketImpl.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#endif
+
+namespace ddmlib {
+
+AdbServerAddress::AdbServerAddress() :
+		mKind(TCP) {
+}
+
+AdbServerAddress::AdbServerAddress(const Poco::Net::SocketAddress &address) :
+		mKind(TCP), mSocketAddress(address) {
+}
+
+AdbServerAddress::AdbServerAddress(Kind kind, const std::string &path) :
+		mKind(kind), mPath(path) {
+	if (kind == TCP) {
+		throw std::invalid_argument("A TCP adb server address needs a socket address");
+	}
+}
+
+AdbServerAddress AdbServerAddress::parse(const std::string &spec, const std::string &defaultHost) {
+	std::string::size_type colon = spec.find(':');
+	if (colon == std::string::npos || colon + 1 == spec.length()) {
+		throw std::invalid_argument("Unsupported adb server socket '" + spec + "'");
+	}
+
+	std::string scheme = spec.substr(0, colon);
+	std::string rest = spec.substr(colon + 1);
+
+	if (scheme == "localfilesystem" || scheme == "local") {
+		return AdbServerAddress(LOCAL_FILESYSTEM, rest);
+	}
+	if (scheme == "localabstract") {
+		return AdbServerAddress(LOCAL_ABSTRACT, rest);
+	}
+	if (scheme == "tcp") {
+		std::string host = defaultHost;
+		std::string port = rest;
+		std::string::size_type portColon = rest.rfind(':');
+		if (portColon != std::string::npos) {
+			host = rest.substr(0, portColon);
+			port = rest.substr(portColon + 1);
+		}
+		unsigned int portValue = 0;
+		if (!Poco::NumberParser::tryParseUnsigned(port, portValue) || portValue == 0 || portValue > 0xFFFF) {
+			throw std::invalid_argument("Illegal adb server port in '" + spec + "'");
+		}
+		return AdbServerAddress(Poco::Net::SocketAddress(host, (Poco::UInt16) portValue));
+	}
+
+	throw std::invalid_argument("Unsupported adb server socket '" + spec + "'");
+}
+
+std::tr1::shared_ptr<Poco::Net::StreamSocket> AdbServerAddress::connect() const {
+	if (mKind == TCP) {
+		std::tr1::shared_ptr<Poco::Net::StreamSocket> socket(new Poco::Net::StreamSocket(mSocketAddress));
+		socket->setNoDelay(true);
+		return socket;
+	}
+
+#ifndef _WIN32
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	// the abstract namespace is denoted by a leading NUL byte.
+	size_t prefix = (mKind == LOCAL_ABSTRACT) ? 1 : 0;
+	if (mPath.length() + prefix >= sizeof(addr.sun_path)) {
+		throw Poco::InvalidArgumentException("Unix socket path too long", mPath);
+	}
+	memcpy(addr.sun_path + prefix, mPath.data(), mPath.length());
+	socklen_t addrLen = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + prefix + mPath.length());
+	if (mKind == LOCAL_FILESYSTEM) {
+		++addrLen; // include the terminating NUL
+	}
+
+	int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		throw Poco::IOException("Unable to create unix socket", errno);
+	}
+	if (::connect(fd, (struct sockaddr*) &addr, addrLen) != 0) {
+		int err = errno;
+		::close(fd);
+		throw Poco::Net::ConnectionRefusedException(toString(), err);
+	}
+
+	// the socket takes ownership of the implementation, which takes ownership of the fd.
+	return std::tr1::shared_ptr<Poco::Net::StreamSocket>(
+			new Poco::Net::StreamSocket(new Poco::Net::StreamSocketImpl(fd)));
+#else
+	throw Poco::NotImplementedException("Unix domain sockets are not supported on this platform", toString());
+#endif
+}
+
+std::string AdbServerAddress::toString() const {
+	switch (mKind) {
+	case LOCAL_FILESYSTEM:
+		return "localfilesystem:" + mPath;
+	case LOCAL_ABSTRACT:
+		return "localabstract:" + mPath;
+	default:
+		return "tcp:" + mSocketAddress.toString();
+	}
+}
+
+bool AdbServerAddress::operator==(const AdbServerAddress &other) const {
+	if (mKind != other.mKind) {
+		return false;
+	}
+	if (mKind == TCP) {
+		return mSocketAddress.host() == other.mSocketAddress.host()
+				&& mSocketAddress.port() == other.mSocketAddress.port();
+	}
+	return mPath == other.mPath;
+}
+
+bool AdbServerAddress::operator<(const AdbServerAddress &other) const {
+	if (mKind != other.mKind) {
+		return mKind < other.mKind;
+	}
+	if (mKind == TCP) {
+		if (mSocketAddress.port() != other.mSocketAddress.port()) {
+			return mSocketAddress.port() < other.mSocketAddress.port();
+		}
+		return mSocketAddress.host().toString() < other.mSocketAddress.host().toString();
+	}
+	return mPath < other.mPath;
+}
+
+} /* namespace ddmlib */
@@ -0,0 +1,99 @@
+/*
+ * AdbServerAddress.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef ADBSERVERADDRESS_HPP_
+#define ADBSERVERADDRESS_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+/**
+ * Endpoint of an adb host server.
+ * <p/>adb can listen either on a TCP port (the default, localhost:5037) or on a Unix domain
+ * socket. This class hides the difference from the code connecting to the server: every
+ * connection to adb is created through {@link #connect()}.
+ * <p/>The textual form is the one adb itself uses for <code>ADB_SERVER_SOCKET</code>:
+ * <ul>
+ * <li><code>tcp:&lt;port&gt;</code> or <code>tcp:&lt;host&gt;:&lt;port&gt;</code></li>
+ * <li><code>localfilesystem:&lt;path&gt;</code> (or <code>local:&lt;path&gt;</code>)</li>
+ * <li><code>localabstract:&lt;name&gt;</code> (Linux abstract namespace)</li>
+ * </ul>
+ */
+class DDMLIB_API AdbServerAddress {
+public:
+	enum Kind {
+		TCP, LOCAL_FILESYSTEM, LOCAL_ABSTRACT
+	};
+
+	AdbServerAddress();
+
+	/**
+	 * Creates a TCP endpoint. Not explicit, so a {@link Poco::Net::SocketAddress} can be used
+	 * anywhere an {@link AdbServerAddress} is expected.
+	 */
+	AdbServerAddress(const Poco::Net::SocketAddress &address);
+
+	/**
+	 * Creates a Unix domain socket endpoint.
+	 * @param kind {@link #LOCAL_FILESYSTEM} or {@link #LOCAL_ABSTRACT}
+	 * @param path the socket path, or name in the abstract namespace.
+	 */
+	AdbServerAddress(Kind kind, const std::string &path);
+
+	/**
+	 * Parses an <code>ADB_SERVER_SOCKET</code> style specification.
+	 * @param spec the specification.
+	 * @param defaultHost the host used for <code>tcp:&lt;port&gt;</code>.
+	 * @throws invalid_argument if the specification can't be parsed.
+	 */
+	static AdbServerAddress parse(const std::string &spec, const std::string &defaultHost);
+
+	Kind getKind() const {
+		return mKind;
+	}
+
+	bool isLocal() const {
+		return mKind != TCP;
+	}
+
+	/**
+	 * Returns the TCP address. Only meaningful if {@link #isLocal()} is false.
+	 */
+	const Poco::Net::SocketAddress &getSocketAddress() const {
+		return mSocketAddress;
+	}
+
+	/**
+	 * Returns the Unix socket path. Only meaningful if {@link #isLocal()} is true.
+	 */
+	const std::string &getPath() const {
+		return mPath;
+	}
+
+	/**
+	 * Opens a new blocking connection to the server.
+	 * <p/>TCP connections have Nagle's algorithm disabled.
+	 * @throws IOException if the connection failed.
+	 */
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> connect() const;
+
+	std::string toString() const;
+
+	bool operator==(const AdbServerAddress &other) const;
+	bool operator!=(const AdbServerAddress &other) const {
+		return !(*this == other);
+	}
+	bool operator<(const AdbServerAddress &other) const;
+
+private:
+	Kind mKind;
+	Poco::Net::SocketAddress mSocketAddress;
+	std::string mPath;
+};
+
+} /* namespace ddmlib */
+#endif /* ADBSERVERADDRESS_HPP_ */
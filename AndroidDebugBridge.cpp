@@ -41,10 +41,11 @@ std::set< std::tr1::shared_ptr<IClientChangeListener> > AndroidDebugBridge::sCli
 char AndroidDebugBridge::ADB[] = "adb";
 char AndroidDebugBridge::DDMS[] = "ddms";
 char AndroidDebugBridge::SERVER_PORT_ENV_VAR[] = "ANDROID_ADB_SERVER_PORT";
+char AndroidDebugBridge::SERVER_SOCKET_ENV_VAR[] = "ADB_SERVER_SOCKET";
 char AndroidDebugBridge::ADB_HOST[] = "127.0.0.1";
 unsigned int AndroidDebugBridge::ADB_PORT = 5037;
 std::string AndroidDebugBridge::sHostAddr;
-Poco::Net::SocketAddress AndroidDebugBridge::sSocketAddr;
+AdbServerAddress AndroidDebugBridge::sSocketAddr;
 Poco::Mutex AndroidDebugBridge::sLock;
 std::set< std::tr1::shared_ptr<IDebugBridgeChangeListener> > AndroidDebugBridge::sBridgeListeners;
 std::set< std::tr1::shared_ptr<IDeviceChangeListener> > AndroidDebugBridge::sDeviceListeners;
@@ -53,6 +54,9 @@ std::tr1::shared_ptr<Poco::Thread> AndroidDebugBridge::sReactorThread(new Poco::
 std::string AndroidDebugBridge::sAdbOsLocation;
 
 AndroidDebugBridge::AndroidDebugBridge() {
+#ifdef CLIENT_SUPPORT
+	mDebuggerPorts.push_back(DdmPreferences::getDebugPortBase());
+#endif
 }
 
 AndroidDebugBridge::AndroidDebugBridge(const std::string &osLocation) {
@@ -61,6 +65,9 @@ AndroidDebugBridge::AndroidDebugBridge(const std::string &osLocation) {
 	}
 
 	sAdbOsLocation = osLocation;
+#ifdef CLIENT_SUPPORT
+	mDebuggerPorts.push_back(DdmPreferences::getDebugPortBase());
+#endif
 
 	//checkAdbVersion();
 }
@@ -209,6 +216,9 @@ void AndroidDebugBridge::terminate() {
 			sThis->mDeviceMonitor->stop();
 			sThis->mDeviceMonitor.reset();
 		}
+		if (sThis != nullptr) {
+			sThis->stopServerMonitors();
+		}
 	} catch (...) {
 		Log::e("ddms", "Exception during device monitor termination");
 		// TODO: do something
@@ -229,7 +239,7 @@ bool AndroidDebugBridge::getClientSupport() {
 }
 #endif
 
-Poco::Net::SocketAddress AndroidDebugBridge::getSocketAddress() {
+AdbServerAddress AndroidDebugBridge::getSocketAddress() {
 	return sSocketAddr;
 }
 
@@ -356,9 +366,15 @@ bool AndroidDebugBridge::start() {
 	mStarted = true;
 
 	// now that the bridge is connected, we start the underlying services.
-	mDeviceMonitor = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis));
+	mDeviceMonitor = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis, getSocketAddress()));
 	mDeviceMonitor->start();
 
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		it->second = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis, it->first));
+		it->second->start();
+	}
+
 	return true;
 }
 
@@ -426,6 +442,7 @@ bool AndroidDebugBridge::stop() {
 	// kill the monitoring services
 	mDeviceMonitor->stop();
 	mDeviceMonitor.reset();
+	stopServerMonitors();
 
 	/*if (!stopAdb()) {
 		return false;
@@ -491,7 +508,7 @@ bool AndroidDebugBridge::restart() {
 		bool restart = startAdb();
 
 		if (restart && mDeviceMonitor == nullptr) {
-			mDeviceMonitor = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis));
+			mDeviceMonitor = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis, getSocketAddress()));
 			mDeviceMonitor->start();
 		}
 
@@ -597,8 +614,17 @@ int AndroidDebugBridge::grabProcessOutput(const DetachedProcessHandle &adbHandle
 }
 
 void AndroidDebugBridge::initAdbSocketAddr() {
-	unsigned int adb_port = determineAndValidateAdbPort();
 	sHostAddr = std::string(ADB_HOST);
+
+	std::string adb_socket_var(Poco::Environment::get(SERVER_SOCKET_ENV_VAR, ""));
+	Poco::trimInPlace(adb_socket_var);
+	if (!adb_socket_var.empty()) {
+		sSocketAddr = AdbServerAddress::parse(adb_socket_var, sHostAddr);
+		Log::d(DDMS, "Using adb server at " + sSocketAddr.toString());
+		return;
+	}
+
+	unsigned int adb_port = determineAndValidateAdbPort();
 	sSocketAddr = Poco::Net::SocketAddress(sHostAddr, adb_port);
 }
 
@@ -771,23 +797,75 @@ void AndroidDebugBridge::removeClientChangeListener(std::tr1::shared_ptr<IClient
 void AndroidDebugBridge::setSelectedClient(std::tr1::shared_ptr<Client> selectedClient) {
 	selectedClient->setAsSelectedClient();
 }
+
+int AndroidDebugBridge::getNextDebuggerPort() {
+	Poco::ScopedLock<Poco::Mutex> lock(mDebuggerPortsLock);
+	if (!mDebuggerPorts.empty()) {
+		int port = mDebuggerPorts[0];
+
+		// remove it.
+		mDebuggerPorts.erase(mDebuggerPorts.begin());
+
+		// if there's nothing left, add the next port to the list
+		if (mDebuggerPorts.size() == 0) {
+			mDebuggerPorts.push_back(port + 1);
+		}
+
+		return port;
+	}
+	return -1;
+}
+
+void AndroidDebugBridge::addPortToAvailableList(int port) {
+	if (port > 0) {
+		Poco::ScopedLock<Poco::Mutex> lock(mDebuggerPortsLock);
+		// because there could be case where clients are closed twice, we have to make
+		// sure the port number is not already in the list.
+		if (std::find(mDebuggerPorts.begin(), mDebuggerPorts.end(), port) == mDebuggerPorts.end()) {
+			// add the port to the list while keeping it sorted. It's not like there's
+			// going to be tons of objects so we do it linearly.
+			int count = mDebuggerPorts.size();
+			for (int i = 0; i < count; i++) {
+				if (port < mDebuggerPorts[i]) {
+					mDebuggerPorts.insert(mDebuggerPorts.begin() + i, port);
+					break;
+				}
+			}
+			// TODO: check if we can compact the end of the list.
+		}
+	}
+}
 #endif
 
 std::vector<std::tr1::shared_ptr<Device> > AndroidDebugBridge::getDevices() {
 	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	std::vector<std::tr1::shared_ptr<Device> > devices;
 	if (mDeviceMonitor != nullptr) {
-		std::vector<std::tr1::shared_ptr<Device> > devices = mDeviceMonitor->getDevices();
-		return devices;
-	} else return std::vector<std::tr1::shared_ptr<Device> >();
-
+		devices = mDeviceMonitor->getDevices();
+	}
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		if (it->second != nullptr) {
+			std::vector<std::tr1::shared_ptr<Device> > serverDevices = it->second->getDevices();
+			devices.insert(devices.end(), serverDevices.begin(), serverDevices.end());
+		}
+	}
+	return devices;
 }
 
 bool AndroidDebugBridge::hasInitialDeviceList() {
-	if (mDeviceMonitor != nullptr) {
-		return mDeviceMonitor->hasInitialDeviceList();
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	if (mDeviceMonitor == nullptr || !mDeviceMonitor->hasInitialDeviceList()) {
+		return false;
 	}
-
-	return false;
+	// a server which can't be reached doesn't hold back the others.
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		if (it->second != nullptr && it->second->isMonitoring() && !it->second->hasInitialDeviceList()) {
+			return false;
+		}
+	}
+	return true;
 }
 
 bool AndroidDebugBridge::isConnected() {
@@ -815,6 +893,76 @@ std::tr1::shared_ptr<DeviceMonitor> AndroidDebugBridge::getDeviceMonitor() {
 	return mDeviceMonitor;
 }
 
+std::tr1::shared_ptr<DeviceMonitor> AndroidDebugBridge::getDeviceMonitor(const AdbServerAddress &server) {
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	if (server == sSocketAddr) {
+		return mDeviceMonitor;
+	}
+	std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.find(server);
+	if (it != mServerMonitors.end()) {
+		return it->second;
+	}
+	return std::tr1::shared_ptr<DeviceMonitor>();
+}
+
+bool AndroidDebugBridge::addAdbServer(const AdbServerAddress &server) {
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	if (server == sSocketAddr || mServerMonitors.count(server) != 0) {
+		return false;
+	}
+
+	std::tr1::shared_ptr<DeviceMonitor> monitor;
+	if (mStarted) {
+		monitor = std::tr1::shared_ptr<DeviceMonitor>(new DeviceMonitor(sThis, server));
+		monitor->start();
+	}
+	mServerMonitors[server] = monitor;
+	Log::d(DDMS, "Tracking devices of adb server " + server.toString());
+	return true;
+}
+
+bool AndroidDebugBridge::removeAdbServer(const AdbServerAddress &server) {
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.find(server);
+	if (it == mServerMonitors.end()) {
+		return false;
+	}
+
+	std::tr1::shared_ptr<DeviceMonitor> monitor = it->second;
+	mServerMonitors.erase(it);
+
+	if (monitor != nullptr) {
+		std::vector<std::tr1::shared_ptr<Device> > devices = monitor->getDevices();
+		monitor->stop();
+		for (std::vector<std::tr1::shared_ptr<Device> >::iterator device = devices.begin(); device != devices.end(); ++device) {
+			deviceDisconnected(*device);
+		}
+	}
+	Log::d(DDMS, "Stopped tracking devices of adb server " + server.toString());
+	return true;
+}
+
+std::vector<AdbServerAddress> AndroidDebugBridge::getAdbServers() {
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
+	std::vector<AdbServerAddress> servers;
+	servers.push_back(sSocketAddr);
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		servers.push_back(it->first);
+	}
+	return servers;
+}
+
+void AndroidDebugBridge::stopServerMonitors() {
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		if (it->second != nullptr) {
+			it->second->stop();
+			it->second.reset();
+		}
+	}
+}
+
 Poco::Mutex &AndroidDebugBridge::getLock() {
 	return sLock;
 }
@@ -828,8 +976,29 @@ Poco::Net::SocketReactor &AndroidDebugBridge::getReactor() {
 }
 
 std::tr1::shared_ptr<Device> AndroidDebugBridge::findDeviceBySerial(const std::string &serial) {
+	Poco::ScopedLock<Poco::Mutex> lock(sLock);
 	if (mDeviceMonitor != nullptr) {
-		return mDeviceMonitor->findDeviceBySerial(serial);
+		std::tr1::shared_ptr<Device> device = mDeviceMonitor->findDeviceBySerial(serial);
+		if (device != nullptr) {
+			return device;
+		}
+	}
+	for (std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> >::iterator it = mServerMonitors.begin();
+			it != mServerMonitors.end(); ++it) {
+		if (it->second != nullptr) {
+			std::tr1::shared_ptr<Device> device = it->second->findDeviceBySerial(serial);
+			if (device != nullptr) {
+				return device;
+			}
+		}
+	}
+	return std::tr1::shared_ptr<Device>();
+}
+
+std::tr1::shared_ptr<Device> AndroidDebugBridge::findDevice(const AdbServerAddress &server, const std::string &serial) {
+	std::tr1::shared_ptr<DeviceMonitor> monitor = getDeviceMonitor(server);
+	if (monitor != nullptr) {
+		return monitor->findDeviceBySerial(serial);
 	}
 	return std::tr1::shared_ptr<Device>();
 }
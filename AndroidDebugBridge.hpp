@@ -10,6 +10,7 @@
 
 #include "ddmlib.hpp"
 #include "ProcessLauncher.hpp"
+#include "AdbServerAddress.hpp"
 
 namespace ddmlib {
 
@@ -115,13 +116,14 @@ class DDMLIB_API AndroidDebugBridge {
 	static char ADB[];
 	static char DDMS[];
 	static char SERVER_PORT_ENV_VAR[];
+	static char SERVER_SOCKET_ENV_VAR[];
 
 	// Where to find the ADB bridge.
 	static char ADB_HOST[];
 	static unsigned int ADB_PORT;
 
 	static std::string sHostAddr;
-	static Poco::Net::SocketAddress sSocketAddr;
+	static AdbServerAddress sSocketAddr;
 
 	static std::tr1::shared_ptr<AndroidDebugBridge> sThis;
 	static bool sInitialized;
@@ -140,6 +142,18 @@ class DDMLIB_API AndroidDebugBridge {
 
 	std::tr1::shared_ptr<DeviceMonitor> mDeviceMonitor;
 
+	/**
+	 * Monitors of the additional adb servers, keyed by server address. The value is empty while
+	 * the bridge is stopped.
+	 */
+	std::map<AdbServerAddress, std::tr1::shared_ptr<DeviceMonitor> > mServerMonitors;
+
+#ifdef CLIENT_SUPPORT
+	/** local debugger ports available to the clients of all the adb servers. */
+	std::vector<int> mDebuggerPorts;
+	Poco::Mutex mDebuggerPortsLock;
+#endif
+
 	static std::set< std::tr1::shared_ptr<IDebugBridgeChangeListener> > sBridgeListeners;
 	static std::set< std::tr1::shared_ptr<IDeviceChangeListener> > sDeviceListeners;
 
@@ -198,8 +212,16 @@ class DDMLIB_API AndroidDebugBridge {
 	 */
 	bool restart();
 
+	/**
+	 * Stops the monitors of the additional adb servers, keeping the servers registered.
+	 */
+	void stopServerMonitors();
+
 	/**
 	 * Instantiates sSocketAddr with the address of the host's adb process.
+	 * <p/>If ADB_SERVER_SOCKET is set (e.g. <code>localfilesystem:/run/adb.sock</code>), it
+	 * takes precedence over ANDROID_ADB_SERVER_PORT.
+	 * @throws invalid_argument if ADB_SERVER_SOCKET can't be parsed.
 	 */
 	static void initAdbSocketAddr();
 
@@ -247,9 +269,10 @@ public:
 	static void terminate();
 
 	/**
-	 * Returns the socket address of the ADB server on the host.
+	 * Returns the address of the ADB server on the host. This is either a TCP endpoint or a
+	 * Unix domain socket, see {@link AdbServerAddress}.
 	 */
-	static Poco::Net::SocketAddress getSocketAddress();
+	static AdbServerAddress getSocketAddress();
 
 	/**
 	 * Creates a {@link AndroidDebugBridge} that is not linked to any particular executable.
@@ -379,6 +402,18 @@ public:
 	 * @param selectedClient the client. Can be null.
 	 */
 	void setSelectedClient(std::tr1::shared_ptr<Client> selectedClient);
+
+	/**
+	 * Returns the next local port on which a debugger of a {@link Client} can listen, whichever
+	 * adb server the client comes from.
+	 * @return the port, or -1 if none is available.
+	 */
+	int getNextDebuggerPort();
+
+	/**
+	 * Makes a port returned by {@link #getNextDebuggerPort()} available again.
+	 */
+	void addPortToAvailableList(int port);
 #endif
 
 	/**
@@ -403,6 +438,46 @@ public:
 	 */
 	std::tr1::shared_ptr<DeviceMonitor> getDeviceMonitor();
 
+	/**
+	 * Returns the {@link DeviceMonitor} tracking the given adb server, or null if the server is
+	 * not tracked by this bridge or the bridge is not started.
+	 */
+	std::tr1::shared_ptr<DeviceMonitor> getDeviceMonitor(const AdbServerAddress &server);
+
+	/**
+	 * Adds an adb server whose devices should be tracked by this bridge, in addition to the
+	 * default one.
+	 * <p/>Each server gets its own {@link DeviceMonitor}: its connection, reconnection attempts
+	 * and device list are independent from the other servers. The devices of all servers are
+	 * returned together by {@link #getDevices()} and reported to the same
+	 * {@link IDeviceChangeListener}s.
+	 * <p/>The bridge never tries to start adb for additional servers.
+	 * @param server the address of the adb server.
+	 * @return false if the server was already tracked.
+	 */
+	bool addAdbServer(const AdbServerAddress &server);
+
+	/**
+	 * Stops tracking an adb server previously added with {@link #addAdbServer(AdbServerAddress)}.
+	 * <p/>Listeners are notified of the disconnection of all its devices.
+	 * @param server the address of the adb server.
+	 * @return false if the server was not tracked.
+	 */
+	bool removeAdbServer(const AdbServerAddress &server);
+
+	/**
+	 * Returns the addresses of all adb servers tracked by this bridge, starting with the default one.
+	 */
+	std::vector<AdbServerAddress> getAdbServers();
+
+	/**
+	 * Finds a device by the adb server it is attached to and its serial number.
+	 * <p/>Unlike {@link #findDeviceBySerial(std::string)}, this is unambiguous if two servers
+	 * report devices with the same serial number (e.g. emulators on different hosts).
+	 * @return the device, or null if not found.
+	 */
+	std::tr1::shared_ptr<Device> findDevice(const AdbServerAddress &server, const std::string &serial);
+
 	/**
 	 * Starts the adb host side server.
 	 * @return true if success
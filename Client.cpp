@@ -28,6 +28,7 @@
 #include "HandleWait.hpp"
 #include "DebugPortManager.hpp"
 #include "ByteBuffer.hpp"
+#include "TransferScheduler.hpp"
 
 namespace ddmlib {
 
@@ -382,7 +383,17 @@ void Client::read() {
 			mReadBuffer.swap(newBuffer);
 		}
 
-		pos += mChan->receiveBytes(mReadBuffer->getArray() + pos, count);
+		int received = mChan->receiveBytes(mReadBuffer->getArray() + pos, count);
+		pos += received;
+
+		// debugging traffic is interactive: bulk transfers to the device make way for it.
+		std::tr1::shared_ptr<Device> device = mDevice.lock();
+		if (device != nullptr && received > 0) {
+			std::tr1::shared_ptr<TransferScheduler> scheduler = device->getTransferScheduler();
+			if (scheduler != nullptr) {
+				scheduler->record(TransferScheduler::PRIORITY_INTERACTIVE, (unsigned int) received);
+			}
+		}
 
 	} catch (Poco::TimeoutException& e) {
 		Log::e("Client", "Timeout error");
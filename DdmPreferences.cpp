@@ -21,6 +21,7 @@ int DdmPreferences::sProfilerBufferSizeMb = DdmPreferences::DEFAULT_PROFILER_BUF
 
 bool DdmPreferences::sUseAdbHost = DdmPreferences::DEFAULT_USE_ADBHOST;
 std::string DdmPreferences::sAdbHostValue = "127.0.0.1";
+std::string DdmPreferences::sPushManifestDirectory;
 
 DdmPreferences::DdmPreferences() {
 }
@@ -53,6 +54,20 @@ int DdmPreferences::getProfilerBufferSizeMb() {
 	return sProfilerBufferSizeMb;
 }
 
+std::string DdmPreferences::getPushManifestDirectory() {
+	if (sPushManifestDirectory.empty()) {
+		Poco::Path path(Poco::Path::home());
+		path.pushDirectory(".android");
+		path.pushDirectory("ddmlib-manifests");
+		return path.toString();
+	}
+	return sPushManifestDirectory;
+}
+
+void DdmPreferences::setPushManifestDirectory(const std::string& directory) {
+	sPushManifestDirectory = directory;
+}
+
 int DdmPreferences::getDebugPortBase() {
 	return sDebugPortBase;
 }
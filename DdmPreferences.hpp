@@ -33,6 +33,7 @@ class DDMLIB_API DdmPreferences {
 
 	static bool sUseAdbHost; //DEFAULT_USE_ADBHOST
 	static std::string sAdbHostValue; //DEFAULT_ADBHOST_VALUE
+	static std::string sPushManifestDirectory;
 
 public:
 	/** Default value for thread update flag upon client connection. */
@@ -80,6 +81,16 @@ public:
 	static bool getInitialHeapUpdate();
 
 	static int getProfilerBufferSizeMb();
+	/**
+	 * Returns the directory of the {@link PushManifest} journals. Defaults to
+	 * <code>~/.android/ddmlib-manifests</code>.
+	 */
+	static std::string getPushManifestDirectory();
+	/**
+	 * Sets the directory of the {@link PushManifest} journals. Only affects the manifests
+	 * opened afterward.
+	 */
+	static void setPushManifestDirectory(const std::string& directory);
 
 	//static std::string const DEFAULT_ADBHOST_VALUE("127.0.0.1");
 
@@ -19,12 +19,17 @@
 #include "AdbCommandRejectedException.hpp"
 #include "InstallException.hpp"
 #include "IShellOutputReceiver.hpp"
+#include "IRawOutputReceiver.hpp"
 #include "NullOutputReceiver.hpp"
 #include "CollectingOutputReceiver.hpp"
 #include "ShellCommandUnresponsiveException.hpp"
 #include "SyncService.hpp"
 #include "MultiLineReceiver.hpp"
 #include "RawImage.hpp"
+#include "PushManifest.hpp"
+#include "TransferScheduler.hpp"
+#include "DdmPreferences.hpp"
+#include "GetPropReceiver.hpp"
 
 namespace ddmlib {
 
@@ -32,6 +37,11 @@ const char Device::PROP_BUILD_VERSION[] = "ro.build.version.release";
 const char Device::PROP_BUILD_API_LEVEL[] = "ro.build.version.sdk";
 const char Device::PROP_BUILD_CODENAME[] = "ro.build.version.codename";
 const char Device::PROP_DEBUGGABLE[] = "ro.debuggable";
+const char Device::PROP_DEVICE_MODEL[] = "ro.product.model";
+const char Device::PROP_DEVICE_PRODUCT[] = "ro.product.name";
+const char Device::PROP_DEVICE_NAME[] = "ro.product.device";
+const char Device::TAG_DEVPATH[] = "usb";
+const char Device::TAG_TRANSPORT_ID[] = "transport_id";
 const char Device::FIRST_EMULATOR_SN[] = "emulator-5554";
 const char Device::PROP_BUILD_VERSION_NUMBER[] = "ro.build.version.sdk"; // = PROP_BUILD_API_LEVEL;
 
@@ -54,8 +64,11 @@ Poco::Timestamp Device::current_time;
 
 Device::Device(std::tr1::shared_ptr<DeviceMonitor> monitor, const std::string &serialNumber, const std::string &deviceState) {
 	mArePropertiesSet = false;
+	mInfoQueried = false;
 	mLastBatteryLevel = 0;
 	mLastBatteryCheckTime = 0;
+	mUsePushManifest = false;
+	mTransferScheduler.reset(new TransferScheduler);
 	mState = "";
 	mMonitor = monitor;
 	mSerialNumber = serialNumber;
@@ -177,6 +190,12 @@ std::string Device::getState() const {
 
 void Device::setState(const std::string &state) {
 	mState = state;
+
+	if (state != ONLINE) {
+		// the device may reboot before it comes back: check the boot id again then.
+		Poco::FastMutex::ScopedLock lock(mPushManifestLock);
+		mPushManifest.reset();
+	}
 }
 
 std::map<std::string, std::string> Device::getProperties() const {
@@ -188,15 +207,48 @@ int Device::getPropertyCount() {
 }
 
 std::string Device::getProperty(const std::string &name) {
-	return mProperties[name];
+	if (!mArePropertiesSet && mProperties.count(name) == 0) {
+		// only the tracking tags are known so far.
+		queryProperties();
+	}
+	std::map<std::string, std::string>::const_iterator property = mProperties.find(name);
+	if (property != mProperties.end()) {
+		return property->second;
+	}
+	return std::string();
 }
 
 bool Device::arePropertiesSet() {
 	return mArePropertiesSet;
 }
 
+void Device::clearProperties() {
+	mProperties.clear();
+	mArePropertiesSet = false;
+	setTagProperties();
+}
+
+void Device::queryProperties() {
+	if (!isOnline()) {
+		return;
+	}
+	// the receiver sends CHANGE_BUILD_INFO once done, which marks the properties as set.
+	std::tr1::shared_ptr<GetPropReceiver> rcvr(new GetPropReceiver(shared_from_this()));
+	try {
+		executeShellCommand(GetPropReceiver::GETPROP_COMMAND, rcvr.get());
+	} catch (Poco::TimeoutException &e) {
+		Log::w(LOG_TAG, "Connection timeout getting properties for device " + getSerialNumber());
+	} catch (AdbCommandRejectedException &e) {
+		Log::w(LOG_TAG, "Adb rejected command to get device " + getSerialNumber() + " properties: " + std::string(e.what()));
+	} catch (ShellCommandUnresponsiveException &e) {
+		Log::w(LOG_TAG, "Adb shell command took too long returning properties for device " + getSerialNumber());
+	} catch (Poco::IOException &e) {
+		Log::w(LOG_TAG, "IO Error getting properties for device " + getSerialNumber());
+	}
+}
+
 std::string Device::getPropertyCacheOrSync(const std::string &name) {
-	if (mArePropertiesSet) {
+	if (mArePropertiesSet || mProperties.count(name) > 0) {
 		return getProperty(name);
 	} else {
 		return getPropertySync(name);
@@ -328,49 +380,100 @@ void Device::update(std::tr1::shared_ptr<Client> client, int changeMask) {
 #endif
 
 std::tr1::shared_ptr<SyncService> Device::getSyncService() {
-	std::tr1::shared_ptr<SyncService> syncService(new SyncService(AndroidDebugBridge::getSocketAddress(), shared_from_this()));
+	std::tr1::shared_ptr<SyncService> syncService(new SyncService(getServerAddress(), shared_from_this()));
 	if (syncService->openSync()) {
+		if (mUsePushManifest) {
+			syncService->setPushManifest(getPushManifest());
+		}
+		syncService->setTransferScheduler(mTransferScheduler);
 		return syncService;
 	}
 	return std::tr1::shared_ptr<SyncService>();
 }
 
+std::tr1::shared_ptr<PushManifest> Device::getPushManifest() {
+	Poco::FastMutex::ScopedLock lock(mPushManifestLock);
+	if (!mPushManifest) {
+		std::string bootId = getBootId();
+		if (bootId.empty()) {
+			Log::w(LOG_TAG, "Unable to read the boot id of " + getSerialNumber() + ", pushes are not recorded");
+			return std::tr1::shared_ptr<PushManifest>();
+		}
+		mPushManifest.reset(new PushManifest(getSerialNumber(), bootId, DdmPreferences::getPushManifestDirectory()));
+	}
+	return mPushManifest;
+}
+
+void Device::resetPushManifest() {
+	std::tr1::shared_ptr<PushManifest> manifest = getPushManifest();
+	if (manifest) {
+		manifest->reset();
+	}
+}
+
+std::string Device::getBootId() {
+	CollectingOutputReceiver receiver;
+	executeShellCommand("cat /proc/sys/kernel/random/boot_id", &receiver);
+
+	// a UUID, anything else is an error message.
+	std::string bootId = Poco::trim(receiver.getOutput());
+	if (bootId.length() != 36) {
+		return "";
+	}
+	return bootId;
+}
+
 std::tr1::shared_ptr<FileListingService> Device::getFileListingService() {
 	return std::tr1::shared_ptr<FileListingService>(new FileListingService(shared_from_this()));
 }
 
 std::tr1::shared_ptr<RawImage> Device::getScreenshot() {
-	return AdbHelper::getFrameBuffer(AndroidDebugBridge::getSocketAddress(), shared_from_this());
+	return AdbHelper::getFrameBuffer(getServerAddress(), shared_from_this());
 }
 
 void Device::executeShellCommand(const std::string &command, IShellOutputReceiver *receiver) {
-	AdbHelper::executeRemoteCommand(AndroidDebugBridge::getSocketAddress(), command,
+	AdbHelper::executeRemoteCommand(getServerAddress(), command,
 			this, receiver, DdmPreferences::getTimeOut());
 }
 
 void Device::executeShellCommand(const std::string &command, IShellOutputReceiver *receiver,
 		int maxTimeToOutputResponse) {
-	AdbHelper::executeRemoteCommand(AndroidDebugBridge::getSocketAddress(), command,
+	AdbHelper::executeRemoteCommand(getServerAddress(), command,
+			this, receiver, maxTimeToOutputResponse);
+}
+
+void Device::executeRawCommand(const std::string &command, IRawOutputReceiver *receiver) {
+	AdbHelper::executeRawCommand(getServerAddress(), command,
+			this, receiver, DdmPreferences::getTimeOut());
+}
+
+void Device::executeRawCommand(const std::string &command, IRawOutputReceiver *receiver,
+		int maxTimeToOutputResponse) {
+	AdbHelper::executeRawCommand(getServerAddress(), command,
 			this, receiver, maxTimeToOutputResponse);
 }
 
+std::tr1::shared_ptr<Poco::Net::StreamSocket> Device::openExecChannel(const std::string &command) {
+	return AdbHelper::openExecChannel(getServerAddress(), command, this);
+}
+
 void Device::runEventLogService(LogReceiver *receiver) {
-	AdbHelper::runEventLogService(AndroidDebugBridge::getSocketAddress(),
+	AdbHelper::runEventLogService(getServerAddress(),
 			this, receiver);
 }
 
 void Device::runLogService(const std::string &logname, LogReceiver *receiver) {
-	AdbHelper::runLogService(AndroidDebugBridge::getSocketAddress(), this, logname,
+	AdbHelper::runLogService(getServerAddress(), this, logname,
 			receiver);
 }
 
 void Device::createForward(int localPort, int remotePort) {
-	AdbHelper::createForward(AndroidDebugBridge::getSocketAddress(), shared_from_this(), localPort,
+	AdbHelper::createForward(getServerAddress(), shared_from_this(), localPort,
 			remotePort);
 }
 
 void Device::removeForward(int localPort, int remotePort) {
-	AdbHelper::removeForward(AndroidDebugBridge::getSocketAddress(), shared_from_this(), localPort,
+	AdbHelper::removeForward(getServerAddress(), shared_from_this(), localPort,
 			remotePort);
 }
 
@@ -379,6 +482,14 @@ std::tr1::shared_ptr<DeviceMonitor> Device::getMonitor() {
 	return mMonitor.lock();
 }
 
+AdbServerAddress Device::getServerAddress() {
+	std::tr1::shared_ptr<DeviceMonitor> monitor = mMonitor.lock();
+	if (monitor != nullptr) {
+		return monitor->getServerAddress();
+	}
+	return AndroidDebugBridge::getSocketAddress();
+}
+
 void Device::update(int changeMask) {
 	if ((changeMask & CHANGE_BUILD_INFO) != 0) {
 		mArePropertiesSet = true;
@@ -390,6 +501,41 @@ void Device::addProperty(const std::string& label, const std::string& value) {
 	mProperties[label] = value;
 }
 
+std::map<std::string, std::string> Device::getTrackingTags() const {
+	return mTrackingTags;
+}
+
+std::string Device::getTrackingTag(const std::string &key) const {
+	std::map<std::string, std::string>::const_iterator tag = mTrackingTags.find(key);
+	if (tag != mTrackingTags.end()) {
+		return tag->second;
+	}
+	return std::string();
+}
+
+bool Device::setTrackingTags(const std::map<std::string, std::string> &tags) {
+	if (tags == mTrackingTags) {
+		return false;
+	}
+	mTrackingTags = tags;
+	setTagProperties();
+	return true;
+}
+
+void Device::setTagProperties() {
+	// adb reports the product properties as tags, which saves a getprop round trip.
+	std::map<std::string, std::string>::const_iterator tag;
+	if ((tag = mTrackingTags.find("product")) != mTrackingTags.end()) {
+		mProperties[PROP_DEVICE_PRODUCT] = tag->second;
+	}
+	if ((tag = mTrackingTags.find("model")) != mTrackingTags.end()) {
+		mProperties[PROP_DEVICE_MODEL] = tag->second;
+	}
+	if ((tag = mTrackingTags.find("device")) != mTrackingTags.end()) {
+		mProperties[PROP_DEVICE_NAME] = tag->second;
+	}
+}
+
 void Device::setMountingPoint(const std::string &name, const std::string &value) {
 	mMountPoints[name] = value;
 }
@@ -568,6 +714,12 @@ std::string Device::installRemotePackage(const std::string& remoteFilePath, bool
 }
 
 void Device::removeRemotePackage(const std::string &remoteFilePath) {
+	{
+		Poco::FastMutex::ScopedLock lock(mPushManifestLock);
+		if (mPushManifest) {
+			mPushManifest->forget(remoteFilePath);
+		}
+	}
 	try {
 		executeShellCommand("rm " + remoteFilePath, NullOutputReceiver::getReceiver(), INSTALL_TIMEOUT);
 	} catch (Poco::IOException& e) {
@@ -603,7 +755,11 @@ std::string Device::uninstallPackage(const std::string& packageName) {
  * @see com.android.ddmlib.Device#reboot()
  */
 void Device::reboot(const std::string& into) {
-	AdbHelper::reboot(into, AndroidDebugBridge::getSocketAddress(), shared_from_this());
+	{
+		Poco::FastMutex::ScopedLock lock(mPushManifestLock);
+		mPushManifest.reset();
+	}
+	AdbHelper::reboot(into, getServerAddress(), shared_from_this());
 }
 
 int Device::getBatteryLevel() {
@@ -638,6 +794,15 @@ void Device::registerInReactor() {
 #endif
 }
 
+void Device::unregisterFromReactor() {
+#ifdef CLIENT_SUPPORT
+	if (mSocketChannel != nullptr) {
+		AndroidDebugBridge::getReactor().removeEventHandler(*(mSocketChannel.get()),
+				Poco::NObserver<Device, Poco::Net::ReadableNotification>(*this, &Device::processDeviceReadActivity));
+	}
+#endif
+}
+
 #ifdef CLIENT_SUPPORT
 void Device::processDeviceReadActivity(const Poco::AutoPtr<Poco::Net::ReadableNotification> & notification) {
 
@@ -10,14 +10,18 @@
 
 #include "ddmlib.hpp"
 #include "MultiLineReceiver.hpp"
+#include "AdbServerAddress.hpp"
 
 namespace ddmlib {
 
 class SyncService;
 class DeviceMonitor;
 class FileListingService;
+class PushManifest;
+class TransferScheduler;
 class LogReceiver;
 class IShellOutputReceiver;
+class IRawOutputReceiver;
 class RawImage;
 
 #ifdef CLIENT_SUPPORT
@@ -38,6 +42,14 @@ public:
 	const static char PROP_BUILD_API_LEVEL[];
 	const static char PROP_BUILD_CODENAME[];
 	const static char PROP_DEBUGGABLE[];
+	const static char PROP_DEVICE_MODEL[];
+	const static char PROP_DEVICE_PRODUCT[];
+	const static char PROP_DEVICE_NAME[];
+
+	/** Tracking tag: the USB device path (or other connection path) reported by adb. */
+	const static char TAG_DEVPATH[];
+	/** Tracking tag: the adb transport id of the device. */
+	const static char TAG_TRANSPORT_ID[];
 
 	/** Serial number of the first connected emulator. */
 	const static char FIRST_EMULATOR_SN[];
@@ -60,12 +72,23 @@ public:
 	std::string getAvdName() const;
 	std::string getState() const;
 	std::map<std::string, std::string> getProperties() const;
+	/**
+	 * Returns a property of the device, or an empty string if it has none by that name.
+	 * <p/>When the tracking tags spared the getprop call, the other properties are read the
+	 * first time one is missing, which sends a {@link #CHANGE_BUILD_INFO} change.
+	 */
 	std::string getProperty(const std::string &name);
 	int getPropertyCount();
 	std::string getPropertySync(const std::string &name);
 	std::string getPropertyCacheOrSync(const std::string &name);
 	std::string getMountPoint(const std::string &name);
 	std::tr1::shared_ptr<DeviceMonitor> getMonitor();
+	/**
+	 * Returns the address of the adb server this device is attached through.
+	 * <p/>Together with the serial number, this identifies the device when the bridge
+	 * tracks several adb servers.
+	 */
+	AdbServerAddress getServerAddress();
 #ifdef CLIENT_SUPPORT
 	std::tr1::shared_ptr<Poco::Net::StreamSocket> getClientMonitoringSocket();
 	std::vector<std::tr1::shared_ptr<Client> > getClients();
@@ -88,6 +111,21 @@ public:
 	void setMountingPoint(const std::string &name, const std::string &value);
 
 	bool arePropertiesSet();
+	/**
+	 * Drops the properties read from the device, e.g. once it went offline, as a reboot may
+	 * change them. The ones from the tracking tags are kept.
+	 */
+	void clearProperties();
+	/**
+	 * Returns whether the mount points and AVD name were read since the device got online.
+	 * The build info may still be pending, see {@link #getProperty}.
+	 */
+	bool isInfoQueried() const {
+		return mInfoQueried;
+	}
+	void setInfoQueried(bool infoQueried) {
+		mInfoQueried = infoQueried;
+	}
 	bool isOnline();
 	bool isEmulator();
 	bool isOffline();
@@ -106,15 +144,80 @@ public:
 #endif
 	void update(int changeMask);
 	void addProperty(const std::string &label, const std::string &value);
+
+	/**
+	 * Returns the <code>key:value</code> tags reported for this device by
+	 * <code>host:track-devices-l</code> (e.g. <code>usb</code>, <code>product</code>,
+	 * <code>model</code>, <code>device</code>, <code>transport_id</code>).
+	 */
+	std::map<std::string, std::string> getTrackingTags() const;
+
+	/**
+	 * Returns a tracking tag, or an empty string if adb didn't report it.
+	 */
+	std::string getTrackingTag(const std::string &key) const;
+
+	/**
+	 * Replaces the tracking tags of the device.
+	 * <p/>The <code>product</code>, <code>model</code> and <code>device</code> tags are also
+	 * stored as the matching <code>ro.product.*</code> properties, so they are available without
+	 * querying the device.
+	 * @return true if any tag changed.
+	 */
+	bool setTrackingTags(const std::map<std::string, std::string> &tags);
 	void executeShellCommand(const std::string &command, IShellOutputReceiver *receiver);
 	void executeShellCommand(const std::string &command, IShellOutputReceiver *receiver,
 			int maxTimeToOutputResponse);
+	/**
+	 * Executes a command through the binary-clean <code>exec:</code> service.
+	 * @see AdbHelper#executeRawCommand
+	 */
+	void executeRawCommand(const std::string &command, IRawOutputReceiver *receiver);
+	void executeRawCommand(const std::string &command, IRawOutputReceiver *receiver,
+			int maxTimeToOutputResponse);
+	/**
+	 * Opens a bidirectional <code>exec:</code> stream to <var>command</var>.
+	 * @see AdbHelper#openExecChannel
+	 */
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> openExecChannel(const std::string &command);
 	void runEventLogService(LogReceiver *receiver);
 	void runLogService(const std::string &logname, LogReceiver *receiver);
 	void createForward(int localPort, int remotePort);
 	void removeForward(int localPort, int remotePort);
 	void pushFile(const std::string& local, const std::string& remote);
 	void pullFile(const std::string& remote, const std::string& local);
+	/**
+	 * Enables the {@link PushManifest} of this device: the sync services returned by
+	 * {@link #getSyncService()} skip the pushes of content already pushed since the device booted.
+	 * <p/>Only use it when nothing but ddmlib changes the pushed files. Disabled by default.
+	 */
+	void setUsePushManifest(bool use) {
+		mUsePushManifest = use;
+	}
+	bool getUsePushManifest() const {
+		return mUsePushManifest;
+	}
+	/**
+	 * Returns the manifest of the content pushed to this device during the current boot.
+	 * @return the manifest, or null if the boot id of the device can't be read.
+	 */
+	std::tr1::shared_ptr<PushManifest> getPushManifest();
+	/**
+	 * Forgets all the content recorded in the push manifest.
+	 */
+	void resetPushManifest();
+	/**
+	 * Returns the scheduler sharing the bandwidth of this device between its transfers. The
+	 * sync services returned by {@link #getSyncService()} pace their DATA frames with it.
+	 */
+	std::tr1::shared_ptr<TransferScheduler> getTransferScheduler() const {
+		return mTransferScheduler;
+	}
+	/**
+	 * Returns the id of the current boot of the device (a random UUID, changed by every
+	 * reboot), or an empty string if it can't be read.
+	 */
+	std::string getBootId();
 	std::string installPackage(const std::string& packageFilePath, bool reinstall, const std::vector<std::string>& extraArgs);
 	std::string syncPackageToDevice(const std::string& localFilePath);
 	std::string installRemotePackage(const std::string& remoteFilePath, bool reinstall,
@@ -126,10 +229,13 @@ public:
 	void restartInUSB();
 	void processDeviceReadActivity(const Poco::AutoPtr<Poco::Net::ReadableNotification> & notification);
 	void registerInReactor();
+	void unregisterFromReactor();
 	void waitABit();
 private:
 
 	int readLength(std::tr1::shared_ptr<Poco::Net::StreamSocket> socket, size_t size);
+	void setTagProperties();
+	void queryProperties();
 	std::string read(std::tr1::shared_ptr<Poco::Net::StreamSocket> socket, size_t size);
 
 	class InstallReceiver: public MultiLineReceiver {
@@ -202,6 +308,9 @@ private:
 	std::map<std::string, std::string> mProperties;
 	std::map<std::string, std::string> mMountPoints;
 
+	/** Tags reported by the device tracking service. */
+	std::map<std::string, std::string> mTrackingTags;
+
 #ifdef CLIENT_SUPPORT
 	std::vector<std::tr1::shared_ptr<Client> > mClients;
 	/**
@@ -216,9 +325,16 @@ private:
 	unsigned char mLengthBuffer[4];
 
 	bool mArePropertiesSet; // = false;
+	bool mInfoQueried; // = false;
 	int mLastBatteryLevel; // = 0;
 	long long mLastBatteryCheckTime; // = 0;
 	std::string mIPaddress;
+
+	bool mUsePushManifest;
+	std::tr1::shared_ptr<PushManifest> mPushManifest;
+	Poco::FastMutex mPushManifestLock;
+
+	std::tr1::shared_ptr<TransferScheduler> mTransferScheduler;
 };
 
 } /* namespace ddmlib */
@@ -36,8 +36,7 @@ std::tr1::shared_ptr<Poco::Net::StreamSocket> DeviceMonitor::openAdbConnection()
 
 	std::tr1::shared_ptr<Poco::Net::StreamSocket> adbChannel;
 	try {
-		adbChannel = std::tr1::shared_ptr<Poco::Net::StreamSocket>(new Poco::Net::StreamSocket(AndroidDebugBridge::getSocketAddress()));
-		adbChannel->setNoDelay(true);
+		adbChannel = mServerAddress.connect();
 	} catch (Poco::IOException &e) {
 	}
 
@@ -45,7 +44,8 @@ std::tr1::shared_ptr<Poco::Net::StreamSocket> DeviceMonitor::openAdbConnection()
 }
 
 bool DeviceMonitor::sendDeviceListMonitoringRequest() {
-	std::vector<unsigned char> request = AdbHelper::formAdbRequest("host:track-devices"); 
+	std::vector<unsigned char> request = AdbHelper::formAdbRequest(
+			mLongTrackingFormat ? "host:track-devices-l" : "host:track-devices");
 
 	try {
 		AdbHelper::write(mMainAdbConnection, request);
@@ -55,6 +55,13 @@ bool DeviceMonitor::sendDeviceListMonitoringRequest() {
 		if (!resp.okay) {
 			// request was refused by adb!
 			Log::e("DeviceMonitor", "adb refused request: " + resp.message);
+			if (mLongTrackingFormat) {
+				// old adb server, fall back to the plain format on a new connection.
+				Log::d("DeviceMonitor", "Falling back to host:track-devices");
+				mLongTrackingFormat = false;
+				mMainAdbConnection->close();
+				mMainAdbConnection.reset();
+			}
 		}
 
 		return resp.okay;
@@ -69,13 +76,16 @@ bool DeviceMonitor::sendDeviceListMonitoringRequest() {
 void DeviceMonitor::deviceMonitorLoop() {
 	do {
 		try {
+			expireSuspectDevices();
+
 			if (mMainAdbConnection == nullptr) {
 				Log::d("DeviceMonitor", "Opening adb connection");
 				mMainAdbConnection = openAdbConnection();
 				if (mMainAdbConnection == nullptr) {
 					mConnectionAttempt++;
 					Log::e("DeviceMonitor", "Connection attempts: " + Poco::NumberFormatter::format(mConnectionAttempt));
-					if (mConnectionAttempt > 3) {
+					// only the default server is ours to (re)start, other servers are managed elsewhere.
+					if (mConnectionAttempt > 3 && mServerAddress == AndroidDebugBridge::getSocketAddress()) {
 						if (mServer.lock()->startAdb() == false) {
 							mRestartAttemptCount++;
 							Log::e("DeviceMonitor", "adb restart attempts: " + Poco::NumberFormatter::format(mRestartAttemptCount));
@@ -121,19 +131,6 @@ void DeviceMonitor::deviceMonitorLoop() {
 
 void DeviceMonitor::handleExceptionInMonitorLoop(std::exception & e) {
 	if (mQuit == false) {
-		class Notifier : public Poco::Task {
-		private:
-			std::tr1::shared_ptr<AndroidDebugBridge> mServer;
-			std::tr1::shared_ptr<Device> mDevice;
-		public:
-			Notifier(std::tr1::shared_ptr<AndroidDebugBridge> server,
-				std::tr1::shared_ptr<Device> device) : Poco::Task("Device disconnected: " + device->getSerialNumber()), mServer(server), mDevice(device) {};
-
-			void runTask() {
-				mServer->deviceDisconnected(mDevice);
-			}
-		};
-		std::vector< std::tr1::shared_ptr< Notifier > > notifiers;
 		Log::e("DeviceMonitor", std::string("Adb connection Error:") + e.what());
 		mMonitoring = false;
 		if (mMainAdbConnection != nullptr) {
@@ -144,21 +141,54 @@ void DeviceMonitor::handleExceptionInMonitorLoop(std::exception & e) {
 			}
 			mMainAdbConnection.reset();
 
-			// remove all devices from list
-			// because we are going to call mServer.deviceDisconnected which will acquire this
-			// lock we lock it first, so that the AndroidDebugBridge lock is always locked
-			// first.
-			{
-				Poco::ScopedLock<Poco::Mutex> lock(AndroidDebugBridge::getLock());
-				{
-					Poco::ScopedLock<Poco::Mutex> lock2(mDevicesLock);
-					int n = mDevices.size();
-					while (mDevices.size() != 0) {
-						std::tr1::shared_ptr<Device> device = mDevices[--n];
-						removeDevice(device);
-						notifier.start(new Notifier(mServer.lock(), device));
-					}
-				}
+			// don't drop the devices yet: adb is often back within a few seconds, and the
+			// next device list will be reconciled against the current one.
+			Poco::ScopedLock<Poco::Mutex> lock(mDevicesLock);
+			if (!mDevicesSuspect && !mDevices.empty()) {
+				Log::d("DeviceMonitor", "Keeping " + Poco::NumberFormatter::format(mDevices.size())
+						+ " device(s) as suspect until adb reconnects");
+				mDevicesSuspect = true;
+				mSuspectSince.update();
+			}
+		}
+	}
+}
+
+void DeviceMonitor::expireSuspectDevices() {
+	if (mDevicesSuspect && mSuspectSince.isElapsed((Poco::Timestamp::TimeDiff) DEVICE_GRACE_PERIOD * 1000)) {
+		Log::w("DeviceMonitor", "adb did not come back in time, removing suspect devices");
+		mDevicesSuspect = false;
+		removeAllDevices();
+	}
+}
+
+void DeviceMonitor::removeAllDevices() {
+	class Notifier : public Poco::Task {
+	private:
+		std::tr1::shared_ptr<AndroidDebugBridge> mServer;
+		std::tr1::shared_ptr<Device> mDevice;
+	public:
+		Notifier(std::tr1::shared_ptr<AndroidDebugBridge> server,
+			std::tr1::shared_ptr<Device> device) : Poco::Task("Device disconnected: " + device->getSerialNumber()), mServer(server), mDevice(device) {};
+
+		void runTask() {
+			mServer->deviceDisconnected(mDevice);
+		}
+	};
+
+	// remove all devices from list
+	// because we are going to call mServer.deviceDisconnected which will acquire this
+	// lock we lock it first, so that the AndroidDebugBridge lock is always locked
+	// first.
+	{
+		Poco::ScopedLock<Poco::Mutex> lock(AndroidDebugBridge::getLock());
+		{
+			Poco::ScopedLock<Poco::Mutex> lock2(mDevicesLock);
+			int n = mDevices.size();
+			while (mDevices.size() != 0) {
+				std::tr1::shared_ptr<Device> device = mDevices[--n];
+				removeDevice(device);
+				notifier.start(new Notifier(mServer.lock(), device));
 			}
 		}
 	}
@@ -174,11 +204,14 @@ void DeviceMonitor::processIncomingDeviceData(int length) {
 		Poco::StringTokenizer devices(result, "\n");
 
 		for (Poco::StringTokenizer::Iterator d = devices.begin(); d != devices.end(); ++d) {
-			Poco::StringTokenizer param(*d, "\t");
-			if (param.count() == 2) {
+			std::string serial, state;
+			std::map<std::string, std::string> tags;
+			if (parseDeviceLine(*d, serial, state, tags)) {
 				// new adb uses only serial numbers to identify devices
 				//add the device to the list
-				list.push_back(std::tr1::shared_ptr<Device>(new Device(shared_from_this(), param[0] /*serialnumber*/, param[1])));
+				std::tr1::shared_ptr<Device> device(new Device(shared_from_this(), serial, state));
+				device->setTrackingTags(tags);
+				list.push_back(device);
 			}
 		}
 	}
@@ -187,12 +220,52 @@ void DeviceMonitor::processIncomingDeviceData(int length) {
 	updateDevices(list);
 }
 
+bool DeviceMonitor::parseDeviceLine(const std::string &line, std::string &serial, std::string &state,
+		std::map<std::string, std::string> &tags) {
+	Poco::StringTokenizer param(line, " \t", Poco::StringTokenizer::TOK_IGNORE_EMPTY | Poco::StringTokenizer::TOK_TRIM);
+	if (param.count() < 2) {
+		return false;
+	}
+	serial = param[0];
+
+	// tags are at the end of the line; scan backwards so a state made of several words
+	// (e.g. "no permissions ...") is kept whole.
+	size_t stateEnd = param.count();
+	while (stateEnd > 2) {
+		const std::string &token = param[stateEnd - 1];
+		std::string::size_type colon = token.find(':');
+		if (colon == std::string::npos || colon == 0) {
+			break;
+		}
+		bool isKey = true;
+		for (std::string::size_type i = 0; i < colon && isKey; ++i) {
+			isKey = (token[i] >= 'a' && token[i] <= 'z') || token[i] == '_';
+		}
+		if (!isKey) {
+			break;
+		}
+		tags[token.substr(0, colon)] = token.substr(colon + 1);
+		--stateEnd;
+	}
+
+	state = param[1];
+	for (size_t i = 2; i < stateEnd; ++i) {
+		state += " " + param[i];
+	}
+	return true;
+}
+
 void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & newList) {
 	std::vector<std::tr1::shared_ptr<Device> > toSkipList;
 	std::vector<std::tr1::shared_ptr<Device> > toSkipListOld;
 	std::vector<std::tr1::shared_ptr<Device> > disconnectedDevices;
 	std::vector<std::tr1::shared_ptr<Device> > connectedDevices;
 	std::vector<std::tr1::shared_ptr<Device> > changedDevices;
+	std::vector<std::tr1::shared_ptr<Device> > tagChangedDevices;
+#ifdef CLIENT_SUPPORT
+	// surviving devices whose jdwp tracking must be restarted after an adb reconnection.
+	std::vector<std::tr1::shared_ptr<Device> > devicesToRemonitor;
+#endif
 	// array to store the devices that must be queried for information.
 	// it's important to not do it inside the synchronized loop as this could block
 	// the whole workspace (this lock is acquired during build too).
@@ -217,6 +290,14 @@ void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & n
 		if (mQuit)
 			return;
 
+		// first list after a reconnection: the suspect devices still present are kept as they
+		// are, only the real differences are applied below.
+		bool reconciling = mDevicesSuspect;
+		mDevicesSuspect = false;
+		if (reconciling) {
+			Log::d("DeviceMonitor", "Reconciling device list after adb reconnection");
+		}
+
 		Log::v("DeviceMonitor", "Updating devices");
 		std::vector<std::tr1::shared_ptr<Device> >::iterator deviceIt = mDevices.begin();
 		while (deviceIt != mDevices.end()) {
@@ -236,12 +317,23 @@ void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & n
 				if ((*newDevice)->getSerialNumber() == device->getSerialNumber()) {
 					foundMatch = true;
 
+					// only report the tags that actually changed since the last list.
+					if (device->setTrackingTags((*newDevice)->getTrackingTags())) {
+						tagChangedDevices.push_back(device);
+					}
+
 					// update the state if needed.
 					if (device->getState() != (*newDevice)->getState()) {
 						device->setState((*newDevice)->getState());
 						// ugly, but need to unlock to avoid deadlock with device change listeners that are going to try to create bridge
 						changedDevices.push_back(device);
 
+						// the info is read again each time the device gets online, e.g. after a reboot.
+						if (!device->isOnline()) {
+							device->setInfoQueried(false);
+							device->clearProperties();
+						}
+
 						// if the device just got ready/online, we need to start
 						// monitoring it.
 						if (device->isOnline()) {
@@ -253,11 +345,17 @@ void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & n
 							}
 #endif 
 
-							if (device->getPropertyCount() == 0) {
+							// not the property count: the tracking tags already filled the product ones.
+							if (!device->isInfoQueried()) {
 								devicesToQuery.push_back(device);
 							}
 						}
 					}
+#ifdef CLIENT_SUPPORT
+					else if (reconciling && device->isOnline()) {
+						devicesToRemonitor.push_back(device);
+					}
+#endif
 
 					// remove the new device from the list since it's been used
 					toSkipList.push_back(*newDevice);
@@ -311,6 +409,12 @@ void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & n
 		(*device)->update(Device::CHANGE_STATE);
 	}
 
+	// the tags are only part of the build info, so don't go through Device::update() which
+	// would mark all the properties as set.
+	for (std::vector<std::tr1::shared_ptr<Device> >::iterator device = tagChangedDevices.begin(); device != tagChangedDevices.end(); ++device) {
+		mServer.lock()->deviceChanged(*device, Device::CHANGE_BUILD_INFO);
+	}
+
 	for (std::vector<std::tr1::shared_ptr<Device> >::iterator device = connectedDevices.begin(); device != connectedDevices.end(); ++device) {
 		mServer.lock()->deviceConnected(*device);
 	}
@@ -320,6 +424,16 @@ void DeviceMonitor::updateDevices(std::vector<std::tr1::shared_ptr<Device> > & n
 		queryNewDeviceForInfo(*d);
 	}
 
+#ifdef CLIENT_SUPPORT
+	// the new jdwp list is merged with the existing clients by processIncomingJdwpData, so
+	// only the processes which actually came or went are opened or dropped.
+	if (AndroidDebugBridge::getClientSupport()) {
+		for (std::vector<std::tr1::shared_ptr<Device> >::iterator d = devicesToRemonitor.begin(); d != devicesToRemonitor.end(); ++d) {
+			restartMonitoringDevice(*d);
+		}
+	}
+#endif
+
 	newList.clear();
 }
 
@@ -353,8 +467,11 @@ void DeviceMonitor::queryNewDeviceForInfo(std::tr1::shared_ptr<Device> device) {
 	// TODO: do this in a separate thread.
 	std::tr1::shared_ptr<GetPropReceiver> rcvr(new GetPropReceiver(device));
 	try {
-		// first get the list of properties.
-		device->executeShellCommand(GetPropReceiver::GETPROP_COMMAND, rcvr.get());
+		// first get the list of properties, unless the tracking tags already gave the product
+		// ones: the others are then read by the first getProperty() call that misses.
+		if (device->getTrackingTag("model").empty()) {
+			device->executeShellCommand(GetPropReceiver::GETPROP_COMMAND, rcvr.get());
+		}
 
 		queryNewDeviceForMountingPoint(device, Device::MNT_EXTERNAL_STORAGE);
 		queryNewDeviceForMountingPoint(device, Device::MNT_DATA);
@@ -368,6 +485,7 @@ void DeviceMonitor::queryNewDeviceForInfo(std::tr1::shared_ptr<Device> device) {
 				 device->setAvdName(console->getAvdName());
 			 }
 		}
+		device->setInfoQueried(true);
 	} catch (Poco::TimeoutException &e) {
 		Log::w("DeviceMonitor", "Connection timeout getting info for device " + device->getSerialNumber());
 	} catch (AdbCommandRejectedException &e) {
@@ -467,6 +585,23 @@ bool DeviceMonitor::startMonitoringDevice(std::tr1::shared_ptr<Device> device) {
 	return false;
 }
 
+void DeviceMonitor::restartMonitoringDevice(std::tr1::shared_ptr<Device> device) {
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> oldChannel = device->getClientMonitoringSocket();
+	if (oldChannel != nullptr) {
+		device->unregisterFromReactor();
+		try {
+			oldChannel->close();
+		} catch (Poco::IOException &e) {
+			// doesn't really matter if the close fails.
+		}
+		device->setClientMonitoringSocket(std::tr1::shared_ptr<Poco::Net::StreamSocket>());
+	}
+
+	if (!startMonitoringDevice(device)) {
+		Log::e("DeviceMonitor", "Failed to restart monitoring " + device->getSerialNumber());
+	}
+}
+
 void DeviceMonitor::startDeviceMonitorThread() {
 	mDeviceClientThread->setName("DDMLib device client thread");
 	mDeviceClientThread->start(*raDeviceClientMonitorThread);
@@ -640,7 +775,7 @@ void DeviceMonitor::processIncomingJdwpData(std::tr1::shared_ptr<Device> device,
 void DeviceMonitor::openClient(std::tr1::shared_ptr<Device> device, int pid, int port) {
 	std::tr1::shared_ptr<Poco::Net::StreamSocket> clientSocket;
 	try {
-		clientSocket = AdbHelper::createPassThroughConnection(AndroidDebugBridge::getSocketAddress(), device, pid);
+		clientSocket = AdbHelper::createPassThroughConnection(mServerAddress, device, pid);
 
 		// required for Selector
 		// clientSocket.configureBlocking(false);
@@ -706,21 +841,12 @@ void DeviceMonitor::createClient(std::tr1::shared_ptr<Device> device, int pid, s
 }
 
 int DeviceMonitor::getNextDebuggerPort() {
-	Poco::ScopedLock<Poco::Mutex> lock(mDebuggerPortsLock);
-	if (!mDebuggerPorts.empty()) {
-		int port = mDebuggerPorts[0];
-
-		// remove it.
-		mDebuggerPorts.erase(mDebuggerPorts.begin());
-
-		// if there's nothing left, add the next port to the list
-		if (mDebuggerPorts.size() == 0) {
-			mDebuggerPorts.push_back(port + 1);
-		}
-
-		return port;
+	// the ports are shared by the monitors of all the adb servers, they bind on the same host.
+	std::tr1::shared_ptr<AndroidDebugBridge> server = mServer.lock();
+	if (server == nullptr) {
+		return -1;
 	}
-	return -1;
+	return server->getNextDebuggerPort();
 }
 #endif
 
@@ -762,26 +888,22 @@ std::string DeviceMonitor::read(std::tr1::shared_ptr<Poco::Net::StreamSocket> so
 	//return "";
 }
 
-DeviceMonitor::DeviceMonitor(std::tr1::shared_ptr<AndroidDebugBridge> androidDebugBridge) :
-		mQuit(false), mServer(androidDebugBridge), mMonitoring(false), mConnectionAttempt(0), mRestartAttemptCount(0), mInitialDeviceListDone(
-				false), mMonitorThread(new Poco::Thread("Device List Monitor")), raMonitorThread(
+DeviceMonitor::DeviceMonitor(std::tr1::shared_ptr<AndroidDebugBridge> androidDebugBridge, const AdbServerAddress &serverAddress) :
+		mQuit(false), mServer(androidDebugBridge), mServerAddress(serverAddress), mMonitoring(false), mConnectionAttempt(0), mRestartAttemptCount(0), mInitialDeviceListDone(
+				false), mLongTrackingFormat(true), mDevicesSuspect(false), mMonitorThread(new Poco::Thread("Device List Monitor " + serverAddress.toString())), raMonitorThread(
 				new Poco::RunnableAdapter<DeviceMonitor>(*this, &DeviceMonitor::deviceMonitorLoop))
 #ifdef CLIENT_SUPPORT
 				,
 				mDeviceClientThread(
-				new Poco::Thread("Device Client Monitor")),
+				new Poco::Thread("Device Client Monitor " + serverAddress.toString())),
 				raDeviceClientMonitorThread(
-				new Poco::RunnableAdapter<DeviceMonitor>(*this, &DeviceMonitor::deviceClientMonitorLoop)) 
+				new Poco::RunnableAdapter<DeviceMonitor>(*this, &DeviceMonitor::deviceClientMonitorLoop))
 #endif
 		{
 	for (int i = 0; i != mLengthBufferSize; ++i) {
 		mLengthBuffer[i] = 0;
 		mLengthBuffer2[i] = 0;
 	}
-
-#ifdef CLIENT_SUPPORT
-	mDebuggerPorts.push_back(DdmPreferences::getDebugPortBase());
-#endif
 }
 
 void DeviceMonitor::start() {
@@ -848,24 +970,9 @@ void DeviceMonitor::acceptNewDebugger(std::tr1::shared_ptr<Debugger> dbg, std::t
 }
 
 void DeviceMonitor::addPortToAvailableList(int port) {
-	if (port > 0) {
-		{
-			Poco::ScopedLock<Poco::Mutex> lock(mDebuggerPortsLock);
-			// because there could be case where clients are closed twice, we have to make
-			// sure the port number is not already in the list.
-			if (std::find(mDebuggerPorts.begin(), mDebuggerPorts.end(), port) == mDebuggerPorts.end()) {
-				// add the port to the list while keeping it sorted. It's not like there's
-				// going to be tons of objects so we do it linearly.
-				int count = mDebuggerPorts.size();
-				for (int i = 0; i < count; i++) {
-					if (port < mDebuggerPorts[i]) {
-						mDebuggerPorts.insert(mDebuggerPorts.begin() + i, port);
-						break;
-					}
-				}
-				// TODO: check if we can compact the end of the list.
-			}
-		}
+	std::tr1::shared_ptr<AndroidDebugBridge> server = mServer.lock();
+	if (server != nullptr) {
+		server->addPortToAvailableList(port);
 	}
 }
 #endif
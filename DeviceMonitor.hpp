@@ -9,6 +9,7 @@
 #define DEVICEMONITOR_HPP_
 
 #include "ddmlib.hpp"
+#include "AdbServerAddress.hpp"
 
 namespace ddmlib {
 
@@ -34,17 +35,32 @@ class DDMLIB_LOCAL DeviceMonitor: public std::tr1::enable_shared_from_this<Devic
 
 	std::tr1::weak_ptr<AndroidDebugBridge> mServer;
 
+	/** address of the adb server this monitor tracks devices from. */
+	AdbServerAddress mServerAddress;
+
 	std::tr1::shared_ptr<Poco::Net::StreamSocket> mMainAdbConnection;
 	bool mMonitoring;
 	int mConnectionAttempt;
 	int mRestartAttemptCount;
 	bool mInitialDeviceListDone;
 
+	/**
+	 * Whether the long <code>host:track-devices-l</code> format is requested. Cleared if the
+	 * adb server doesn't support it.
+	 */
+	bool mLongTrackingFormat;
+
+	/**
+	 * Set when the tracking connection to adb was lost while devices were known. Until the
+	 * next device list arrives, or {@link #DEVICE_GRACE_PERIOD} expires, the devices are kept
+	 * as "suspect" instead of being disconnected.
+	 */
+	bool mDevicesSuspect;
+	Poco::Timestamp mSuspectSince;
+
 	std::vector<std::tr1::shared_ptr<Device> > mDevices;
 	Poco::Mutex mDevicesLock;
 #ifdef CLIENT_SUPPORT
-	std::vector<int> mDebuggerPorts;
-	Poco::Mutex mDebuggerPortsLock;
 	std::map<std::tr1::shared_ptr<Client>, int> mClientsToReopen;
 	Poco::Mutex mClientsLock;
 
@@ -84,6 +100,16 @@ class DDMLIB_LOCAL DeviceMonitor: public std::tr1::enable_shared_from_this<Devic
 
 	void handleExceptionInMonitorLoop(std::exception &e); // was handleExpectioninMonitorLoop in java. Srsly?
 
+	/**
+	 * Removes all the devices, notifying the listeners in the background.
+	 */
+	void removeAllDevices();
+
+	/**
+	 * Removes the suspect devices if adb didn't send a new device list within the grace period.
+	 */
+	void expireSuspectDevices();
+
 	/**
 	 * Processes an incoming device message from the socket
 	 * @param socket
@@ -92,6 +118,16 @@ class DDMLIB_LOCAL DeviceMonitor: public std::tr1::enable_shared_from_this<Devic
 	 */
 	void processIncomingDeviceData(int length);
 
+	/**
+	 * Parses a line of the device tracking service. Both the plain format
+	 * (<code>serial\tstate</code>) and the long format
+	 * (<code>serial state [usb:path] [product:x model:y device:z] [transport_id:n]</code>)
+	 * are supported.
+	 * @return false if the line doesn't describe a device.
+	 */
+	static bool parseDeviceLine(const std::string &line, std::string &serial, std::string &state,
+			std::map<std::string, std::string> &tags);
+
 	/**
 	 *  Updates the device list with the new items received from the monitoring service.
 	 */
@@ -151,15 +187,23 @@ class DDMLIB_LOCAL DeviceMonitor: public std::tr1::enable_shared_from_this<Devic
 	std::string read(std::tr1::shared_ptr<Poco::Net::StreamSocket> socket, size_t size);
 
 public:
+	/**
+	 * How long (in ms) devices are kept after the tracking connection to adb is lost.
+	 */
+	static const int DEVICE_GRACE_PERIOD = 10000;
+
 	virtual ~DeviceMonitor() {
 	}
 
 	/**
-	 * Creates a new {@link DeviceMonitor} object and links it to the running
-	 * {@link AndroidDebugBridge} object.
+	 * Creates a new {@link DeviceMonitor} object tracking the devices of an adb server.
+	 * <p/>Only the monitor of the bridge's default server ({@link AndroidDebugBridge#getSocketAddress()})
+	 * will try to (re)start adb when the server can't be reached; other monitors just keep
+	 * retrying the connection.
 	 * @param server the running {@link AndroidDebugBridge}.
+	 * @param serverAddress the adb server to connect to.
 	 */
-	DeviceMonitor(std::tr1::shared_ptr<AndroidDebugBridge> androidDebugBridge);
+	DeviceMonitor(std::tr1::shared_ptr<AndroidDebugBridge> androidDebugBridge, const AdbServerAddress &serverAddress);
 
 	/**
 	 * Starts the monitoring.
@@ -186,6 +230,13 @@ public:
 
 	std::tr1::shared_ptr<AndroidDebugBridge> getServer();
 
+	/**
+	 * Returns the address of the adb server this monitor is connected to.
+	 */
+	const AdbServerAddress &getServerAddress() const {
+		return mServerAddress;
+	}
+
 #ifdef CLIENT_SUPPORT
 	void addClientToDropAndReopen(std::tr1::shared_ptr<Client> client, int port);
 
@@ -195,6 +246,9 @@ public:
 	 */
 	void acceptNewDebugger(std::tr1::shared_ptr<Debugger> dbg, std::tr1::shared_ptr<Poco::Net::ServerSocket> acceptChan);
 
+	/**
+	 * Gives a debugger port back to the allocator of the bridge.
+	 */
 	void addPortToAvailableList(int port);
 #endif
 
@@ -216,6 +270,13 @@ public:
 	 */
 	bool startMonitoringDevice(std::tr1::shared_ptr<Device> device);
 
+	/**
+	 * Replaces the jdwp tracking connection of a device which survived an adb reconnection.
+	 * The clients of the device are kept.
+	 * @param device the device to monitor.
+	 */
+	void restartMonitoringDevice(std::tr1::shared_ptr<Device> device);
+
 	std::tr1::shared_ptr<Device> findDeviceBySerial(const std::string &serial);
 };
 
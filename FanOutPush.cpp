@@ -0,0 +1,241 @@
+/*
+ * FanOutPush.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "FanOutPush.hpp"
+#include "Device.hpp"
+#include "AdbHelper.hpp"
+#include "ArrayHelper.hpp"
+#include "DdmPreferences.hpp"
+#include "Log.hpp"
+#include "SyncException.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+namespace ddmlib {
+
+bool FanOutPush::SharedProgressMonitor::isCanceled() const {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mMonitor->isCanceled();
+}
+
+void FanOutPush::SharedProgressMonitor::startSubTask(const std::string &name) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mMonitor->startSubTask(name);
+}
+
+void FanOutPush::SharedProgressMonitor::advance(long long work) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mMonitor->advance(work);
+}
+
+FanOutPush::FanOutPush(const std::vector<std::tr1::shared_ptr<Device> >& devices, int cacheBlocks) :
+		mDevices(devices), mCacheBlocks(cacheBlocks > 0 ? cacheBlocks : 1), mSize(0), mMtime(0), mBlockCount(0),
+		mBlockReads(0), mHasManifestEntry(false) {
+#ifndef _WIN32
+	mFd = -1;
+#endif
+}
+
+FanOutPush::~FanOutPush() {
+}
+
+std::vector<FanOutPush::Result> FanOutPush::push(const std::string& local, const std::string& remote,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	return push(local, remote, monitor.get());
+}
+
+std::vector<FanOutPush::Result> FanOutPush::push(const std::string& local, const std::string& remote,
+		ISyncProgressMonitor* monitor) {
+	Poco::File f(local);
+	if (f.exists() == false) {
+		throw SyncException(SyncException::NO_LOCAL_FILE);
+	}
+	if (f.isDirectory()) {
+		throw SyncException(SyncException::LOCAL_IS_DIRECTORY);
+	}
+
+	mLocalPath = local;
+	mRemotePath = remote;
+	mSize = (long long) f.getSize();
+	mMtime = (long long) f.getLastModified().epochTime();
+	mBlockCount = (mSize + SyncService::SYNC_DATA_MAX - 1) / SyncService::SYNC_DATA_MAX;
+	mCache.clear();
+	mBlockReads = 0;
+	mHasManifestEntry = false;
+
+#ifndef _WIN32
+	mFd = ::open(local.c_str(), O_RDONLY);
+	if (mFd < 0) {
+		throw SyncException(SyncException::FILE_READ_ERROR);
+	}
+#else
+	mStream = std::tr1::shared_ptr<Poco::FileInputStream>(
+			new Poco::FileInputStream(local, std::ios::in | std::ios::binary));
+#endif
+
+	mResults.clear();
+	for (std::vector<std::tr1::shared_ptr<Device> >::const_iterator d = mDevices.begin(); d != mDevices.end(); ++d) {
+		Result result;
+		result.device = *d;
+		result.success = false;
+		mResults.push_back(result);
+	}
+
+	mMonitor = std::tr1::shared_ptr<SharedProgressMonitor>(new SharedProgressMonitor(monitor));
+	monitor->start(mSize * (long long) mDevices.size());
+	monitor->startSubTask(remote);
+
+	std::vector<std::tr1::shared_ptr<Worker> > workers;
+	std::vector<std::tr1::shared_ptr<Poco::Thread> > threads;
+	for (size_t i = 0; i < mDevices.size(); ++i) {
+		workers.push_back(std::tr1::shared_ptr<Worker>(new Worker(*this, i)));
+		threads.push_back(std::tr1::shared_ptr<Poco::Thread>(new Poco::Thread("Fan-out push " + Poco::NumberFormatter::format(i))));
+		threads.back()->start(*workers.back());
+	}
+	for (std::vector<std::tr1::shared_ptr<Poco::Thread> >::iterator t = threads.begin(); t != threads.end(); ++t) {
+		(*t)->join();
+	}
+
+#ifndef _WIN32
+	::close(mFd);
+	mFd = -1;
+#else
+	mStream.reset();
+#endif
+	mCache.clear();
+
+	monitor->stop();
+
+	return mResults;
+}
+
+void FanOutPush::runWorker(size_t index) {
+	Result& result = mResults[index];
+	std::tr1::shared_ptr<SyncService> service;
+	try {
+		service = result.device->getSyncService();
+		if (service == nullptr) {
+			throw Poco::IOException("Unable to open sync connection!");
+		}
+
+		std::tr1::shared_ptr<PushManifest> manifest = service->getPushManifest();
+		if (manifest && manifest->isPushed(mLocalPath, mRemotePath)) {
+			mMonitor->advance(mSize);
+		} else {
+			if (manifest) {
+				manifest->forget(mRemotePath);
+			}
+
+			int timeOut = DdmPreferences::getTimeOut();
+			service->sendSendRequest(mRemotePath, 0644, timeOut);
+			for (long long i = 0; i < mBlockCount; ++i) {
+				if (mMonitor->isCanceled()) {
+					throw SyncException(SyncException::CANCELED);
+				}
+
+				std::tr1::shared_ptr<Block> block = getBlock(i);
+				service->pace((unsigned int) block->frame.size() - 8);
+				AdbHelper::write(service->mChannel, &block->frame[0], (int) block->frame.size(), timeOut);
+				mMonitor->advance((long long) block->frame.size() - 8);
+			}
+			service->finishSend(mMtime, timeOut);
+
+			if (manifest) {
+				manifest->record(mLocalPath, mRemotePath, getManifestEntry());
+			}
+		}
+		result.success = true;
+	} catch (Poco::Exception& e) {
+		result.error = e.displayText();
+	} catch (std::exception& e) {
+		result.error = e.what();
+	}
+
+	if (!result.success) {
+		Log::e("ddms", "Push of " + mLocalPath + " to " + result.device->getSerialNumber() + " failed: " + result.error);
+	}
+	if (service != nullptr) {
+		service->close();
+	}
+}
+
+std::tr1::shared_ptr<FanOutPush::Block> FanOutPush::getBlock(long long index) {
+	{
+		Poco::FastMutex::ScopedLock lock(mCacheLock);
+		std::map<long long, std::tr1::shared_ptr<Block> >::const_iterator b = mCache.find(index);
+		if (b != mCache.end()) {
+			return b->second;
+		}
+	}
+
+	// read outside of the lock, the other connections keep sending the cached blocks.
+	std::tr1::shared_ptr<Block> block = readBlock(index);
+
+	Poco::FastMutex::ScopedLock lock(mCacheLock);
+	++mBlockReads;
+	std::pair<std::map<long long, std::tr1::shared_ptr<Block> >::iterator, bool> inserted = mCache.insert(
+			std::make_pair(index, block));
+	if (inserted.second == false) {
+		// another connection read it meanwhile.
+		return inserted.first->second;
+	}
+	if (mCache.size() > mCacheBlocks) {
+		// drop the oldest block: the connections needing it are the late ones. If it is the one
+		// just read, the late connection keeps it for itself.
+		mCache.erase(mCache.begin());
+	}
+	return block;
+}
+
+std::tr1::shared_ptr<FanOutPush::Block> FanOutPush::readBlock(long long index) {
+	long long offset = index * SyncService::SYNC_DATA_MAX;
+	unsigned int length = (unsigned int) std::min(mSize - offset, (long long) SyncService::SYNC_DATA_MAX);
+
+	std::tr1::shared_ptr<Block> block(new Block);
+	block->frame.resize(8 + length);
+	std::copy(SyncService::ID_DATA, SyncService::ID_DATA + 4, block->frame.begin());
+	ArrayHelper::swap32bitsToArray(length, block->frame, 4);
+
+#ifndef _WIN32
+	unsigned int done = 0;
+	while (done < length) {
+		ssize_t count = ::pread(mFd, &block->frame[8 + done], length - done, (off_t) (offset + done));
+		if (count < 0 && errno == EINTR) {
+			continue;
+		}
+		if (count <= 0) {
+			throw SyncException(SyncException::FILE_READ_ERROR);
+		}
+		done += (unsigned int) count;
+	}
+#else
+	Poco::FastMutex::ScopedLock lock(mReadLock);
+	mStream->clear();
+	mStream->seekg((std::streamoff) offset);
+	mStream->read(reinterpret_cast<char*>(&block->frame[8]), length);
+	if ((unsigned int) mStream->gcount() != length) {
+		throw SyncException(SyncException::FILE_READ_ERROR);
+	}
+#endif
+	return block;
+}
+
+PushManifest::Entry FanOutPush::getManifestEntry() {
+	Poco::FastMutex::ScopedLock lock(mManifestLock);
+	if (!mHasManifestEntry) {
+		mManifestEntry = PushManifest::createEntry(mLocalPath);
+		mHasManifestEntry = true;
+	}
+	return mManifestEntry;
+}
+
+} /* namespace ddmlib */
@@ -0,0 +1,157 @@
+/*
+ * FanOutPush.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef FANOUTPUSH_HPP_
+#define FANOUTPUSH_HPP_
+#include "ddmlib.hpp"
+#include "SyncService.hpp"
+#include "PushManifest.hpp"
+
+namespace ddmlib {
+
+class Device;
+
+/**
+ * Pushes one local file to several devices at once, reading it only once.
+ * <p/>The file is read in blocks which are kept, ready to be sent as DATA frames, in a cache
+ * shared by the sync connections of all the devices. Each device goes at its own pace: the
+ * cache holds a fixed number of blocks, the oldest ones being dropped first. A device which
+ * falls too far behind reads the blocks it misses again, but never holds back the others.
+ * Memory use doesn't depend on the number of devices, beside the block each connection is
+ * sending.
+ * <p/>A failure only affects its device. The outcome for each device is returned by
+ * {@link #push}.
+ */
+class DDMLIB_API FanOutPush {
+public:
+	/** Default number of blocks (of {@link SyncService#SYNC_DATA_MAX} bytes) kept in the cache. */
+	static const int DEFAULT_CACHE_BLOCKS = 64;
+
+	/**
+	 * Outcome of the push for one device.
+	 */
+	struct Result {
+		std::tr1::shared_ptr<Device> device;
+		bool success;
+		/** the reason of the failure, if <var>success</var> is false. */
+		std::string error;
+	};
+
+	/**
+	 * @param devices the devices to push to.
+	 * @param cacheBlocks the number of blocks of the file kept in memory.
+	 */
+	FanOutPush(const std::vector<std::tr1::shared_ptr<Device> >& devices, int cacheBlocks = DEFAULT_CACHE_BLOCKS);
+	virtual ~FanOutPush();
+
+	/**
+	 * Pushes a file to all the devices.
+	 * <p/>Devices with a {@link PushManifest} skip the push if they already have the content.
+	 * @param local the local filepath.
+	 * @param remote The remote filepath.
+	 * @param monitor The progress monitor. Cannot be null. The total work is the size of the
+	 *      file times the number of devices.
+	 * @return the outcome for each device, in the order of the devices.
+	 * @throws SyncException if the local file doesn't exist or can't be read.
+	 */
+	std::vector<Result> push(const std::string& local, const std::string& remote,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	std::vector<Result> push(const std::string& local, const std::string& remote, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Returns how many blocks were read from the local file by the last push. This is the
+	 * block count of the file when no device fell behind.
+	 */
+	long long getBlockReads() const {
+		return mBlockReads;
+	}
+
+private:
+	/**
+	 * A block of the file, with its DATA header.
+	 */
+	struct Block {
+		std::vector<unsigned char> frame;
+	};
+
+	/**
+	 * Forwards the progress of all the connections to the user's monitor.
+	 */
+	class SharedProgressMonitor: public ISyncProgressMonitor {
+		ISyncProgressMonitor *mMonitor;
+		mutable Poco::FastMutex mLock;
+	public:
+		SharedProgressMonitor(ISyncProgressMonitor *monitor) :
+				mMonitor(monitor) {
+		}
+		void start(long long /*totalWork*/) {
+		}
+		void stop() {
+		}
+		bool isCanceled() const;
+		void startSubTask(const std::string &name);
+		void advance(long long work);
+	};
+
+	class Worker: public Poco::Runnable {
+		FanOutPush &mOwner;
+		size_t mIndex;
+	public:
+		Worker(FanOutPush &owner, size_t index) :
+				mOwner(owner), mIndex(index) {
+		}
+		void run() {
+			mOwner.runWorker(mIndex);
+		}
+	};
+
+	friend class Worker;
+
+	std::vector<std::tr1::shared_ptr<Device> > mDevices;
+	size_t mCacheBlocks;
+
+	std::string mLocalPath;
+	std::string mRemotePath;
+	long long mSize;
+	long long mMtime;
+	long long mBlockCount;
+
+	std::vector<Result> mResults;
+	std::tr1::shared_ptr<SharedProgressMonitor> mMonitor;
+
+	/** the blocks by index. */
+	std::map<long long, std::tr1::shared_ptr<Block> > mCache;
+	Poco::FastMutex mCacheLock;
+	volatile long long mBlockReads;
+
+#ifndef _WIN32
+	int mFd;
+#else
+	std::tr1::shared_ptr<Poco::FileInputStream> mStream;
+	Poco::FastMutex mReadLock;
+#endif
+
+	/** the manifest entry of the file, computed once for all the devices. */
+	bool mHasManifestEntry;
+	PushManifest::Entry mManifestEntry;
+	Poco::FastMutex mManifestLock;
+
+	/**
+	 * Returns a block from the cache, reading it if needed.
+	 */
+	std::tr1::shared_ptr<Block> getBlock(long long index);
+
+	std::tr1::shared_ptr<Block> readBlock(long long index);
+
+	PushManifest::Entry getManifestEntry();
+
+	void runWorker(size_t index);
+};
+
+} /* namespace ddmlib */
+#endif /* FANOUTPUSH_HPP_ */
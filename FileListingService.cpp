@@ -8,6 +8,7 @@
 #include "ddmlib.hpp"
 #include "FileListingService.hpp"
 #include "Device.hpp"
+#include "SyncService.hpp"
 
 namespace ddmlib {
 std::string FileListingService::DIRECTORY_DATA = "data";
@@ -52,7 +53,7 @@ Poco::FastMutex FileListingService::mLock;
 std::map<std::tr1::shared_ptr<Poco::Thread>, std::tr1::shared_ptr<FileListingService::getChildrenThread> > FileListingService::mThreadMap;
 
 FileListingService::FileListingService(std::tr1::shared_ptr<Device> Device) :
-		mDevice(Device) {
+		mDevice(Device), mUseSyncListing(false) {
 }
 
 FileListingService::~FileListingService() {
@@ -361,6 +362,11 @@ void FileListingService::doLs(std::tr1::shared_ptr<FileEntry> entry) {
 }
 
 void FileListingService::doLsAndThrow(std::tr1::shared_ptr<FileEntry> entry) {
+	if (mUseSyncListing) {
+		doSyncLs(entry);
+		return;
+	}
+
 	// create a list that will receive the list of the entries
 	std::vector<std::tr1::shared_ptr<FileEntry> > entryList;
 
@@ -392,6 +398,105 @@ void FileListingService::doLsAndThrow(std::tr1::shared_ptr<FileEntry> entry) {
 	entry->setChildren(entryList);
 }
 
+void FileListingService::doSyncLs(std::tr1::shared_ptr<FileEntry> entry) {
+	std::vector<SyncService::DirEntry> listing;
+	{
+		Poco::ScopedLock<Poco::FastMutex> lock(mSyncLock);
+		if (mSyncService == nullptr) {
+			mSyncService = mDevice->getSyncService();
+			if (mSyncService == nullptr) {
+				throw Poco::IOException("Unable to open sync connection!");
+			}
+		}
+		try {
+			mSyncService->listDirectory(entry->getFullPath(), listing);
+		} catch (...) {
+			// the connection is in an unknown state, the next listing opens a new one.
+			mSyncService.reset();
+			throw;
+		}
+	}
+
+	// reuse the existing entries, so the children don't collapse during the update.
+	std::vector<std::tr1::shared_ptr<FileEntry> > currentChildren = entry->getCachedChildren();
+	std::vector<std::tr1::shared_ptr<FileEntry> > entryList;
+	for (std::vector<SyncService::DirEntry>::const_iterator d = listing.begin(); d != listing.end(); ++d) {
+		// if the parent is root, we only accept selected items
+		if (entry->isRoot()) {
+			if (std::find(sRootLevelApprovedItems, sRootLevelApprovedItems + NUM_DIRECTORY, d->name)
+					== sRootLevelApprovedItems + NUM_DIRECTORY) {
+				continue;
+			}
+		}
+
+		int objectType = SyncService::getFileType(d->stat.mode);
+
+		std::tr1::shared_ptr<FileEntry> child;
+		for (std::vector<std::tr1::shared_ptr<FileEntry> >::iterator c = currentChildren.begin(); c != currentChildren.end(); ++c) {
+			if (*c != nullptr && (*c)->name == d->name) {
+				child = *c;
+				c->reset();
+				break;
+			}
+		}
+		if (child == nullptr) {
+			child = std::tr1::shared_ptr<FileEntry>(new FileEntry(entry, d->name, objectType, false /* isRoot */));
+		}
+
+		Poco::LocalDateTime mtime(Poco::Timestamp::fromEpochTime((std::time_t) d->stat.mtime));
+		child->permissions = getPermissions(d->stat.mode, objectType);
+		child->size = Poco::NumberFormatter::format(d->stat.size);
+		child->date = Poco::DateTimeFormatter::format(mtime, "%Y-%m-%d");
+		child->time = Poco::DateTimeFormatter::format(mtime, "%H:%M");
+		child->owner = "";
+		child->group = "";
+
+		entryList.push_back(child);
+	}
+
+	// at this point we need to refresh the viewer
+	entry->fetchTime = Poco::Timestamp().epochMicroseconds() / 1000;
+
+	entry->setChildren(entryList);
+}
+
+std::string FileListingService::getPermissions(int mode, int type) {
+	// the same form as the first column of ls -l.
+	std::string permissions = "----------";
+	if (type == TYPE_DIRECTORY) {
+		permissions[0] = 'd';
+	} else if (type == TYPE_LINK) {
+		permissions[0] = 'l';
+	} else if (type == TYPE_BLOCK) {
+		permissions[0] = 'b';
+	} else if (type == TYPE_CHARACTER) {
+		permissions[0] = 'c';
+	} else if (type == TYPE_SOCKET) {
+		permissions[0] = 's';
+	} else if (type == TYPE_FIFO) {
+		permissions[0] = 'p';
+	}
+
+	const char flags[] = "rwxrwxrwx";
+	for (int i = 0; i < 9; ++i) {
+		if ((mode & (0400 >> i)) != 0) {
+			permissions[i + 1] = flags[i];
+		}
+	}
+
+	// setuid, setgid and sticky bits.
+	if ((mode & 04000) != 0) {
+		permissions[3] = (mode & 0100) != 0 ? 's' : 'S';
+	}
+	if ((mode & 02000) != 0) {
+		permissions[6] = (mode & 010) != 0 ? 's' : 'S';
+	}
+	if ((mode & 01000) != 0) {
+		permissions[9] = (mode & 01) != 0 ? 't' : 'T';
+	}
+	return permissions;
+}
+
 void FileListingService::getChildrenThread::run() {
 	mFileListingService->doLs(mEntry);
 
@@ -15,6 +15,7 @@
 namespace ddmlib {
 
 class Device;
+class SyncService;
 
 class DDMLIB_API FileListingService {
 public:
@@ -103,8 +104,8 @@ public:
 		/**
 		 * Returns the size of the entry.
 		 */
-		int getSizeValue() {
-			return Poco::NumberParser::parse(size);
+		long long getSizeValue() {
+			return Poco::NumberParser::parse64(size);
 		}
 
 		/**
@@ -334,6 +335,21 @@ public:
 	 * @throws IOException in case of I/O error on the connection.
 	 */
 	std::vector<std::tr1::shared_ptr<FileEntry> > getChildrenSync(std::tr1::shared_ptr<FileEntry> entry);
+
+	/**
+	 * Sets whether directories are listed with the sync LIST request instead of
+	 * <code>ls -l</code>.
+	 * <p/>LIST is answered by adbd itself and is much faster on large directories, but it
+	 * doesn't give the owner and group of the entries, nor the targets of the links.
+	 */
+	void setUseSyncListing(bool useSyncListing) {
+		mUseSyncListing = useSyncListing;
+	}
+
+	bool getUseSyncListing() const {
+		return mUseSyncListing;
+	}
+
 	FileListingService(std::tr1::shared_ptr<Device> Device);
 	virtual ~FileListingService();
 
@@ -407,6 +423,11 @@ private:
 
 	void doLs(std::tr1::shared_ptr<FileEntry> entry);
 	void doLsAndThrow(std::tr1::shared_ptr<FileEntry> entry);
+	/**
+	 * Lists a directory with the sync LIST request, reusing the existing children.
+	 */
+	void doSyncLs(std::tr1::shared_ptr<FileEntry> entry);
+	static std::string getPermissions(int mode, int type);
 	/** Pattern to find filenames that match "*.apk" */
 	static Poco::RegularExpression sApkPattern;
 	static std::string PM_FULL_LISTING;
@@ -422,6 +443,11 @@ private:
 
 	std::tr1::shared_ptr<Device> mDevice;
 	std::tr1::shared_ptr<FileEntry> mRoot;
+
+	bool mUseSyncListing;
+	/** opened on the first sync listing, and kept for the next ones. */
+	std::tr1::shared_ptr<SyncService> mSyncService;
+	Poco::FastMutex mSyncLock;
 	static std::map<std::tr1::shared_ptr<Poco::Thread>, std::tr1::shared_ptr<getChildrenThread> > mThreadMap;
 
 };
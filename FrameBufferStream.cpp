@@ -0,0 +1,108 @@
+/*
+ * FrameBufferStream.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "FrameBufferStream.hpp"
+#include "AdbHelper.hpp"
+#include "Device.hpp"
+#include "TransferScheduler.hpp"
+#include <cstring>
+
+namespace ddmlib {
+
+FrameBufferStream::FrameBufferStream(std::tr1::shared_ptr<Device> device, int tileSize) :
+		mDevice(device), mTileSize(tileSize > 0 ? tileSize : DEFAULT_TILE_SIZE), mCurrent(0), mHasPrevious(false),
+		mFrameCount(0), mChangedFrameCount(0) {
+}
+
+FrameBufferStream::~FrameBufferStream() {
+}
+
+bool FrameBufferStream::capture(IFrameListener* listener) {
+	RawImage& current = mFrames[mCurrent];
+	if (AdbHelper::readFrameBuffer(mDevice->getServerAddress(), mDevice.get(), current) == false) {
+		throw Poco::ProtocolException("Unsupported framebuffer protocol");
+	}
+	++mFrameCount;
+
+	// the frames share the link with the other interactive traffic of the device.
+	std::tr1::shared_ptr<TransferScheduler> scheduler = mDevice->getTransferScheduler();
+	if (scheduler) {
+		scheduler->record(TransferScheduler::PRIORITY_INTERACTIVE, (unsigned int) current.size);
+	}
+
+	const RawImage* previous = mHasPrevious ? &mFrames[1 - mCurrent] : nullptr;
+	computeDirtyTiles(current, previous, mTiles);
+
+	// the next frame is read into the older buffer.
+	mCurrent = 1 - mCurrent;
+	mHasPrevious = true;
+
+	if (mTiles.empty()) {
+		return false;
+	}
+
+	++mChangedFrameCount;
+	listener->frameChanged(current, mTiles);
+	return true;
+}
+
+void FrameBufferStream::run(IFrameListener* listener, int intervalMs) {
+	Poco::Timestamp::TimeDiff interval = (Poco::Timestamp::TimeDiff) intervalMs * 1000;
+	while (listener->isCancelled() == false) {
+		Poco::Timestamp start;
+		capture(listener);
+
+		Poco::Timestamp::TimeDiff elapsed = start.elapsed();
+		if (elapsed < interval) {
+			Poco::Thread::sleep((long) ((interval - elapsed) / 1000));
+		}
+	}
+}
+
+void FrameBufferStream::computeDirtyTiles(const RawImage& current, const RawImage* previous,
+		std::vector<FrameTile>& tiles) {
+	tiles.clear();
+
+	int bytesPerPixel = current.bpp / 8;
+	int stride = current.width * bytesPerPixel;
+	bool comparable = previous != nullptr && isSameGeometry(current, *previous) && bytesPerPixel > 0
+			&& (long long) stride * current.height <= (long long) current.data.size();
+
+	for (int y = 0; y < current.height; y += mTileSize) {
+		int tileHeight = std::min(mTileSize, current.height - y);
+		for (int x = 0; x < current.width; x += mTileSize) {
+			int tileWidth = std::min(mTileSize, current.width - x);
+
+			bool dirty = !comparable;
+			if (comparable) {
+				// compare the rows of the tile, up to the first difference.
+				size_t offset = (size_t) y * stride + (size_t) x * bytesPerPixel;
+				size_t length = (size_t) tileWidth * bytesPerPixel;
+				for (int row = 0; row < tileHeight && !dirty; ++row, offset += stride) {
+					dirty = memcmp(&current.data[offset], &previous->data[offset], length) != 0;
+				}
+			}
+
+			if (dirty) {
+				FrameTile tile;
+				tile.x = x;
+				tile.y = y;
+				tile.width = tileWidth;
+				tile.height = tileHeight;
+				tiles.push_back(tile);
+			}
+		}
+	}
+}
+
+bool FrameBufferStream::isSameGeometry(const RawImage& image1, const RawImage& image2) {
+	return image1.width == image2.width && image1.height == image2.height && image1.bpp == image2.bpp
+			&& image1.size == image2.size && image1.data.size() == image2.data.size();
+}
+
+} /* namespace ddmlib */
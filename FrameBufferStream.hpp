@@ -0,0 +1,125 @@
+/*
+ * FrameBufferStream.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef FRAMEBUFFERSTREAM_HPP_
+#define FRAMEBUFFERSTREAM_HPP_
+#include "ddmlib.hpp"
+#include "RawImage.hpp"
+
+namespace ddmlib {
+
+class Device;
+
+/**
+ * A rectangle of a frame, in pixels.
+ */
+struct DDMLIB_API FrameTile {
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+/**
+ * Classes which implement this interface receive the frames captured by a
+ * {@link FrameBufferStream}.
+ */
+class DDMLIB_API IFrameListener {
+public:
+	/**
+	 * Called when a captured frame differs from the previous one.
+	 * @param frame the frame. It is a pooled buffer, only valid during the call.
+	 * @param tiles the tiles which changed. All of them for the first frame, or when the
+	 *      geometry of the frame changed.
+	 */
+	virtual void frameChanged(const RawImage& frame, const std::vector<FrameTile>& tiles) = 0;
+	/**
+	 * Stops {@link FrameBufferStream#run} when it returns true.
+	 */
+	virtual bool isCancelled() = 0;
+	virtual ~IFrameListener() {
+	}
+};
+
+/**
+ * Captures the framebuffer of a device continuously, reporting only the tiles which changed.
+ * <p/>The adb framebuffer service sends a single frame per connection, so each capture
+ * still opens one. The pixels are read from the connection straight into one of two pooled
+ * frames, which are only reallocated when the frame size changes. The new frame is compared
+ * with the previous one tile by tile, and unchanged frames are not reported at all.
+ * <p/>This class is not thread-safe: use one instance per device and thread.
+ */
+class DDMLIB_API FrameBufferStream {
+public:
+	/** Default width and height of the tiles, in pixels. */
+	static const int DEFAULT_TILE_SIZE = 64;
+
+	/**
+	 * Creates a stream.
+	 * @param device the {@link Device} to capture.
+	 * @param tileSize the width and height of the tiles, in pixels.
+	 */
+	FrameBufferStream(std::tr1::shared_ptr<Device> device, int tileSize = DEFAULT_TILE_SIZE);
+	virtual ~FrameBufferStream();
+
+	/**
+	 * Captures one frame, and passes it to <var>listener</var> if it changed.
+	 * @return true if the frame changed.
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws AdbCommandRejectedException if adb rejects the command
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws ProtocolException if the framebuffer protocol of the device is not supported.
+	 */
+	bool capture(IFrameListener* listener);
+
+	/**
+	 * Captures frames until <var>listener</var> is cancelled.
+	 * @param intervalMs the minimum time between the starts of two captures, in ms.
+	 * @throws same as {@link #capture}.
+	 */
+	void run(IFrameListener* listener, int intervalMs);
+
+	/**
+	 * Forgets the previous frame: the next one is reported whole.
+	 */
+	void reset() {
+		mHasPrevious = false;
+	}
+
+	long long getFrameCount() const {
+		return mFrameCount;
+	}
+
+	long long getChangedFrameCount() const {
+		return mChangedFrameCount;
+	}
+
+private:
+	std::tr1::shared_ptr<Device> mDevice;
+	int mTileSize;
+
+	/** the pooled frames, the current one alternating between both. */
+	RawImage mFrames[2];
+	int mCurrent;
+	bool mHasPrevious;
+
+	/** reused from frame to frame. */
+	std::vector<FrameTile> mTiles;
+
+	long long mFrameCount;
+	long long mChangedFrameCount;
+
+	/**
+	 * Lists the tiles of <var>current</var> which differ from <var>previous</var>.
+	 */
+	void computeDirtyTiles(const RawImage& current, const RawImage* previous, std::vector<FrameTile>& tiles);
+
+	static bool isSameGeometry(const RawImage& image1, const RawImage& image2);
+};
+
+} /* namespace ddmlib */
+#endif /* FRAMEBUFFERSTREAM_HPP_ */
@@ -0,0 +1,13 @@
+/*
+ * IRawOutputReceiver.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "IRawOutputReceiver.hpp"
+
+namespace ddmlib {
+
+} /* namespace ddmlib */
@@ -0,0 +1,39 @@
+/*
+ * IRawOutputReceiver.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef IRAWOUTPUTRECEIVER_HPP_
+#define IRAWOUTPUTRECEIVER_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+/**
+ * Classes which implement this interface receive the unmodified byte stream of a command
+ * run through the <code>exec:</code> service.
+ * <p/>Unlike {@link IShellOutputReceiver} users, implementations are not expected to split
+ * the output in lines: the data is binary-clean (no PTY, no <code>\n</code> to
+ * <code>\r\n</code> translation) and is handed over exactly as it was read from the socket.
+ */
+class DDMLIB_API IRawOutputReceiver {
+public:
+	/**
+	 * Called every time a block of data is read from the device.
+	 * @param data the data buffer. It is only valid for the duration of the call.
+	 * @param length the number of valid bytes in <var>data</var>.
+	 */
+	virtual void addOutput(const unsigned char* data, unsigned int length) = 0;
+	/**
+	 * Called once the command finished and the stream reached EOF.
+	 */
+	virtual void done() = 0;
+	virtual bool isCancelled() = 0;
+	virtual ~IRawOutputReceiver() {
+	}
+};
+
+} /* namespace ddmlib */
+#endif /* IRAWOUTPUTRECEIVER_HPP_ */
@@ -0,0 +1,312 @@
+/*
+ * ImageComparator.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "ImageComparator.hpp"
+#include "ImageScaler.hpp"
+#include "RawImage.hpp"
+#include <cstring>
+#include <cstdlib>
+
+// SSE2 is part of x86-64, and of the 32 bit builds which enable it.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DDMLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ddmlib {
+
+namespace {
+
+const int HASH_WIDTH = 9;
+const int HASH_HEIGHT = 8;
+
+inline int bitCount(unsigned int bits) {
+	int count = 0;
+	for (; bits != 0; bits &= bits - 1) {
+		++count;
+	}
+	return count;
+}
+
+/**
+ * Compares the rows of two frames with the same layout.
+ */
+class RowComparer {
+public:
+	RowComparer(const RawImage& image, int tolerance);
+
+	/**
+	 * Compares a row.
+	 * @param first set to the first mismatched column, if there's any.
+	 * @param last set to the last mismatched column, if there's any.
+	 * @return the number of mismatched pixels.
+	 */
+	size_t compare(const unsigned char* row1, const unsigned char* row2, int width, int& first, int& last) const;
+
+private:
+	enum Kind {
+		KIND_565, KIND_BYTES, KIND_GENERIC
+	};
+
+	Kind mKind;
+	int mBytesPerPixel;
+
+	// red, green, blue, alpha.
+	int mOffsets[4];
+	unsigned int mMasks[4];
+	/** the tolerance of each channel, in its own bits. */
+	int mTolerances[4];
+	int mChannelCount;
+
+	/** the tolerance of each byte of a 32 bit pixel, 255 for the bytes of no channel. */
+	unsigned char mByteTolerances[4];
+
+	static bool isByteChannel(int offset, int length) {
+		return length == 8 && (offset & 7) == 0 && offset < 32;
+	}
+
+	static void mark(unsigned int bits, int x, int& first, int& last);
+
+	size_t compareGeneric(const unsigned char* row1, const unsigned char* row2, int from, int width, int& first,
+			int& last) const;
+};
+
+RowComparer::RowComparer(const RawImage& image, int tolerance) :
+		mKind(KIND_GENERIC), mBytesPerPixel(image.bpp >> 3), mChannelCount(0) {
+	if (image.bpp != 16 && image.bpp != 32) {
+		throw std::runtime_error("RawImage.getARGB(int) only works in 16 and 32 bit mode.");
+	}
+	tolerance = std::max(0, std::min(tolerance, 255));
+
+	// without alpha, getARGB forces it to opaque: the alpha bits are ignored.
+	int offsets[4] = { image.red_offset, image.green_offset, image.blue_offset, image.alpha_offset };
+	int lengths[4] = { image.red_length, image.green_length, image.blue_length, image.alpha_length };
+	bool bytes = image.bpp == 32;
+	for (int c = 0; c < 4; ++c) {
+		if (lengths[c] == 0) {
+			continue;
+		}
+		mOffsets[mChannelCount] = offsets[c];
+		mMasks[mChannelCount] = (1u << lengths[c]) - 1;
+		// the 8 bit value is the channel value << (8 - length), so differences compare the same
+		// way once the tolerance is brought to the bits of the channel.
+		mTolerances[mChannelCount] = (lengths[c] <= 8) ? tolerance >> (8 - lengths[c]) : tolerance << (lengths[c] - 8);
+		++mChannelCount;
+		bytes = bytes && isByteChannel(offsets[c], lengths[c]);
+	}
+
+	if (image.bpp == 16 && image.red_offset == 11 && image.red_length == 5 && image.green_offset == 5
+			&& image.green_length == 6 && image.blue_offset == 0 && image.blue_length == 5 && image.alpha_length == 0) {
+		mKind = KIND_565;
+	} else if (bytes) {
+		mKind = KIND_BYTES;
+		memset(mByteTolerances, 255, sizeof(mByteTolerances));
+		for (int c = 0; c < mChannelCount; ++c) {
+			mByteTolerances[mOffsets[c] >> 3] = (unsigned char) mTolerances[c];
+		}
+	}
+}
+
+size_t RowComparer::compare(const unsigned char* row1, const unsigned char* row2, int width, int& first,
+		int& last) const {
+	int x = 0;
+	size_t mismatches = 0;
+#ifdef DDMLIB_SSE2
+	if (mKind == KIND_565) {
+		const __m128i maskG = _mm_set1_epi16(0x3F);
+		const __m128i maskB = _mm_set1_epi16(0x1F);
+		const __m128i tolR = _mm_set1_epi16((short) mTolerances[0]);
+		const __m128i tolG = _mm_set1_epi16((short) mTolerances[1]);
+		const __m128i tolB = _mm_set1_epi16((short) mTolerances[2]);
+		for (; x + 8 <= width; x += 8) {
+			__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2));
+			__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row2 + x * 2));
+			__m128i r1 = _mm_srli_epi16(v1, 11);
+			__m128i r2 = _mm_srli_epi16(v2, 11);
+			__m128i g1 = _mm_and_si128(_mm_srli_epi16(v1, 5), maskG);
+			__m128i g2 = _mm_and_si128(_mm_srli_epi16(v2, 5), maskG);
+			__m128i b1 = _mm_and_si128(v1, maskB);
+			__m128i b2 = _mm_and_si128(v2, maskB);
+			__m128i over = _mm_cmpgt_epi16(_mm_sub_epi16(_mm_max_epi16(r1, r2), _mm_min_epi16(r1, r2)), tolR);
+			over = _mm_or_si128(over, _mm_cmpgt_epi16(_mm_sub_epi16(_mm_max_epi16(g1, g2), _mm_min_epi16(g1, g2)), tolG));
+			over = _mm_or_si128(over, _mm_cmpgt_epi16(_mm_sub_epi16(_mm_max_epi16(b1, b2), _mm_min_epi16(b1, b2)), tolB));
+			unsigned int bits = _mm_movemask_epi8(_mm_packs_epi16(over, _mm_setzero_si128())) & 0xFF;
+			if (bits != 0) {
+				mismatches += bitCount(bits);
+				mark(bits, x, first, last);
+			}
+		}
+	} else if (mKind == KIND_BYTES) {
+		unsigned int tolerances;
+		memcpy(&tolerances, mByteTolerances, sizeof(tolerances));
+		const __m128i tol = _mm_set1_epi32((int) tolerances);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi32(-1);
+		for (; x + 4 <= width; x += 4) {
+			__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 4));
+			__m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row2 + x * 4));
+			__m128i diff = _mm_or_si128(_mm_subs_epu8(v1, v2), _mm_subs_epu8(v2, v1));
+			// bytes within their tolerance become 0xFF, pixels with all of them 0xFFFFFFFF.
+			__m128i within = _mm_cmpeq_epi8(_mm_subs_epu8(diff, tol), zero);
+			__m128i matched = _mm_cmpeq_epi32(within, ones);
+			unsigned int bits = ~_mm_movemask_ps(_mm_castsi128_ps(matched)) & 0xF;
+			if (bits != 0) {
+				mismatches += bitCount(bits);
+				mark(bits, x, first, last);
+			}
+		}
+	}
+#endif
+	return mismatches + compareGeneric(row1, row2, x, width, first, last);
+}
+
+void RowComparer::mark(unsigned int bits, int x, int& first, int& last) {
+	int low = 0;
+	while ((bits & (1u << low)) == 0) {
+		++low;
+	}
+	int high = 31;
+	while ((bits & (1u << high)) == 0) {
+		--high;
+	}
+	if (first < 0) {
+		first = x + low;
+	}
+	last = std::max(last, x + high);
+}
+
+size_t RowComparer::compareGeneric(const unsigned char* row1, const unsigned char* row2, int from, int width,
+		int& first, int& last) const {
+	size_t mismatches = 0;
+	for (int x = from; x < width; ++x) {
+		const unsigned char* p1 = row1 + x * mBytesPerPixel;
+		const unsigned char* p2 = row2 + x * mBytesPerPixel;
+		unsigned int v1 = p1[0] | p1[1] << 8;
+		unsigned int v2 = p2[0] | p2[1] << 8;
+		if (mBytesPerPixel == 4) {
+			v1 |= (unsigned int) p1[2] << 16 | (unsigned int) p1[3] << 24;
+			v2 |= (unsigned int) p2[2] << 16 | (unsigned int) p2[3] << 24;
+		}
+		if (v1 == v2) {
+			continue;
+		}
+		for (int c = 0; c < mChannelCount; ++c) {
+			int c1 = (int) ((v1 >> mOffsets[c]) & mMasks[c]);
+			int c2 = (int) ((v2 >> mOffsets[c]) & mMasks[c]);
+			if (std::abs(c1 - c2) > mTolerances[c]) {
+				++mismatches;
+				if (first < 0) {
+					first = x;
+				}
+				last = x;
+				break;
+			}
+		}
+	}
+	return mismatches;
+}
+
+} // namespace
+
+bool ImageComparator::isIdentical(const RawImage& image1, const RawImage& image2) {
+	return compare(image1, image2, 0).isIdentical();
+}
+
+ImageComparator::Result ImageComparator::compare(const RawImage& image1, const RawImage& image2, int tolerance) {
+	checkLayout(image1, image2);
+
+	RowComparer comparer(image1, tolerance);
+	Result result;
+	if (image1.width <= 0 || image1.height <= 0) {
+		return result;
+	}
+	const size_t stride = (size_t) image1.width * (image1.bpp >> 3);
+	const unsigned char* data1 = &image1.data[0];
+	const unsigned char* data2 = &image2.data[0];
+
+	int left = image1.width;
+	int right = -1;
+	int top = -1;
+	int bottom = -1;
+	for (int y = 0; y < image1.height; ++y) {
+		const unsigned char* row1 = data1 + y * stride;
+		const unsigned char* row2 = data2 + y * stride;
+		// most rows of a matching frame are equal: let memcmp skip them.
+		if (memcmp(row1, row2, stride) == 0) {
+			continue;
+		}
+		int first = -1;
+		int last = -1;
+		size_t mismatches = comparer.compare(row1, row2, image1.width, first, last);
+		if (mismatches == 0) {
+			continue;
+		}
+		result.mismatches += mismatches;
+		left = std::min(left, first);
+		right = std::max(right, last);
+		if (top < 0) {
+			top = y;
+		}
+		bottom = y;
+	}
+
+	if (result.mismatches != 0) {
+		result.left = left;
+		result.top = top;
+		result.right = right + 1;
+		result.bottom = bottom + 1;
+	}
+	return result;
+}
+
+unsigned long long ImageComparator::getPerceptualHash(const RawImage& image) {
+	if (image.width < HASH_WIDTH || image.height < HASH_HEIGHT) {
+		throw std::invalid_argument("The image is too small for a perceptual hash.");
+	}
+
+	unsigned int pixels[HASH_WIDTH * HASH_HEIGHT];
+	ImageScaler::scale(image, HASH_WIDTH, HASH_HEIGHT, pixels, ImageScaler::FILTER_AREA);
+
+	unsigned long long hash = 0;
+	for (int y = 0; y < HASH_HEIGHT; ++y) {
+		int previous = -1;
+		for (int x = 0; x < HASH_WIDTH; ++x) {
+			unsigned int argb = pixels[y * HASH_WIDTH + x];
+			// BT.601 luminance, in fixed point.
+			int luma = (int) ((((argb >> 16) & 0xFF) * 77 + ((argb >> 8) & 0xFF) * 150 + (argb & 0xFF) * 29) >> 8);
+			if (x > 0) {
+				hash = (hash << 1) | (luma > previous ? 1 : 0);
+			}
+			previous = luma;
+		}
+	}
+	return hash;
+}
+
+int ImageComparator::getHashDistance(unsigned long long hash1, unsigned long long hash2) {
+	unsigned long long bits = hash1 ^ hash2;
+	return bitCount((unsigned int) bits) + bitCount((unsigned int) (bits >> 32));
+}
+
+void ImageComparator::checkLayout(const RawImage& image1, const RawImage& image2) {
+	if (image1.width != image2.width || image1.height != image2.height) {
+		throw std::invalid_argument("The images don't have the same size.");
+	}
+	if (image1.bpp != image2.bpp || image1.red_offset != image2.red_offset || image1.red_length != image2.red_length
+			|| image1.green_offset != image2.green_offset || image1.green_length != image2.green_length
+			|| image1.blue_offset != image2.blue_offset || image1.blue_length != image2.blue_length
+			|| image1.alpha_offset != image2.alpha_offset || image1.alpha_length != image2.alpha_length) {
+		throw std::invalid_argument("The images don't have the same pixel layout.");
+	}
+	size_t pixels = (size_t) image1.width * (size_t) image1.height;
+	if (image1.getPixelCount() < pixels || image2.getPixelCount() < pixels) {
+		throw std::invalid_argument("The images don't hold width * height pixels.");
+	}
+}
+
+} /* namespace ddmlib */
@@ -0,0 +1,78 @@
+/*
+ * ImageComparator.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef IMAGECOMPARATOR_HPP_
+#define IMAGECOMPARATOR_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+class RawImage;
+
+/**
+ * Compares {@link RawImage} frames, e.g. screenshots against goldens.
+ * <p/>The frames are compared in their native pixel layout, without converting them. The
+ * channel values and the tolerance are those of {@link RawImage#getARGB(int)}: a mismatch is
+ * a pixel with a channel differing by more than the tolerance once expanded to 8 bits.
+ * <p/>RGB565 and the 32 bit layouts with 8 bit channels at byte offsets are compared with SSE2
+ * where the CPU has it, anything else with a scalar loop.
+ */
+class DDMLIB_API ImageComparator {
+public:
+	/**
+	 * Result of a comparison.
+	 */
+	struct Result {
+		/** the number of mismatched pixels. */
+		size_t mismatches;
+		/** the bounding box of the mismatched pixels, right and bottom excluded. Empty if there are none. */
+		int left;
+		int top;
+		int right;
+		int bottom;
+
+		Result() :
+				mismatches(0), left(0), top(0), right(0), bottom(0) {
+		}
+
+		bool isIdentical() const {
+			return mismatches == 0;
+		}
+	};
+
+	/**
+	 * Returns whether two frames have the same pixels.
+	 * @throws invalid_argument if the frames don't have the same size and pixel layout.
+	 */
+	static bool isIdentical(const RawImage& image1, const RawImage& image2);
+
+	/**
+	 * Compares two frames channel by channel.
+	 * @param tolerance the largest difference of an 8 bit channel which isn't a mismatch.
+	 * @throws invalid_argument if the frames don't have the same size and pixel layout.
+	 */
+	static Result compare(const RawImage& image1, const RawImage& image2, int tolerance = 0);
+
+	/**
+	 * Computes a 64 bit perceptual hash of a frame: the difference hash of its luminance,
+	 * averaged down to 9 * 8 pixels. Frames which look alike have hashes differing by few bits.
+	 * @throws invalid_argument if the frame is smaller than 9 * 8 pixels.
+	 * @see #getHashDistance(unsigned long long, unsigned long long)
+	 */
+	static unsigned long long getPerceptualHash(const RawImage& image);
+
+	/**
+	 * Returns the number of different bits of two perceptual hashes.
+	 */
+	static int getHashDistance(unsigned long long hash1, unsigned long long hash2);
+
+private:
+	static void checkLayout(const RawImage& image1, const RawImage& image2);
+};
+
+} /* namespace ddmlib */
+#endif /* IMAGECOMPARATOR_HPP_ */
@@ -0,0 +1,168 @@
+/*
+ * ImageScaler.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "ImageScaler.hpp"
+#include "RawImage.hpp"
+
+namespace ddmlib {
+
+ImageScaler::ImageScaler(int srcWidth, int srcHeight, int destWidth, int destHeight, Filter filter,
+		PixelConverter::Destination destination) :
+		mSrcWidth(srcWidth), mSrcHeight(srcHeight), mDestWidth(destWidth), mDestHeight(destHeight), mFilter(filter), mDestination(
+				destination) {
+	if (srcWidth <= 0 || srcHeight <= 0 || destWidth <= 0 || destHeight <= 0) {
+		throw std::invalid_argument("ImageScaler sizes must not be empty.");
+	}
+	if (destWidth > srcWidth || destHeight > srcHeight) {
+		throw std::invalid_argument("ImageScaler only downscales.");
+	}
+
+	computeSpans(srcWidth, destWidth, filter, mSpansX, mWeightsX);
+	computeSpans(srcHeight, destHeight, filter, mSpansY, mWeightsY);
+
+	mRow.resize(srcWidth);
+	mColumns.resize(destWidth * 4);
+	mSums.resize(destWidth * 4);
+}
+
+void ImageScaler::scale(const RawImage& image, unsigned int* dest) {
+	if (image.width != mSrcWidth || image.height != mSrcHeight) {
+		throw std::invalid_argument("The image doesn't have the source size of the ImageScaler.");
+	}
+	if (image.getPixelCount() < (size_t) mSrcWidth * (size_t) mSrcHeight) {
+		throw std::invalid_argument("The image doesn't hold width * height pixels.");
+	}
+
+	PixelConverter converter(image, mDestination);
+	const size_t stride = (size_t) mSrcWidth * converter.getBytesPerPixel();
+	const unsigned char* data = &image.data[0];
+
+	// a source row on the boundary of two destination rows is only converted once.
+	int lastRow = -1;
+	for (int y = 0; y < mDestHeight; y++) {
+		const Span& spanY = mSpansY[y];
+		std::fill(mSums.begin(), mSums.end(), 0ULL);
+
+		for (int k = 0; k < spanY.count; k++) {
+			int row = spanY.first + k;
+			if (row != lastRow) {
+				converter.convert(data + row * stride, &mRow[0], mSrcWidth);
+				scaleRow();
+				lastRow = row;
+			}
+			unsigned long long weight = mWeightsY[spanY.weights + k];
+			for (size_t i = 0; i < mSums.size(); i++) {
+				mSums[i] += weight * mColumns[i];
+			}
+		}
+
+		unsigned int* out = dest + (size_t) y * mDestWidth;
+		for (int x = 0; x < mDestWidth; x++) {
+			unsigned long long total = (unsigned long long) mSpansX[x].total * spanY.total;
+			const unsigned long long* sums = &mSums[x * 4];
+			unsigned int value = 0;
+			for (int c = 0; c < 4; c++) {
+				value |= (unsigned int) ((sums[c] + total / 2) / total) << (c * 8);
+			}
+			out[x] = value;
+		}
+	}
+}
+
+void ImageScaler::scale(const RawImage& image, int destWidth, int destHeight, unsigned int* dest, Filter filter) {
+	ImageScaler scaler(image.width, image.height, destWidth, destHeight, filter);
+	scaler.scale(image, dest);
+}
+
+void ImageScaler::fitWithin(int srcWidth, int srcHeight, int maxWidth, int maxHeight, int& destWidth,
+		int& destHeight) {
+	destWidth = std::min(srcWidth, maxWidth);
+	destHeight = std::min(srcHeight, maxHeight);
+	if (srcWidth <= 0 || srcHeight <= 0) {
+		return;
+	}
+
+	// keep the side which limits the size, and compute the other one from the ratio.
+	if ((long long) destWidth * srcHeight <= (long long) destHeight * srcWidth) {
+		destHeight = (int) std::max(1LL, ((long long) destWidth * srcHeight + srcWidth / 2) / srcWidth);
+	} else {
+		destWidth = (int) std::max(1LL, ((long long) destHeight * srcWidth + srcHeight / 2) / srcHeight);
+	}
+}
+
+void ImageScaler::computeSpans(int src, int dest, Filter filter, std::vector<Span>& spans,
+		std::vector<unsigned int>& weights) {
+	spans.resize(dest);
+	weights.clear();
+
+	if (filter == FILTER_BOX) {
+		for (int i = 0; i < dest; i++) {
+			Span& span = spans[i];
+			span.first = (int) ((long long) i * src / dest);
+			span.count = (int) ((long long) (i + 1) * src / dest) - span.first;
+			span.weights = weights.size();
+			span.total = span.count;
+			weights.insert(weights.end(), span.count, 1);
+		}
+		return;
+	}
+
+	// in units of 1/dest of a source pixel, a source pixel is dest units long and a destination
+	// pixel is src units long. Both are divided by their gcd to keep the sums small.
+	int divisor = gcd(src, dest);
+	unsigned int srcUnits = dest / divisor;
+	unsigned int destUnits = src / divisor;
+	for (int i = 0; i < dest; i++) {
+		Span& span = spans[i];
+		unsigned long long start = (unsigned long long) i * destUnits;
+		unsigned long long end = start + destUnits;
+		span.first = (int) (start / srcUnits);
+		span.count = (int) ((end - 1) / srcUnits) - span.first + 1;
+		span.weights = weights.size();
+		span.total = destUnits;
+		for (int k = 0; k < span.count; k++) {
+			unsigned long long pixelStart = (unsigned long long) (span.first + k) * srcUnits;
+			unsigned long long pixelEnd = pixelStart + srcUnits;
+			weights.push_back((unsigned int) (std::min(end, pixelEnd) - std::max(start, pixelStart)));
+		}
+	}
+}
+
+void ImageScaler::scaleRow() {
+	const unsigned int* row = &mRow[0];
+	for (int x = 0; x < mDestWidth; x++) {
+		const Span& span = mSpansX[x];
+		const unsigned int* weights = &mWeightsX[span.weights];
+		const unsigned int* pixels = row + span.first;
+		unsigned int c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+		for (int k = 0; k < span.count; k++) {
+			unsigned int weight = weights[k];
+			unsigned int pixel = pixels[k];
+			c0 += weight * (pixel & 0xFF);
+			c1 += weight * ((pixel >> 8) & 0xFF);
+			c2 += weight * ((pixel >> 16) & 0xFF);
+			c3 += weight * (pixel >> 24);
+		}
+		unsigned int* columns = &mColumns[x * 4];
+		columns[0] = c0;
+		columns[1] = c1;
+		columns[2] = c2;
+		columns[3] = c3;
+	}
+}
+
+int ImageScaler::gcd(int a, int b) {
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+} /* namespace ddmlib */
@@ -0,0 +1,130 @@
+/*
+ * ImageScaler.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef IMAGESCALER_HPP_
+#define IMAGESCALER_HPP_
+#include "ddmlib.hpp"
+#include "PixelConverter.hpp"
+
+namespace ddmlib {
+
+class RawImage;
+
+/**
+ * Downscales {@link RawImage} frames into caller supplied buffers, e.g. for thumbnails.
+ * <p/>The frame is read in its native pixel layout: every source row is converted by a
+ * {@link PixelConverter} into a row buffer, and averaged into the destination right away.
+ * No full size intermediate image is created.
+ * <p/>The weights and the row buffers are computed once for a pair of sizes, so a scaler
+ * should be kept for the frames of a device. A scaler isn't thread-safe.
+ */
+class DDMLIB_API ImageScaler {
+public:
+	enum Filter {
+		/**
+		 * Each destination pixel is the plain average of the source pixels whose index
+		 * falls within it. The cheapest filter, exact for integer factors.
+		 */
+		FILTER_BOX,
+		/**
+		 * Each destination pixel is the average of the source area it covers, with the
+		 * partially covered source pixels weighted by their coverage.
+		 */
+		FILTER_AREA
+	};
+
+	/**
+	 * Creates a scaler for frames of <var>srcWidth</var> * <var>srcHeight</var> pixels.
+	 * @param destination the pixel layout of the scaled image.
+	 * @throws invalid_argument if a size is empty, or the destination is larger than the source.
+	 */
+	ImageScaler(int srcWidth, int srcHeight, int destWidth, int destHeight, Filter filter = FILTER_AREA,
+			PixelConverter::Destination destination = PixelConverter::DEST_ARGB);
+
+	/**
+	 * Scales a frame.
+	 * @param image the frame, of the source size of the scaler.
+	 * @param dest receives destWidth * destHeight values.
+	 * @throws invalid_argument if the frame doesn't have the source size.
+	 * @throws runtime_error if the image isn't 16 or 32 bit.
+	 */
+	void scale(const RawImage& image, unsigned int* dest);
+
+	/**
+	 * Scales a frame once. Prefer a scaler kept across frames.
+	 * @see #scale(const RawImage&, unsigned int*)
+	 */
+	static void scale(const RawImage& image, int destWidth, int destHeight, unsigned int* dest, Filter filter =
+			FILTER_AREA);
+
+	/**
+	 * Computes the largest size fitting within <var>maxWidth</var> * <var>maxHeight</var>
+	 * with the aspect ratio of the source, and not larger than the source.
+	 */
+	static void fitWithin(int srcWidth, int srcHeight, int maxWidth, int maxHeight, int& destWidth, int& destHeight);
+
+	int getSourceWidth() const {
+		return mSrcWidth;
+	}
+
+	int getSourceHeight() const {
+		return mSrcHeight;
+	}
+
+	int getDestinationWidth() const {
+		return mDestWidth;
+	}
+
+	int getDestinationHeight() const {
+		return mDestHeight;
+	}
+
+private:
+	/**
+	 * The source pixels of a destination pixel, along one axis.
+	 */
+	struct Span {
+		int first;
+		int count;
+		/** index of the weight of the first source pixel. */
+		size_t weights;
+		/** sum of the weights. */
+		unsigned int total;
+	};
+
+	int mSrcWidth;
+	int mSrcHeight;
+	int mDestWidth;
+	int mDestHeight;
+	Filter mFilter;
+	PixelConverter::Destination mDestination;
+
+	std::vector<Span> mSpansX;
+	std::vector<unsigned int> mWeightsX;
+	std::vector<Span> mSpansY;
+	std::vector<unsigned int> mWeightsY;
+
+	/** the converted source row. */
+	std::vector<unsigned int> mRow;
+	/** the source row averaged horizontally, 4 channels per destination pixel. */
+	std::vector<unsigned int> mColumns;
+	/** the destination row being accumulated, 4 channels per destination pixel. */
+	std::vector<unsigned long long> mSums;
+
+	static void computeSpans(int src, int dest, Filter filter, std::vector<Span>& spans,
+			std::vector<unsigned int>& weights);
+
+	/**
+	 * Averages the converted row horizontally into {@link #mColumns}.
+	 */
+	void scaleRow();
+
+	static int gcd(int a, int b);
+};
+
+} /* namespace ddmlib */
+#endif /* IMAGESCALER_HPP_ */
@@ -8,9 +8,27 @@
 #include "ddmlib.hpp"
 #include "LogReceiver.hpp"
 #include "ArrayHelper.hpp"
+#include <cstring>
 
 namespace ddmlib {
 
+void LogEntryView::copyTo(LogEntry& entry) const {
+	entry.len = len;
+	entry.pid = pid;
+	entry.tid = tid;
+	entry.sec = sec;
+	entry.nsec = nsec;
+	entry.data.assign(data, data + len);
+}
+
+void ILogListener::newEntries(const LogEntryBatch& batch) {
+	for (size_t i = 0; i < batch.size(); ++i) {
+		std::tr1::shared_ptr<LogEntry> entry(new LogEntry);
+		batch[i].copyTo(*entry);
+		newEntry(entry);
+	}
+}
+
 LogReceiver::LogReceiver(ILogListener *listener) {
 	Init();
 	m_pListener = listener;
@@ -21,131 +39,123 @@ LogReceiver::~LogReceiver() {
 
 void LogReceiver::Init() {
 
-	mEntryHeaderOffset = 0;
-	mEntryDataOffset = 0;
+	// data received before is dropped, its block may still be used by a listener.
+	if (mBlock != nullptr) {
+		releaseBlock(mBlock);
+		mBlock.reset();
+	}
+	mUsed = 0;
+	mParsed = 0;
 	mIsCancelled = false;
-	m_pCurrentEntry.reset();
 
 }
 
 void LogReceiver::parseNewData(unsigned char* data, int offset, int length) {
+	while (length > 0 && mIsCancelled == false) {
+		int capacity = 0;
+		unsigned char* buffer = getReceiveBuffer(capacity);
+		int size = std::min(capacity, length);
+		memcpy(buffer, data + offset, size);
+		commitReceived(size);
+		offset += size;
+		length -= size;
+	}
+}
+
+unsigned char* LogReceiver::getReceiveBuffer(int& capacity) {
+	if (mBlock == nullptr || BLOCK_SIZE - mUsed < MIN_RECEIVE_SIZE) {
+		switchBlock();
+	}
+	capacity = BLOCK_SIZE - mUsed;
+	return &(*mBlock)[mUsed];
+}
+
+void LogReceiver::commitReceived(int length) {
+	unsigned char* block = &(*mBlock)[0];
+	int start = mUsed;
+	mUsed += length;
+
 	// notify the listener of new raw data
 	if (m_pListener != nullptr) {
-		m_pListener->newData(data, offset, length);
+		m_pListener->newData(block, start, length);
 	}
-	int init_length = length;
-	// loop while there is still data to be read and the receiver has not be cancelled.
-	while (length > 0 && mIsCancelled == false) {
-		// first check if we have no current entry.
-		if (m_pCurrentEntry == nullptr) {
-			m_pCurrentEntry = std::tr1::shared_ptr<LogEntry>(new LogEntry);
-			if (mEntryHeaderOffset + length < ENTRY_HEADER_SIZE) {
-				// if we don't have enough data to finish the header, save
-				// the data we have and return
-				//System.arraycopy(data, offset, mEntryHeaderBuffer, mEntryHeaderOffset, length);
-				std::copy(data + offset, data + length + offset, mEntryHeaderBuffer + mEntryHeaderOffset);
-				mEntryHeaderOffset += length;
-				return;
-			} else {
-				// we have enough to fill the header, let's do it.
-				// did we store some part at the beginning of the header?
-				if (mEntryHeaderOffset != 0) {
-					// copy the rest of the entry header into the header buffer
-					int size = ENTRY_HEADER_SIZE - mEntryHeaderOffset;
-
-					std::copy(data + offset, data + size + offset, mEntryHeaderBuffer + mEntryHeaderOffset);
-					// create the entry from the header buffer
-					m_pCurrentEntry = createEntry(mEntryHeaderBuffer, 0, ENTRY_HEADER_SIZE);
-
-					// since we used the whole entry header buffer, we reset  the offset
-					mEntryHeaderOffset = 0;
-
-					// adjust current offset and remaining length to the beginning
-					// of the entry data
-					offset += size;
-					length -= size;
-				} else {
-					// create the entry directly from the data array
-					//Sergey: init_length because here is needed to pass as argument initial length of the incoming data
-					m_pCurrentEntry = createEntry(data, offset, init_length);
-
-					// adjust current offset and remaining length to the beginning
-					// of the entry data
-					offset += ENTRY_HEADER_SIZE;
-					length -= ENTRY_HEADER_SIZE;
-				}
-			}
-		}
 
-		// at this point, we have an entry, and offset/length have been updated to skip
-		// the entry header.
-
-		// if we have enough data for this entry or more, we'll need to end this entry
-		if (length >= m_pCurrentEntry->len - mEntryDataOffset) {
-			// compute and save the size of the data that we have to read for this entry,
-			// based on how much we may already have read.
-			int dataSize = m_pCurrentEntry->len - mEntryDataOffset;
-
-			// we only read what we need, and put it in the entry buffer.
-			std::copy(data + offset, data + dataSize + offset, m_pCurrentEntry->data.begin() + mEntryDataOffset);
-			// notify the listener of a new entry
-			if (m_pListener != nullptr) {
-				m_pListener->newEntry(m_pCurrentEntry);
-			}
-
-			// reset some flags: we have read 0 data of the current entry.
-			// and we have no current entry being read.
-			mEntryDataOffset = 0;
-			m_pCurrentEntry.reset();
-
-			// and update the data buffer info to the end of the current entry / start
-			// of the next one.
-			offset += dataSize;
-			length -= dataSize;
-		} else {
-			// we don't have enough data to fill this entry, so we store what we have
-			// in the entry itself.
-			std::copy(data + offset, data + length + offset, m_pCurrentEntry->data.begin() + mEntryDataOffset);
-			// save the amount read for the data.
-			mEntryDataOffset += length;
-			return;
+	// parse the complete entries, in place.
+	mBatch.mEntries.clear();
+	while (mIsCancelled == false && mUsed - mParsed >= ENTRY_HEADER_SIZE) {
+		LogEntryView entry;
+		readHeader(block + mParsed, entry);
+		if (mUsed - mParsed - ENTRY_HEADER_SIZE < entry.len) {
+			// the rest of the entry is still to come.
+			break;
 		}
+		entry.data = block + mParsed + ENTRY_HEADER_SIZE;
+		mBatch.mEntries.push_back(entry);
+		mParsed += ENTRY_HEADER_SIZE + entry.len;
+	}
+
+	if (mBatch.mEntries.empty() == false && m_pListener != nullptr) {
+		mBatch.mBlock = mBlock;
+		m_pListener->newEntries(mBatch);
+		mBatch.mBlock.reset();
+	}
+
+	// everything was parsed: unless the listener kept the entries, the block can be filled
+	// again from the start, while it's still in the cache.
+	if (mParsed == mUsed && mBlock.use_count() == 1) {
+		mUsed = 0;
+		mParsed = 0;
 	}
 }
-/**
- * Creates a {@link LogEntry} from the array of bytes. This expects the data buffer size
- * to be at least <code>offset + {@link #ENTRY_HEADER_SIZE}</code>.
- * @param data the data buffer the entry is read from.
- * @param offset the offset of the first byte from the buffer representing the entry.
- * @return a new {@link LogEntry} or <code>null</code> if some error happened.
- */
-std::tr1::shared_ptr<LogEntry> LogReceiver::createEntry(unsigned char* data, int offset, int length) {
-	if (length < offset + ENTRY_HEADER_SIZE) {
-		throw Poco::InvalidArgumentException("Buffer not big enough to hold full LoggerEntry header");
+
+void LogReceiver::switchBlock() {
+	std::tr1::shared_ptr<std::vector<unsigned char> > next;
+	for (size_t i = 0; i < mSpareBlocks.size(); ++i) {
+		if (mSpareBlocks[i].use_count() == 1) {
+			next = mSpareBlocks[i];
+			mSpareBlocks.erase(mSpareBlocks.begin() + i);
+			break;
+		}
+	}
+	if (next == nullptr) {
+		next = std::tr1::shared_ptr<std::vector<unsigned char> >(new std::vector<unsigned char>(BLOCK_SIZE));
 	}
 
-	// create the new entry and fill it.
-	std::tr1::shared_ptr<LogEntry> entry(new LogEntry);
+	// an entry split at the end of the block is the only data ever moved.
+	int pending = mUsed - mParsed;
+	if (pending > 0) {
+		memcpy(&(*next)[0], &(*mBlock)[mParsed], pending);
+	}
+	if (mBlock != nullptr) {
+		releaseBlock(mBlock);
+	}
 
-	entry->len = ArrayHelper::swapU16bitFromArray(data, offset);
+	mBlock = next;
+	mUsed = pending;
+	mParsed = 0;
+}
+
+void LogReceiver::releaseBlock(std::tr1::shared_ptr<std::vector<unsigned char> > block) {
+	if (mSpareBlocks.size() < (size_t) MAX_SPARE_BLOCKS) {
+		mSpareBlocks.push_back(block);
+	}
+}
+
+void LogReceiver::readHeader(const unsigned char* data, LogEntryView& entry) {
+	int offset = 0;
+	entry.len = ArrayHelper::swapU16bitFromArray(data, offset);
 
 	// we've read only 16 bits, but since there's also a 16 bit padding,
 	// we can skip right over both.
 	offset += 4;
 
-	entry->pid = ArrayHelper::swap32bitFromArray(data, offset);
-	offset += 4;
-	entry->tid = ArrayHelper::swap32bitFromArray(data, offset);
+	entry.pid = ArrayHelper::swap32bitFromArray(data, offset);
 	offset += 4;
-	entry->sec = ArrayHelper::swap32bitFromArray(data, offset);
+	entry.tid = ArrayHelper::swap32bitFromArray(data, offset);
 	offset += 4;
-	entry->nsec = ArrayHelper::swap32bitFromArray(data, offset);
+	entry.sec = ArrayHelper::swap32bitFromArray(data, offset);
 	offset += 4;
-
-	// allocate the data
-	entry->data.resize(entry->len);
-
-	return entry;
+	entry.nsec = ArrayHelper::swap32bitFromArray(data, offset);
 }
 
 } /* namespace ddmlib */
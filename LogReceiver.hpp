@@ -34,13 +34,70 @@ struct DDMLIB_API LogEntry {
 	std::vector<unsigned char> data;
 };
 
+/**
+ * A log entry parsed in place: the header values, and the raw data where it was received.
+ */
+struct DDMLIB_API LogEntryView {
+	/** length of the payload. */
+	int len;
+	/** pid of the process that generated this entry */
+	int pid;
+	/** tid of the process that generated this entry */
+	int tid;
+	/** Seconds since epoch. */
+	int sec;
+	/** nanoseconds. */
+	int nsec;
+	/** The entry's raw data, <code>len</code> bytes in the receive block of its {@link LogEntryBatch}. */
+	const unsigned char* data;
+
+	/**
+	 * Copies the entry into a {@link LogEntry}.
+	 */
+	void copyTo(LogEntry& entry) const;
+};
+
+/**
+ * The entries parsed by a {@link LogReceiver} out of one block of data.
+ * <p/>The entries point into a receive block of the {@link LogReceiver}. The block is reused
+ * once the batch was delivered, unless a copy of the batch keeps it: copy the batch to keep
+ * the entries past {@link ILogListener#newEntries(const LogEntryBatch&)}.
+ */
+class DDMLIB_API LogEntryBatch {
+public:
+	size_t size() const {
+		return mEntries.size();
+	}
+
+	bool empty() const {
+		return mEntries.empty();
+	}
+
+	const LogEntryView& operator[](size_t index) const {
+		return mEntries[index];
+	}
+
+	const std::vector<LogEntryView>& getEntries() const {
+		return mEntries;
+	}
+
+private:
+	friend class LogReceiver;
+
+	std::vector<LogEntryView> mEntries;
+	/** the receive block holding the entries. */
+	std::tr1::shared_ptr<std::vector<unsigned char> > mBlock;
+};
+
 /**
  * Classes which implement this interface provide a method that deals
  * with {@link LogEntry} objects coming from log service through a {@link LogReceiver}.
- * <p/>This interface provides two methods.
+ * <p/>This interface provides three methods.
  * <ul>
- * <li>{@link #newEntry(com.android.ddmlib.log.LogReceiver.LogEntry)} provides a
- * first level of parsing, extracting {@link LogEntry} objects out of the log service output.</li>
+ * <li>{@link #newEntries(const LogEntryBatch&)} provides a first level of parsing, extracting
+ * the entries out of the log service output without copying them.</li>
+ * <li>{@link #newEntry(com.android.ddmlib.log.LogReceiver.LogEntry)} provides the same entries
+ * one by one, as {@link LogEntry} objects.</li>
  * <li>{@link #newData(byte[], int, int)} provides a way to receive the raw information
  * coming directly from the log service.</li>
  * </ul>
@@ -48,10 +105,21 @@ struct DDMLIB_API LogEntry {
 class DDMLIB_API ILogListener {
 public:
 	/**
-	 * Sent when a new {@link LogEntry} has been parsed by the {@link LogReceiver}.
+	 * Sent when new entries have been parsed by the {@link LogReceiver}.
+	 * <p/>The default implementation copies every entry into a {@link LogEntry}, and sends it to
+	 * {@link #newEntry(std::tr1::shared_ptr<LogEntry>)}. Listeners handling a lot of entries
+	 * should override it.
+	 * @param batch the new log entries, only valid during the call.
+	 */
+	virtual void newEntries(const LogEntryBatch& batch);
+
+	/**
+	 * Sent when a new {@link LogEntry} has been parsed by the {@link LogReceiver}, unless
+	 * {@link #newEntries(const LogEntryBatch&)} is overridden.
 	 * @param entry the new log entry.
 	 */
-	virtual void newEntry(std::tr1::shared_ptr<LogEntry> entry) = 0;
+	virtual void newEntry(std::tr1::shared_ptr<LogEntry> /*entry*/) {
+	}
 
 	/**
 	 * Sent when new raw data is coming from the log service.
@@ -62,8 +130,19 @@ public:
 	virtual void newData(unsigned char* data, int offset, int length) = 0;
 };
 
+/**
+ * Receiver able to provide low level parsing for device-side log services.
+ * <p/>The data is received into large blocks owned by the receiver, and the entries are parsed
+ * where they were received: only an entry split at the end of a block is moved to the next one.
+ * The blocks are reused once the listener released them.
+ */
 class DDMLIB_API LogReceiver {
 public:
+	/** Size of the receive blocks, enough for the largest entry and a full receive. */
+	static const int BLOCK_SIZE = 128 * 1024;
+	/** A new block is started when less than this is free in the current one. */
+	static const int MIN_RECEIVE_SIZE = 16 * 1024;
+
 
 	~LogReceiver();
 
@@ -71,12 +150,28 @@ public:
 	LogReceiver(ILogListener *listener);
 	/**
 	 * Parses new data coming from the log service.
+	 * <p/>The data is copied into the receive blocks first: prefer receiving it there with
+	 * {@link #getReceiveBuffer(int&)}.
 	 * @param data the data buffer
 	 * @param offset the offset into the buffer signaling the beginning of the new data.
 	 * @param length the length of the new data.
 	 */
 	void parseNewData(unsigned char* data, int offset, int length);
 
+	/**
+	 * Returns where the next data from the log service should be received.
+	 * @param capacity set to the number of bytes which can be received there.
+	 * @see #commitReceived(int)
+	 */
+	unsigned char* getReceiveBuffer(int& capacity);
+
+	/**
+	 * Parses the data received into the buffer returned by {@link #getReceiveBuffer(int&)}, and
+	 * sends the complete entries to the listener.
+	 * @param length the number of bytes received.
+	 */
+	void commitReceived(int length);
+
 	/**
 	 * Returns whether this receiver is canceling the remote service.
 	 */
@@ -94,27 +189,37 @@ public:
 
 private:
 	/**
-	 * Creates a {@link LogEntry} from the array of bytes. This expects the data buffer size
-	 * to be at least <code>offset + {@link #ENTRY_HEADER_SIZE}</code>.
-	 * @param data the data buffer the entry is read from.
-	 * @param offset the offset of the first byte from the buffer representing the entry.
-	 * @return a new {@link LogEntry} or <code>null</code> if some error happened.
+	 * Reads the header of an entry. This expects the data to hold at least
+	 * {@link #ENTRY_HEADER_SIZE} bytes.
+	 * @param data the first byte of the entry.
+	 * @param entry receives the header values.
 	 */
-	std::tr1::shared_ptr<LogEntry> createEntry(unsigned char* data, int offset, int length);
+	static void readHeader(const unsigned char* data, LogEntryView& entry);
 	const static int ENTRY_HEADER_SIZE = 20; // 2*2 + 4*4; see LogEntry.
-	std::tr1::shared_ptr<LogEntry> m_pCurrentEntry;
-
-	/** Temp buffer to store partial entry headers. */
-	unsigned char mEntryHeaderBuffer[ENTRY_HEADER_SIZE];
-	/** Offset in the partial header buffer */
-	int mEntryHeaderOffset;
-	/** Offset in the partial entry data */
-	int mEntryDataOffset;
+	/** Number of released blocks kept for reuse. */
+	const static int MAX_SPARE_BLOCKS = 4;
+
+	/** the block receiving the data. */
+	std::tr1::shared_ptr<std::vector<unsigned char> > mBlock;
+	/** released blocks, reused once nothing else references them. */
+	std::vector<std::tr1::shared_ptr<std::vector<unsigned char> > > mSpareBlocks;
+	/** number of bytes received in the current block. */
+	int mUsed;
+	/** offset of the first entry not parsed yet in the current block. */
+	int mParsed;
+	/** reused from block to block. */
+	LogEntryBatch mBatch;
 	bool mIsCancelled;
 
 	/** Listener waiting for receive fully read {@link LogEntry} objects */
 	ILogListener *m_pListener;
 
+	/**
+	 * Starts a new block, moving the unparsed data of the current one to it.
+	 */
+	void switchBlock();
+
+	void releaseBlock(std::tr1::shared_ptr<std::vector<unsigned char> > block);
 };
 
 } /* namespace ddmlib */
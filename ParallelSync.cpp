@@ -0,0 +1,257 @@
+/*
+ * ParallelSync.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "ParallelSync.hpp"
+#include "Device.hpp"
+#include "Log.hpp"
+#include "SyncException.hpp"
+
+namespace ddmlib {
+
+bool ParallelSync::SharedProgressMonitor::isCanceled() const {
+	if (mOwner.mAborted) {
+		return true;
+	}
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mMonitor->isCanceled();
+}
+
+void ParallelSync::SharedProgressMonitor::startSubTask(const std::string &name) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mMonitor->startSubTask(name);
+}
+
+void ParallelSync::SharedProgressMonitor::advance(long long work) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mMonitor->advance(work);
+}
+
+ParallelSync::ParallelSync(std::tr1::shared_ptr<Device> device, int connectionCount) :
+		mDevice(device), mConnectionCount(connectionCount > 0 ? connectionCount : 1), mPush(true), mAborted(false) {
+}
+
+ParallelSync::~ParallelSync() {
+}
+
+void ParallelSync::push(const std::vector<std::string>& local, const std::string& remotePath,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	push(local, remotePath, monitor.get());
+}
+
+void ParallelSync::push(const std::vector<std::string>& local, const std::string& remotePath,
+		ISyncProgressMonitor* monitor) {
+	std::vector<Poco::File> files;
+	for (std::vector<std::string>::const_iterator path = local.begin(); path != local.end(); ++path) {
+		files.push_back(Poco::File(*path));
+	}
+
+	std::vector<Transfer> transfers;
+	collectLocalFiles(files, remotePath, transfers);
+
+	mPush = true;
+	run(transfers, monitor);
+}
+
+void ParallelSync::pull(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pull(entries, localPath, monitor.get());
+}
+
+void ParallelSync::pull(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, ISyncProgressMonitor* monitor) {
+	// first we check the destination is a directory and exists
+	Poco::File f(localPath);
+	if (f.exists() == false) {
+		throw SyncException(SyncException::NO_DIR_TARGET);
+	}
+	if (f.isDirectory() == false) {
+		throw SyncException(SyncException::TARGET_IS_FILE);
+	}
+
+	std::tr1::shared_ptr<FileListingService> fls(new FileListingService(mDevice));
+
+	std::vector<Transfer> transfers;
+	collectRemoteFiles(entries, localPath, fls, transfers);
+
+	mPush = false;
+	run(transfers, monitor);
+}
+
+void ParallelSync::collectLocalFiles(const std::vector<Poco::File>& files, const std::string& remotePath,
+		std::vector<Transfer>& transfers) {
+	for (std::vector<Poco::File>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		if (!(*f).exists()) {
+			continue;
+		}
+		std::string remote = remotePath + "/" + Poco::Path((*f).path()).getFileName();
+		if ((*f).isDirectory()) {
+			// adb creates the missing remote directories when a file is sent.
+			std::vector<Poco::File> children;
+			(*f).list(children);
+			collectLocalFiles(children, remote, transfers);
+		} else if ((*f).isFile()) {
+			Transfer transfer;
+			transfer.localPath = (*f).path();
+			transfer.remotePath = remote;
+			transfer.size = (long long) (*f).getSize();
+			transfers.push_back(transfer);
+		}
+	}
+}
+
+void ParallelSync::collectRemoteFiles(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, std::tr1::shared_ptr<FileListingService> fls, std::vector<Transfer>& transfers) {
+	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		std::string dest = localPath + Poco::Path::separator() + (*e)->getName();
+		int type = (*e)->getType();
+		if (type == FileListingService::TYPE_DIRECTORY) {
+			Poco::File d(dest);
+			d.createDirectory();
+
+			std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > children = fls->getChildren(*e, false,
+					std::tr1::shared_ptr<FileListingService::IListingReceiver>());
+			collectRemoteFiles(children, dest, fls, transfers);
+		} else if (type == FileListingService::TYPE_FILE) {
+			Transfer transfer;
+			transfer.localPath = dest;
+			transfer.remotePath = (*e)->getFullPath();
+			transfer.size = (*e)->getSizeValue();
+			transfer.remoteEntry = *e;
+			transfers.push_back(transfer);
+		}
+	}
+}
+
+void ParallelSync::run(std::vector<Transfer>& transfers, ISyncProgressMonitor* monitor) {
+	mAborted = false;
+	mSyncError.reset();
+	mError.reset();
+	mMonitor = std::tr1::shared_ptr<SharedProgressMonitor>(new SharedProgressMonitor(*this, monitor));
+
+	long long total = 0;
+	for (std::vector<Transfer>::const_iterator t = transfers.begin(); t != transfers.end(); ++t) {
+		total += t->size;
+	}
+	monitor->start(total);
+
+	// open the connections. Running with less than asked is fine, the queues of the missing
+	// connections will be stolen by the others.
+	size_t count = std::min((size_t) mConnectionCount, std::max(transfers.size(), (size_t) 1));
+	mServices.clear();
+	for (size_t i = 0; i < count; ++i) {
+		std::tr1::shared_ptr<SyncService> service = mDevice->getSyncService();
+		if (service == nullptr) {
+			break;
+		}
+		mServices.push_back(service);
+	}
+	if (mServices.empty()) {
+		monitor->stop();
+		throw Poco::IOException("Unable to open sync connection!");
+	}
+	if (mServices.size() < count) {
+		Log::w("ddms", "Only " + Poco::NumberFormatter::format(mServices.size()) + " sync connection(s) opened to "
+				+ mDevice->getSerialNumber());
+	}
+
+	// largest first, each file going to the connection with the least bytes so far.
+	std::stable_sort(transfers.begin(), transfers.end(), isLarger);
+	mQueues.assign(mServices.size(), std::deque<Transfer>());
+	mQueuedBytes.assign(mServices.size(), 0);
+	for (std::vector<Transfer>::const_iterator t = transfers.begin(); t != transfers.end(); ++t) {
+		size_t target = std::min_element(mQueuedBytes.begin(), mQueuedBytes.end()) - mQueuedBytes.begin();
+		mQueues[target].push_back(*t);
+		mQueuedBytes[target] += t->size;
+	}
+
+	std::vector<std::tr1::shared_ptr<Worker> > workers;
+	std::vector<std::tr1::shared_ptr<Poco::Thread> > threads;
+	for (size_t i = 0; i < mServices.size(); ++i) {
+		workers.push_back(std::tr1::shared_ptr<Worker>(new Worker(*this, i)));
+		threads.push_back(std::tr1::shared_ptr<Poco::Thread>(new Poco::Thread("Parallel sync " + Poco::NumberFormatter::format(i))));
+		threads.back()->start(*workers.back());
+	}
+	for (std::vector<std::tr1::shared_ptr<Poco::Thread> >::iterator t = threads.begin(); t != threads.end(); ++t) {
+		(*t)->join();
+	}
+
+	for (std::vector<std::tr1::shared_ptr<SyncService> >::iterator s = mServices.begin(); s != mServices.end(); ++s) {
+		(*s)->close();
+	}
+	mServices.clear();
+	mQueues.clear();
+	mQueuedBytes.clear();
+
+	monitor->stop();
+
+	if (mSyncError != nullptr) {
+		throw SyncException(*mSyncError);
+	}
+	if (mError != nullptr) {
+		mError->rethrow();
+	}
+}
+
+bool ParallelSync::nextTransfer(size_t index, Transfer& transfer) {
+	Poco::FastMutex::ScopedLock lock(mQueuesLock);
+
+	size_t source = index;
+	if (mQueues[index].empty()) {
+		// steal from the connection with the most bytes left.
+		source = std::max_element(mQueuedBytes.begin(), mQueuedBytes.end()) - mQueuedBytes.begin();
+		if (mQueues[source].empty()) {
+			return false;
+		}
+		transfer = mQueues[source].back();
+		mQueues[source].pop_back();
+	} else {
+		transfer = mQueues[index].front();
+		mQueues[index].pop_front();
+	}
+	mQueuedBytes[source] -= transfer.size;
+	return true;
+}
+
+void ParallelSync::runWorker(size_t index) {
+	std::tr1::shared_ptr<SyncService> service = mServices[index];
+	Transfer transfer;
+	try {
+		while (!mAborted && nextTransfer(index, transfer)) {
+			if (mPush) {
+				service->pushFile(transfer.localPath, transfer.remotePath, mMonitor.get());
+			} else {
+				service->pullFile(transfer.remoteEntry, transfer.localPath, mMonitor.get());
+			}
+		}
+	} catch (SyncException& e) {
+		Poco::FastMutex::ScopedLock lock(mErrorLock);
+		// a connection canceled because another one failed doesn't hide the original error.
+		if (!mAborted) {
+			mSyncError = std::tr1::shared_ptr<SyncException>(new SyncException(e));
+		}
+		mAborted = true;
+	} catch (Poco::Exception& e) {
+		Poco::FastMutex::ScopedLock lock(mErrorLock);
+		if (!mAborted) {
+			mError = std::tr1::shared_ptr<Poco::Exception>(e.clone());
+		}
+		mAborted = true;
+	} catch (std::exception& e) {
+		setError(e.what());
+	}
+}
+
+void ParallelSync::setError(const std::string& message) {
+	Poco::FastMutex::ScopedLock lock(mErrorLock);
+	if (!mAborted) {
+		mError = std::tr1::shared_ptr<Poco::Exception>(new Poco::IOException(message));
+	}
+	mAborted = true;
+}
+
+} /* namespace ddmlib */
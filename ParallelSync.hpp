@@ -0,0 +1,167 @@
+/*
+ * ParallelSync.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef PARALLELSYNC_HPP_
+#define PARALLELSYNC_HPP_
+#include "ddmlib.hpp"
+#include "FileListingService.hpp"
+#include "SyncService.hpp"
+#include <deque>
+
+namespace ddmlib {
+
+class Device;
+class SyncException;
+
+/**
+ * Transfers directory trees over several sync connections to the same device.
+ * <p/>The files are sorted largest first and dealt to the connections so that each gets the
+ * same amount of bytes. A connection which runs out of work steals the smallest pending file
+ * of the busiest one. The progress of all the connections is reported to a single
+ * {@link ISyncProgressMonitor}.
+ * <p/>The first failure cancels the other connections and is rethrown by
+ * {@link #push} / {@link #pull} once all of them stopped.
+ */
+class DDMLIB_API ParallelSync {
+public:
+	/** Default number of sync connections opened to the device. */
+	static const int DEFAULT_CONNECTION_COUNT = 4;
+
+	/**
+	 * Creates a parallel transfer engine.
+	 * @param device the {@link Device} to transfer files to or from.
+	 * @param connectionCount the number of sync connections to open.
+	 */
+	ParallelSync(std::tr1::shared_ptr<Device> device, int connectionCount = DEFAULT_CONNECTION_COUNT);
+	virtual ~ParallelSync();
+
+	int getConnectionCount() const {
+		return mConnectionCount;
+	}
+
+	/**
+	 * Pushes files and directories (recursively) into a remote directory.
+	 * @param local the local files and directories.
+	 * @param remotePath the full path of the remote directory.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @throws SyncException if a file could not be pushed
+	 * @throws IOException in case of I/O error on a connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void push(const std::vector<std::string>& local, const std::string& remotePath,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void push(const std::vector<std::string>& local, const std::string& remotePath, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pulls remote files and directories (recursively) into a local directory.
+	 * @param entries the remote item(s) to pull
+	 * @param localPath the local destination directory. It must exist.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @throws SyncException if a file could not be pulled
+	 * @throws IOException in case of I/O error on a connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void pull(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pull(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, ISyncProgressMonitor* monitor);
+
+private:
+	/**
+	 * A single file transfer.
+	 */
+	struct Transfer {
+		std::string localPath;
+		std::string remotePath;
+		long long size;
+		std::tr1::shared_ptr<FileListingService::FileEntry> remoteEntry; // pulls only
+	};
+
+	/**
+	 * Forwards the progress of all the connections to the user's monitor.
+	 */
+	class SharedProgressMonitor: public ISyncProgressMonitor {
+		ParallelSync &mOwner;
+		ISyncProgressMonitor *mMonitor;
+		mutable Poco::FastMutex mLock;
+	public:
+		SharedProgressMonitor(ParallelSync &owner, ISyncProgressMonitor *monitor) :
+				mOwner(owner), mMonitor(monitor) {
+		}
+		// the connections start and stop individually, the engine does it once for all.
+		void start(long long /*totalWork*/) {
+		}
+		void stop() {
+		}
+		bool isCanceled() const;
+		void startSubTask(const std::string &name);
+		void advance(long long work);
+	};
+
+	class Worker: public Poco::Runnable {
+		ParallelSync &mOwner;
+		size_t mIndex;
+	public:
+		Worker(ParallelSync &owner, size_t index) :
+				mOwner(owner), mIndex(index) {
+		}
+		void run() {
+			mOwner.runWorker(mIndex);
+		}
+	};
+
+	friend class SharedProgressMonitor;
+	friend class Worker;
+
+	std::tr1::shared_ptr<Device> mDevice;
+	int mConnectionCount;
+
+	bool mPush;
+	std::vector<std::deque<Transfer> > mQueues;
+	std::vector<long long> mQueuedBytes;
+	std::vector<std::tr1::shared_ptr<SyncService> > mServices;
+	Poco::FastMutex mQueuesLock;
+
+	std::tr1::shared_ptr<SharedProgressMonitor> mMonitor;
+
+	/** set on the first failure, stops the other connections. */
+	volatile bool mAborted;
+	std::tr1::shared_ptr<SyncException> mSyncError;
+	std::tr1::shared_ptr<Poco::Exception> mError;
+	Poco::FastMutex mErrorLock;
+
+	void collectLocalFiles(const std::vector<Poco::File>& files, const std::string& remotePath,
+			std::vector<Transfer>& transfers);
+
+	void collectRemoteFiles(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, std::tr1::shared_ptr<FileListingService> fls, std::vector<Transfer>& transfers);
+
+	/**
+	 * Opens the connections, deals the transfers and runs them until done or failed.
+	 */
+	void run(std::vector<Transfer>& transfers, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Takes the next transfer for a connection: the largest of its own queue, or the smallest of
+	 * the busiest other queue.
+	 * @return false if there's nothing left to do.
+	 */
+	bool nextTransfer(size_t index, Transfer& transfer);
+
+	void runWorker(size_t index);
+
+	void setError(const std::string& message);
+
+	static bool isLarger(const Transfer& t1, const Transfer& t2) {
+		return t1.size > t2.size;
+	}
+};
+
+} /* namespace ddmlib */
+#endif /* PARALLELSYNC_HPP_ */
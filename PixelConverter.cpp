@@ -0,0 +1,294 @@
+/*
+ * PixelConverter.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "PixelConverter.hpp"
+#include "RawImage.hpp"
+
+// SSE2 is part of x86-64, and of the 32 bit builds which enable it.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DDMLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 is selected at run time with GCC and clang, at build time elsewhere.
+#if defined(DDMLIB_SSE2) && defined(__GNUC__)
+#define DDMLIB_AVX2
+#define DDMLIB_AVX2_TARGET __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(DDMLIB_SSE2) && defined(__AVX2__)
+#define DDMLIB_AVX2
+#define DDMLIB_AVX2_TARGET
+#include <immintrin.h>
+#endif
+
+namespace ddmlib {
+
+namespace {
+
+inline unsigned int load32(const unsigned char* src) {
+	return (unsigned int) src[0] | (unsigned int) src[1] << 8 | (unsigned int) src[2] << 16
+			| (unsigned int) src[3] << 24;
+}
+
+inline unsigned int convert565Pixel(unsigned int value, bool rgba) {
+	if (rgba) {
+		return 0xFF000000 | (value & 0x001F) << 19 | (value & 0x07E0) << 5 | (value & 0xF800) >> 8;
+	}
+	return 0xFF000000 | (value & 0xF800) << 8 | (value & 0x07E0) << 5 | (value & 0x001F) << 3;
+}
+
+inline unsigned int swapPixel(unsigned int value, unsigned int keepMask, unsigned int alphaOr) {
+	return (value & 0xFF00FF00 & keepMask) | (value & 0x000000FF) << 16 | (value & 0x00FF0000) >> 16 | alphaOr;
+}
+
+#ifdef DDMLIB_SSE2
+// the same expressions as the scalar versions above, 4 pixels at a time.
+
+inline __m128i convert565Sse2(__m128i value, bool rgba) {
+	__m128i r = _mm_and_si128(value, _mm_set1_epi32(0xF800));
+	__m128i g = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x07E0)), 5);
+	__m128i b = _mm_and_si128(value, _mm_set1_epi32(0x001F));
+	if (rgba) {
+		r = _mm_srli_epi32(r, 8);
+		b = _mm_slli_epi32(b, 19);
+	} else {
+		r = _mm_slli_epi32(r, 8);
+		b = _mm_slli_epi32(b, 3);
+	}
+	return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, _mm_set1_epi32((int) 0xFF000000)));
+}
+
+inline __m128i swapSse2(__m128i value, __m128i middle, __m128i alphaOr) {
+	__m128i low = _mm_slli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x000000FF)), 16);
+	__m128i high = _mm_srli_epi32(_mm_and_si128(value, _mm_set1_epi32(0x00FF0000)), 16);
+	return _mm_or_si128(_mm_or_si128(_mm_and_si128(value, middle), alphaOr), _mm_or_si128(low, high));
+}
+#endif
+
+#ifdef DDMLIB_AVX2
+DDMLIB_AVX2_TARGET size_t convert565Avx2(const unsigned char* src, unsigned int* dest, size_t count, bool rgba) {
+	const __m256i maskR = _mm256_set1_epi32(0xF800);
+	const __m256i maskG = _mm256_set1_epi32(0x07E0);
+	const __m256i maskB = _mm256_set1_epi32(0x001F);
+	const __m256i alpha = _mm256_set1_epi32((int) 0xFF000000);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i value = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2)));
+		__m256i r = _mm256_and_si256(value, maskR);
+		__m256i g = _mm256_slli_epi32(_mm256_and_si256(value, maskG), 5);
+		__m256i b = _mm256_and_si256(value, maskB);
+		if (rgba) {
+			r = _mm256_srli_epi32(r, 8);
+			b = _mm256_slli_epi32(b, 19);
+		} else {
+			r = _mm256_slli_epi32(r, 8);
+			b = _mm256_slli_epi32(b, 3);
+		}
+		__m256i argb = _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, alpha));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), argb);
+	}
+	return i;
+}
+
+DDMLIB_AVX2_TARGET size_t convert32Avx2(const unsigned char* src, unsigned int* dest, size_t count, bool swap,
+		unsigned int keepMask, unsigned int alphaOr) {
+	const __m256i keep = _mm256_set1_epi32((int) keepMask);
+	const __m256i middle = _mm256_set1_epi32((int) (0xFF00FF00 & keepMask));
+	const __m256i alpha = _mm256_set1_epi32((int) alphaOr);
+	const __m256i maskLow = _mm256_set1_epi32(0x000000FF);
+	const __m256i maskHigh = _mm256_set1_epi32(0x00FF0000);
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+		__m256i result;
+		if (swap) {
+			__m256i low = _mm256_slli_epi32(_mm256_and_si256(value, maskLow), 16);
+			__m256i high = _mm256_srli_epi32(_mm256_and_si256(value, maskHigh), 16);
+			result = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(value, middle), alpha), _mm256_or_si256(low, high));
+		} else {
+			result = _mm256_or_si256(_mm256_and_si256(value, keep), alpha);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), result);
+	}
+	return i;
+}
+#endif
+
+} // namespace
+
+PixelConverter::PixelConverter(const RawImage& image, Destination destination) :
+		mKind(KIND_GENERIC), mDestination(destination), mKeepMask(0xFFFFFFFF), mAlphaOr(0), mHasAlpha(
+				image.alpha_length != 0) {
+	if (image.bpp != 16 && image.bpp != 32) {
+		throw std::runtime_error("RawImage.getARGB(int) only works in 16 and 32 bit mode.");
+	}
+	mBytesPerPixel = image.bpp >> 3;
+
+	// the generic layout, as getARGB computes it for every pixel.
+	int offsets[4] = { image.red_offset, image.green_offset, image.blue_offset, image.alpha_offset };
+	int lengths[4] = { image.red_length, image.green_length, image.blue_length, image.alpha_length };
+	for (int c = 0; c < 4; ++c) {
+		mOffsets[c] = offsets[c];
+		mMasks[c] = (1u << lengths[c]) - 1;
+		mScales[c] = 8 - lengths[c];
+	}
+
+	if (image.bpp == 16) {
+		if (image.red_offset == 11 && image.red_length == 5 && image.green_offset == 5 && image.green_length == 6
+				&& image.blue_offset == 0 && image.blue_length == 5 && image.alpha_length == 0) {
+			mKind = KIND_565;
+		}
+		return;
+	}
+
+	// 32 bit, with 8 bit channels at byte offsets: the pixels only need the red and blue
+	// bytes swapped, or nothing, once read as little-endian values.
+	bool alpha = image.alpha_length == 0 || isByteChannel(image.alpha_offset, image.alpha_length, 24);
+	if (alpha && isByteChannel(image.green_offset, image.green_length, 8)) {
+		if (isByteChannel(image.red_offset, image.red_length, 0) && isByteChannel(image.blue_offset, image.blue_length, 16)) {
+			// RGBA8888: swapped for ARGB, in place for RGBA.
+			mKind = (destination == DEST_ARGB) ? KIND_SWAP : KIND_COPY;
+		} else if (isByteChannel(image.red_offset, image.red_length, 16) && isByteChannel(image.blue_offset, image.blue_length, 0)) {
+			// BGRA8888: in place for ARGB, swapped for RGBA.
+			mKind = (destination == DEST_ARGB) ? KIND_COPY : KIND_SWAP;
+		}
+	}
+	if (image.alpha_length == 0) {
+		// force alpha to opaque if there's no alpha value in the framebuffer.
+		mKeepMask = 0x00FFFFFF;
+		mAlphaOr = 0xFF000000;
+	}
+}
+
+void PixelConverter::convert(const unsigned char* src, unsigned int* dest, size_t count) const {
+	switch (mKind) {
+	case KIND_565:
+		convert565(src, dest, count, mDestination == DEST_RGBA);
+		break;
+	case KIND_SWAP:
+		convertSwap(src, dest, count, mKeepMask, mAlphaOr);
+		break;
+	case KIND_COPY:
+		convertCopy(src, dest, count, mKeepMask, mAlphaOr);
+		break;
+	default:
+		convertGeneric(src, dest, count);
+		break;
+	}
+}
+
+const char* PixelConverter::getName() const {
+	switch (mKind) {
+	case KIND_565:
+		return "RGB565";
+	case KIND_SWAP:
+		return "32 bit, red and blue swapped";
+	case KIND_COPY:
+		return "32 bit, in place";
+	default:
+		return "generic";
+	}
+}
+
+bool PixelConverter::isByteChannel(int offset, int length, int expectedOffset) {
+	return length == 8 && offset == expectedOffset;
+}
+
+void PixelConverter::convertGeneric(const unsigned char* src, unsigned int* dest, size_t count) const {
+	for (size_t i = 0; i < count; ++i, src += mBytesPerPixel) {
+		unsigned int value = (mBytesPerPixel == 2) ? ((unsigned int) src[0] | (unsigned int) src[1] << 8) : load32(src);
+
+		unsigned int r = ((value >> mOffsets[0]) & mMasks[0]) << mScales[0];
+		unsigned int g = ((value >> mOffsets[1]) & mMasks[1]) << mScales[1];
+		unsigned int b = ((value >> mOffsets[2]) & mMasks[2]) << mScales[2];
+		unsigned int a = mHasAlpha ? ((value >> mOffsets[3]) & mMasks[3]) << mScales[3] : 0xFF;
+
+		if (mDestination == DEST_RGBA) {
+			dest[i] = a << 24 | b << 16 | g << 8 | r;
+		} else {
+			dest[i] = a << 24 | r << 16 | g << 8 | b;
+		}
+	}
+}
+
+void PixelConverter::convert565(const unsigned char* src, unsigned int* dest, size_t count, bool rgba) {
+	size_t i = 0;
+#ifdef DDMLIB_AVX2
+	if (hasAvx2()) {
+		i = convert565Avx2(src, dest, count, rgba);
+	}
+#endif
+#ifdef DDMLIB_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), convert565Sse2(_mm_unpacklo_epi16(value, zero), rgba));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4), convert565Sse2(_mm_unpackhi_epi16(value, zero), rgba));
+	}
+#endif
+	for (; i < count; ++i) {
+		dest[i] = convert565Pixel((unsigned int) src[i * 2] | (unsigned int) src[i * 2 + 1] << 8, rgba);
+	}
+}
+
+void PixelConverter::convertSwap(const unsigned char* src, unsigned int* dest, size_t count, unsigned int keepMask,
+		unsigned int alphaOr) {
+	size_t i = 0;
+#ifdef DDMLIB_AVX2
+	if (hasAvx2()) {
+		i = convert32Avx2(src, dest, count, true, keepMask, alphaOr);
+	}
+#endif
+#ifdef DDMLIB_SSE2
+	const __m128i middle = _mm_set1_epi32((int) (0xFF00FF00 & keepMask));
+	const __m128i alpha = _mm_set1_epi32((int) alphaOr);
+	for (; i + 4 <= count; i += 4) {
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), swapSse2(value, middle, alpha));
+	}
+#endif
+	for (; i < count; ++i) {
+		dest[i] = swapPixel(load32(src + i * 4), keepMask, alphaOr);
+	}
+}
+
+void PixelConverter::convertCopy(const unsigned char* src, unsigned int* dest, size_t count, unsigned int keepMask,
+		unsigned int alphaOr) {
+	size_t i = 0;
+#ifdef DDMLIB_AVX2
+	if (hasAvx2()) {
+		i = convert32Avx2(src, dest, count, false, keepMask, alphaOr);
+	}
+#endif
+#ifdef DDMLIB_SSE2
+	const __m128i keep = _mm_set1_epi32((int) keepMask);
+	const __m128i alpha = _mm_set1_epi32((int) alphaOr);
+	for (; i + 4 <= count; i += 4) {
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_and_si128(value, keep), alpha));
+	}
+#endif
+	for (; i < count; ++i) {
+		dest[i] = (load32(src + i * 4) & keepMask) | alphaOr;
+	}
+}
+
+bool PixelConverter::hasAvx2() {
+#if defined(DDMLIB_AVX2) && defined(__GNUC__)
+	static const bool avx2 = __builtin_cpu_supports("avx2") != 0;
+	return avx2;
+#elif defined(DDMLIB_AVX2)
+	return true;
+#else
+	return false;
+#endif
+}
+
+} /* namespace ddmlib */
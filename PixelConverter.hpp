@@ -0,0 +1,99 @@
+/*
+ * PixelConverter.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef PIXELCONVERTER_HPP_
+#define PIXELCONVERTER_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+class RawImage;
+
+/**
+ * Converts whole frames from the pixel layout of a {@link RawImage} header.
+ * <p/>The conversion is selected once, from the header. RGB565 and the 32 bit layouts with
+ * 8 bit channels at byte offsets (RGBA8888, BGRA8888, with or without alpha) have dedicated
+ * loops using SSE2 and AVX2 where the CPU has them. Any other layout of the version 1 header
+ * goes through a scalar loop with the shifts and masks computed once.
+ * <p/>All of them give exactly the values of {@link RawImage#getARGB(int)}.
+ */
+class DDMLIB_LOCAL PixelConverter {
+public:
+	enum Destination {
+		/** one value per pixel, as returned by {@link RawImage#getARGB(int)}. */
+		DEST_ARGB,
+		/** R, G, B, A bytes. The values are stored with the host byte order, so this holds on little-endian hosts. */
+		DEST_RGBA
+	};
+
+	/**
+	 * Selects the conversion of the pixel layout of <var>image</var>.
+	 * @throws runtime_error if the image isn't 16 or 32 bit.
+	 */
+	PixelConverter(const RawImage& image, Destination destination);
+
+	/**
+	 * Converts pixels.
+	 * @param src the pixels, in the layout of the image.
+	 * @param dest receives one value per pixel.
+	 * @param count the number of pixels.
+	 */
+	void convert(const unsigned char* src, unsigned int* dest, size_t count) const;
+
+	int getBytesPerPixel() const {
+		return mBytesPerPixel;
+	}
+
+	/**
+	 * Returns the name of the selected conversion, e.g. for logging.
+	 */
+	const char* getName() const;
+
+private:
+	enum Kind {
+		/** RGB565, no alpha. */
+		KIND_565,
+		/** 32 bit, the red and blue bytes are exchanged. */
+		KIND_SWAP,
+		/** 32 bit, the bytes stay in place. */
+		KIND_COPY,
+		/** anything else. */
+		KIND_GENERIC
+	};
+
+	Kind mKind;
+	Destination mDestination;
+	int mBytesPerPixel;
+
+	/** applied to the 32 bit values: the alpha byte is dropped and forced to opaque without alpha. */
+	unsigned int mKeepMask;
+	unsigned int mAlphaOr;
+
+	// the generic layout, in the order red, green, blue, alpha.
+	int mOffsets[4];
+	unsigned int mMasks[4];
+	int mScales[4];
+	bool mHasAlpha;
+
+	static bool isByteChannel(int offset, int length, int expectedOffset);
+
+	void convertGeneric(const unsigned char* src, unsigned int* dest, size_t count) const;
+
+	static void convert565(const unsigned char* src, unsigned int* dest, size_t count, bool rgba);
+	static void convertSwap(const unsigned char* src, unsigned int* dest, size_t count, unsigned int keepMask,
+			unsigned int alphaOr);
+	static void convertCopy(const unsigned char* src, unsigned int* dest, size_t count, unsigned int keepMask,
+			unsigned int alphaOr);
+
+	/**
+	 * Returns whether the AVX2 loops can run on this CPU.
+	 */
+	static bool hasAvx2();
+};
+
+} /* namespace ddmlib */
+#endif /* PIXELCONVERTER_HPP_ */
@@ -0,0 +1,180 @@
+/*
+ * PullJournal.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "PullJournal.hpp"
+#include "SyncException.hpp"
+#include "Log.hpp"
+
+namespace ddmlib {
+
+const char PullJournal::JOURNAL_MAGIC[] = "ddmlib-pull-journal 1";
+
+PullJournal::PullJournal(const std::string& localPath, const SyncService::FileStat& remote, unsigned int chunkSize) :
+		mLocalPath(localPath), mJournalPath(getJournalPath(localPath)), mRemote(remote), mChunkSize(chunkSize),
+		mChunkFill(0), mLength(0) {
+	load();
+}
+
+PullJournal::~PullJournal() {
+	close();
+}
+
+void PullJournal::open(bool resume) {
+	close();
+	if (resume == false) {
+		mHashes.clear();
+	}
+
+	mLength = getVerifiedLength();
+	mChunkFill = 0;
+	mChunkMd5.reset();
+
+	try {
+		if (resume) {
+			// drop what follows the verified chunks, it is pulled again.
+			Poco::File(mLocalPath).setSize((Poco::File::FileSize) mLength);
+			mFile.reset(new Poco::FileOutputStream(mLocalPath, std::ios::out | std::ios::binary | std::ios::app));
+		} else {
+			mFile.reset(new Poco::FileOutputStream(mLocalPath, std::ios::out | std::ios::binary | std::ios::trunc));
+		}
+	} catch (Poco::Exception& e) {
+		Log::e("ddms", "Failed to open local file " + mLocalPath + " for writing, Reason: " + e.displayText());
+		mFile.reset();
+		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	}
+
+	rewrite();
+}
+
+void PullJournal::addData(const unsigned char* data, unsigned int length) {
+	if (!mFile) {
+		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	}
+
+	mFile->write(reinterpret_cast<const char*>(data), length);
+	if (!mFile->good()) {
+		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	}
+	mLength += length;
+
+	while (length > 0) {
+		unsigned int count = std::min(length, mChunkSize - mChunkFill);
+		mChunkMd5.update(data, count);
+		mChunkFill += count;
+		data += count;
+		length -= count;
+
+		if (mChunkFill == mChunkSize) {
+			// the chunk must be in the file before the journal claims it.
+			mFile->flush();
+			if (!mFile->good()) {
+				throw SyncException(SyncException::FILE_WRITE_ERROR);
+			}
+
+			std::string hash = Poco::DigestEngine::digestToHex(mChunkMd5.digest());
+			mHashes.push_back(hash);
+			mChunkFill = 0;
+
+			if (mJournal) {
+				*mJournal << hash << '\n';
+				mJournal->flush();
+			}
+		}
+	}
+}
+
+void PullJournal::finish() {
+	if (mFile) {
+		mFile->close();
+		bool good = mFile->good();
+		mFile.reset();
+		if (!good) {
+			throw SyncException(SyncException::FILE_WRITE_ERROR);
+		}
+	}
+
+	mJournal.reset();
+	try {
+		Poco::File journal(mJournalPath);
+		if (journal.exists()) {
+			journal.remove();
+		}
+	} catch (Poco::Exception& e) {
+		Log::w("ddms", "Unable to remove the pull journal " + mJournalPath + ": " + e.displayText());
+	}
+}
+
+void PullJournal::close() {
+	try {
+		if (mFile) {
+			mFile->close();
+		}
+	} catch (...) {
+		// the verified chunks were flushed already.
+	}
+	mFile.reset();
+	mJournal.reset();
+}
+
+std::string PullJournal::getJournalPath(const std::string& localPath) {
+	return localPath + ".ddmlib-journal";
+}
+
+void PullJournal::load() {
+	try {
+		if (Poco::File(mJournalPath).exists() == false) {
+			return;
+		}
+
+		Poco::FileInputStream in(mJournalPath);
+
+		// the first line identifies the remote file the chunks belong to.
+		std::string line;
+		if (!std::getline(in, line) || line != getHeader()) {
+			Log::d("ddms", "Discarding the pull journal of " + mLocalPath + ", the remote file changed");
+			return;
+		}
+		while (std::getline(in, line) && line.length() == 32) {
+			mHashes.push_back(line);
+		}
+		in.close();
+
+		// only the chunks actually in the local file count.
+		Poco::File local(mLocalPath);
+		long long localSize = local.exists() ? (long long) local.getSize() : 0;
+		size_t complete = (size_t) (localSize / mChunkSize);
+		if (mHashes.size() > complete) {
+			mHashes.resize(complete);
+		}
+	} catch (Poco::Exception& e) {
+		Log::w("ddms", "Unable to read the pull journal " + mJournalPath + ": " + e.displayText());
+		mHashes.clear();
+	}
+}
+
+void PullJournal::rewrite() {
+	mJournal.reset();
+	try {
+		mJournal.reset(new Poco::FileOutputStream(mJournalPath, std::ios::out | std::ios::trunc));
+		*mJournal << getHeader() << '\n';
+		for (std::vector<std::string>::const_iterator h = mHashes.begin(); h != mHashes.end(); ++h) {
+			*mJournal << *h << '\n';
+		}
+		mJournal->flush();
+	} catch (Poco::Exception& e) {
+		Log::w("ddms", "Unable to write the pull journal " + mJournalPath + ": " + e.displayText());
+		mJournal.reset();
+	}
+}
+
+std::string PullJournal::getHeader() const {
+	return std::string(JOURNAL_MAGIC) + "\t" + Poco::NumberFormatter::format(mRemote.size) + "\t"
+			+ Poco::NumberFormatter::format(mRemote.mtime) + "\t" + Poco::NumberFormatter::format(mChunkSize);
+}
+
+} /* namespace ddmlib */
@@ -0,0 +1,131 @@
+/*
+ * PullJournal.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef PULLJOURNAL_HPP_
+#define PULLJOURNAL_HPP_
+#include "ddmlib.hpp"
+#include "SyncService.hpp"
+#include <Poco\MD5Engine.h>
+
+namespace ddmlib {
+
+/**
+ * Local state of a resumable pull.
+ * <p/>The pulled data is written to the local file and cut into chunks of a fixed size. The
+ * MD5 of every complete chunk is appended to a journal next to the local file once the chunk
+ * is flushed, so that after a failure the verified chunks are known and only the rest of the
+ * file has to be pulled again.
+ * <p/>The journal belongs to one remote file, identified by its size and modification time.
+ * It is discarded if the remote file changed, and removed once the pull completed.
+ * @see SyncService#pullFileResumable
+ */
+class DDMLIB_API PullJournal: public ISyncDataConsumer {
+public:
+	/** Default size of the verified chunks. It is also what a resumed pull fetches again. */
+	static const unsigned int DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+	/**
+	 * Loads the journal of a local file, if it belongs to <var>remote</var>.
+	 * @param localPath the local destination of the pull.
+	 * @param remote the attributes of the remote file.
+	 * @param chunkSize the size of the chunks. A journal written with another size is discarded.
+	 */
+	PullJournal(const std::string& localPath, const SyncService::FileStat& remote,
+			unsigned int chunkSize = DEFAULT_CHUNK_SIZE);
+	virtual ~PullJournal();
+
+	unsigned int getChunkSize() const {
+		return mChunkSize;
+	}
+
+	/**
+	 * Returns the number of verified chunks.
+	 */
+	size_t getChunkCount() const {
+		return mHashes.size();
+	}
+
+	/**
+	 * Returns the MD5 of a verified chunk, as lowercase hex.
+	 */
+	const std::string& getChunkHash(size_t index) const {
+		return mHashes[index];
+	}
+
+	/**
+	 * Returns the length of the start of the local file covered by verified chunks.
+	 */
+	long long getVerifiedLength() const {
+		return (long long) mHashes.size() * mChunkSize;
+	}
+
+	/**
+	 * Returns the length of the local file, verified or not.
+	 */
+	long long getLength() const {
+		return mLength;
+	}
+
+	/**
+	 * Opens the local file and the journal for writing.
+	 * @param resume true to keep the verified chunks and write after them, false to start over.
+	 * @throws SyncException if the local file can't be opened.
+	 */
+	void open(bool resume);
+
+	/**
+	 * Appends data to the local file, recording the chunks it completes.
+	 * @throws SyncException if the local file can't be written.
+	 */
+	void addData(const unsigned char* data, unsigned int length);
+
+	/**
+	 * Completes the pull: closes the local file and removes the journal.
+	 * @throws SyncException if the local file can't be written.
+	 */
+	void finish();
+
+	/**
+	 * Closes the local file and the journal, keeping them for a later resume.
+	 */
+	void close();
+
+	/**
+	 * Returns the path of the journal of a local file.
+	 */
+	static std::string getJournalPath(const std::string& localPath);
+
+private:
+	static const char JOURNAL_MAGIC[];
+
+	std::string mLocalPath;
+	std::string mJournalPath;
+	SyncService::FileStat mRemote;
+	unsigned int mChunkSize;
+
+	std::vector<std::string> mHashes;
+
+	std::tr1::shared_ptr<Poco::FileOutputStream> mFile;
+	/** null if the journal can't be written: the pull then simply can't be resumed. */
+	std::tr1::shared_ptr<Poco::FileOutputStream> mJournal;
+
+	Poco::MD5Engine mChunkMd5;
+	unsigned int mChunkFill;
+	long long mLength;
+
+	void load();
+
+	/**
+	 * Writes the header and the verified chunks to a new journal.
+	 */
+	void rewrite();
+
+	std::string getHeader() const;
+};
+
+} /* namespace ddmlib */
+#endif /* PULLJOURNAL_HPP_ */
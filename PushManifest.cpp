@@ -0,0 +1,275 @@
+/*
+ * PushManifest.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "PushManifest.hpp"
+#include "Log.hpp"
+#include <Poco\MD5Engine.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+namespace ddmlib {
+
+const char PushManifest::JOURNAL_MAGIC[] = "ddmlib-push-manifest 2";
+
+PushManifest::PushManifest(const std::string& serialNumber, const std::string& bootId, const std::string& directory) :
+		mSerialNumber(serialNumber), mBootId(bootId) {
+	Poco::Path path(directory);
+	path.makeDirectory();
+	path.setFileName(getJournalName(serialNumber));
+	mJournalPath = path.toString();
+
+	load();
+}
+
+PushManifest::~PushManifest() {
+}
+
+bool PushManifest::isPushed(const std::string& localPath, const std::string& remotePath) {
+	Entry entry;
+	{
+		Poco::FastMutex::ScopedLock lock(mLock);
+		std::map<std::string, Entry>::const_iterator e = mEntries.find(remotePath);
+		if (e == mEntries.end()) {
+			return false;
+		}
+		entry = e->second;
+	}
+
+	Poco::File f(localPath);
+	if ((long long) f.getSize() != entry.size) {
+		return false;
+	}
+
+	// another file of the same size and time, as reproducible builds make, may differ.
+	Entry local;
+	setLocalFile(localPath, local);
+	bool sameFile = local.localPath == entry.localPath && local.device == entry.device && local.inode == entry.inode;
+
+	long long mtime = (long long) f.getLastModified().epochTime();
+	if (sameFile && mtime == entry.mtime) {
+		return true;
+	}
+
+	// the file was touched since, or is another one: compare the content.
+	if (computeHash(localPath) != entry.hash) {
+		return false;
+	}
+
+	// remember the file and its time, so it isn't hashed again next time.
+	Poco::FastMutex::ScopedLock lock(mLock);
+	std::map<std::string, Entry>::iterator e = mEntries.find(remotePath);
+	if (e != mEntries.end() && e->second.hash == entry.hash && local.localPath.find_first_of("\t\r\n") == std::string::npos) {
+		e->second.mtime = mtime;
+		e->second.localPath = local.localPath;
+		e->second.device = local.device;
+		e->second.inode = local.inode;
+		appendRecord(remotePath, e->second);
+	}
+	return true;
+}
+
+void PushManifest::recordPush(const std::string& localPath, const std::string& remotePath) {
+	record(localPath, remotePath, createEntry(localPath));
+}
+
+void PushManifest::record(const std::string& localPath, const std::string& remotePath, const Entry& entry) {
+	Entry pushed(entry);
+	setLocalFile(localPath, pushed);
+
+	// the journal is line based, such paths can't be recorded.
+	if (remotePath.find_first_of("\t\r\n") != std::string::npos
+			|| pushed.localPath.find_first_of("\t\r\n") != std::string::npos) {
+		forget(remotePath);
+		return;
+	}
+
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mEntries[remotePath] = pushed;
+	appendRecord(remotePath, pushed);
+}
+
+void PushManifest::forget(const std::string& remotePath) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	if (removeEntries(remotePath)) {
+		appendRemoval(remotePath);
+	}
+}
+
+void PushManifest::reset() {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mEntries.clear();
+	rewrite();
+}
+
+size_t PushManifest::getEntryCount() {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mEntries.size();
+}
+
+PushManifest::Entry PushManifest::createEntry(const std::string& localPath) {
+	Poco::File f(localPath);
+	Entry entry;
+	entry.hash = computeHash(localPath);
+	entry.size = (long long) f.getSize();
+	entry.mtime = (long long) f.getLastModified().epochTime();
+	setLocalFile(localPath, entry);
+	return entry;
+}
+
+void PushManifest::setLocalFile(const std::string& localPath, Entry& entry) {
+	entry.localPath = Poco::Path(localPath).absolute().toString();
+	entry.device = 0;
+	entry.inode = 0;
+#ifndef _WIN32
+	struct stat st;
+	if (::stat(localPath.c_str(), &st) == 0) {
+		entry.device = (long long) st.st_dev;
+		entry.inode = (long long) st.st_ino;
+	}
+#endif
+}
+
+std::string PushManifest::computeHash(const std::string& localPath) {
+	Poco::MD5Engine md5;
+	Poco::FileInputStream fis(localPath, std::ios::in | std::ios::binary);
+
+	std::vector<char> buffer(64 * 1024);
+	while (true) {
+		fis.read(&buffer[0], buffer.size());
+		std::streamsize readCount = fis.gcount();
+		if (readCount == 0) {
+			break;
+		}
+		md5.update(&buffer[0], (unsigned int) readCount);
+	}
+
+	return Poco::DigestEngine::digestToHex(md5.digest());
+}
+
+void PushManifest::load() {
+	if (Poco::File(mJournalPath).exists()) {
+		Poco::FileInputStream in(mJournalPath);
+
+		// the first line holds the boot the records belong to.
+		std::string line;
+		bool valid = std::getline(in, line) && line == std::string(JOURNAL_MAGIC) + "\t" + mBootId;
+
+		size_t records = 0;
+		while (valid && std::getline(in, line)) {
+			Poco::StringTokenizer tokens(line, "\t");
+			if (tokens.count() == 8 && tokens[0] == "+") {
+				Poco::Int64 size = 0, mtime = 0, device = 0, inode = 0;
+				if (Poco::NumberParser::tryParse64(tokens[2], size) && Poco::NumberParser::tryParse64(tokens[3], mtime)
+						&& Poco::NumberParser::tryParse64(tokens[4], device) && Poco::NumberParser::tryParse64(tokens[5], inode)) {
+					Entry entry;
+					entry.hash = tokens[1];
+					entry.size = size;
+					entry.mtime = mtime;
+					entry.device = device;
+					entry.inode = inode;
+					entry.localPath = tokens[6];
+					mEntries[tokens[7]] = entry;
+				}
+			} else if (tokens.count() == 2 && tokens[0] == "-") {
+				removeEntries(tokens[1]);
+			}
+			++records;
+		}
+		in.close();
+
+		if (valid == false) {
+			Log::d("ddms", "Discarding the push manifest of " + mSerialNumber + ", the device rebooted");
+		} else if (records <= 2 * mEntries.size() + 64) {
+			try {
+				mJournal.reset(new Poco::FileOutputStream(mJournalPath, std::ios::out | std::ios::app));
+				return;
+			} catch (Poco::Exception& e) {
+				Log::w("ddms", "Unable to open the push manifest " + mJournalPath + ": " + e.displayText());
+			}
+		}
+	}
+
+	// new device, other boot, or mostly overwritten records: start a compact journal.
+	rewrite();
+}
+
+void PushManifest::rewrite() {
+	mJournal.reset();
+	try {
+		Poco::File(Poco::Path(mJournalPath).parent()).createDirectories();
+
+		std::string tempPath = mJournalPath + ".tmp";
+		Poco::FileOutputStream out(tempPath);
+		out << JOURNAL_MAGIC << '\t' << mBootId << '\n';
+		for (std::map<std::string, Entry>::const_iterator e = mEntries.begin(); e != mEntries.end(); ++e) {
+			writeRecord(out, e->first, e->second);
+		}
+		out.close();
+
+#ifdef _WIN32
+		// renaming doesn't replace an existing file there.
+		Poco::File journal(mJournalPath);
+		if (journal.exists()) {
+			journal.remove();
+		}
+#endif
+		Poco::File(tempPath).renameTo(mJournalPath);
+		mJournal.reset(new Poco::FileOutputStream(mJournalPath, std::ios::out | std::ios::app));
+	} catch (Poco::Exception& e) {
+		Log::w("ddms", "Unable to write the push manifest " + mJournalPath + ": " + e.displayText());
+		mJournal.reset();
+	}
+}
+
+void PushManifest::appendRecord(const std::string& remotePath, const Entry& entry) {
+	if (mJournal) {
+		writeRecord(*mJournal, remotePath, entry);
+		mJournal->flush();
+	}
+}
+
+void PushManifest::writeRecord(std::ostream& out, const std::string& remotePath, const Entry& entry) {
+	out << "+\t" << entry.hash << '\t' << entry.size << '\t' << entry.mtime << '\t' << entry.device << '\t'
+			<< entry.inode << '\t' << entry.localPath << '\t' << remotePath << '\n';
+}
+
+void PushManifest::appendRemoval(const std::string& remotePath) {
+	if (mJournal) {
+		*mJournal << "-\t" << remotePath << '\n';
+		mJournal->flush();
+	}
+}
+
+bool PushManifest::removeEntries(const std::string& remotePath) {
+	bool removed = mEntries.erase(remotePath) > 0;
+
+	// the children sort right after "<path>/".
+	std::string prefix = remotePath + "/";
+	std::map<std::string, Entry>::iterator e = mEntries.lower_bound(prefix);
+	while (e != mEntries.end() && e->first.compare(0, prefix.length(), prefix) == 0) {
+		mEntries.erase(e++);
+		removed = true;
+	}
+	return removed;
+}
+
+std::string PushManifest::getJournalName(const std::string& serialNumber) {
+	// serial numbers of network devices contain ':', which isn't valid everywhere.
+	std::string name(serialNumber);
+	for (std::string::iterator c = name.begin(); c != name.end(); ++c) {
+		if (!isalnum((unsigned char) *c) && *c != '.' && *c != '-' && *c != '_') {
+			*c = '_';
+		}
+	}
+	return name + ".manifest";
+}
+
+} /* namespace ddmlib */
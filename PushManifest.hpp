@@ -0,0 +1,144 @@
+/*
+ * PushManifest.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef PUSHMANIFEST_HPP_
+#define PUSHMANIFEST_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+/**
+ * Host-side record of the files pushed to a device.
+ * <p/>Each entry holds the MD5, size and modification time of the local file pushed to a
+ * remote path. A push of the same content to the same path can then be skipped without
+ * asking the device anything.
+ * <p/>The manifest is kept in a journal file per device, and belongs to one boot of the
+ * device: it is emptied when the boot id of the device changes. It assumes ddmlib is the only
+ * writer of the recorded paths; {@link #reset()} drops everything otherwise.
+ * <p/>This class is thread-safe.
+ */
+class DDMLIB_API PushManifest {
+public:
+	/**
+	 * What was pushed to a remote path.
+	 */
+	struct Entry {
+		/** MD5 of the content, as lowercase hex. */
+		std::string hash;
+		/** size of the local file when it was pushed. */
+		long long size;
+		/** modification time of the local file when it was pushed, in seconds. */
+		long long mtime;
+		/** absolute path of the local file pushed. */
+		std::string localPath;
+		/** device and inode of the local file, 0 where unknown. */
+		long long device;
+		long long inode;
+	};
+
+	/**
+	 * Opens the manifest of a device, loading its journal.
+	 * @param serialNumber the serial number of the device.
+	 * @param bootId the current boot id of the device. A journal from another boot is discarded.
+	 * @param directory the directory of the journal files. If it can't be created, the
+	 *      manifest is only kept in memory.
+	 */
+	PushManifest(const std::string& serialNumber, const std::string& bootId, const std::string& directory);
+	virtual ~PushManifest();
+
+	std::string getSerialNumber() const {
+		return mSerialNumber;
+	}
+
+	std::string getBootId() const {
+		return mBootId;
+	}
+
+	/**
+	 * Returns whether the content of a local file was already pushed to a remote path.
+	 * <p/>If the same local file was pushed there, its size and modification time are
+	 * compared first, and the content is only hashed if the file was touched since. The
+	 * content of another local file is always hashed.
+	 */
+	bool isPushed(const std::string& localPath, const std::string& remotePath);
+
+	/**
+	 * Records that a local file was pushed to a remote path.
+	 */
+	void recordPush(const std::string& localPath, const std::string& remotePath);
+
+	/**
+	 * Records that a local file with the content described by <var>entry</var> was pushed to
+	 * a remote path. The local file fields of <var>entry</var> are filled in from
+	 * <var>localPath</var>.
+	 * @see #createEntry(std::string)
+	 */
+	void record(const std::string& localPath, const std::string& remotePath, const Entry& entry);
+
+	/**
+	 * Describes the current content of a local file.
+	 */
+	static Entry createEntry(const std::string& localPath);
+
+	/**
+	 * Fills the local file fields of <var>entry</var>: the absolute path, device and inode.
+	 */
+	static void setLocalFile(const std::string& localPath, Entry& entry);
+
+	/**
+	 * Forgets a remote path, and everything below it if it is a directory.
+	 */
+	void forget(const std::string& remotePath);
+
+	/**
+	 * Forgets everything.
+	 */
+	void reset();
+
+	size_t getEntryCount();
+
+	/**
+	 * Returns the MD5 of a local file, as lowercase hex.
+	 * @throws Poco::FileException if the file can't be read.
+	 */
+	static std::string computeHash(const std::string& localPath);
+
+private:
+	static const char JOURNAL_MAGIC[];
+
+	std::string mSerialNumber;
+	std::string mBootId;
+	std::string mJournalPath;
+
+	std::map<std::string, Entry> mEntries;
+
+	/** open in append mode, null if the manifest is only in memory. */
+	std::tr1::shared_ptr<std::ostream> mJournal;
+	Poco::FastMutex mLock;
+
+	void load();
+
+	/**
+	 * Writes the current entries to a new journal, and replaces the old one with it.
+	 */
+	void rewrite();
+
+	void appendRecord(const std::string& remotePath, const Entry& entry);
+	static void writeRecord(std::ostream& out, const std::string& remotePath, const Entry& entry);
+	void appendRemoval(const std::string& remotePath);
+
+	/**
+	 * Removes a path and its children from the entries.
+	 * @return true if anything was removed.
+	 */
+	bool removeEntries(const std::string& remotePath);
+
+	static std::string getJournalName(const std::string& serialNumber);
+};
+
+} /* namespace ddmlib */
+#endif /* PUSHMANIFEST_HPP_ */
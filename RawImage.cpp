@@ -8,9 +8,78 @@
 #include "ddmlib.hpp"
 #include "RawImage.hpp"
 #include "ByteBuffer.hpp"
+#include "PixelConverter.hpp"
+#include <cstring>
 
 namespace ddmlib {
 
+namespace {
+
+/** side of the square tiles moved at once: 32 * 32 pixels of 4 bytes fill 4KB. */
+const int ROTATION_TILE = 32;
+
+/** copies a pixel of N bytes: the constant size lets the compiler make it a single move. */
+template<int N> inline void copyPixel(const unsigned char* src, unsigned char* dest, int /*byteCount*/) {
+	memcpy(dest, src, N);
+}
+
+template<> inline void copyPixel<0>(const unsigned char* src, unsigned char* dest, int byteCount) {
+	memcpy(dest, src, byteCount);
+}
+
+/**
+ * Rotates the tile at x0, y0 of an image of w * h pixels counter-clockwise.
+ * <p/>The tile is read from <var>src</var>, with <var>srcStride</var> bytes per row, and
+ * written to its place in <var>dest</var>. The destination rows are written sequentially
+ * within the tile. N is the pixel size, 0 for a size only known at run time.
+ */
+template<int N> void rotateTile(const unsigned char* src, size_t srcStride, int x0, int y0, int tw, int th, int w,
+		int h, int angle, unsigned char* dest, int byteCount) {
+	const size_t pixel = N != 0 ? N : byteCount;
+	if (angle == 180) {
+		for (int y = 0; y < th; y++) {
+			const unsigned char* s = src + y * srcStride;
+			unsigned char* d = dest + ((size_t) (h - 1 - y0 - y) * w + (w - 1 - x0)) * pixel;
+			for (int x = 0; x < tw; x++, s += pixel, d -= pixel) {
+				copyPixel<N>(s, d, byteCount);
+			}
+		}
+		return;
+	}
+
+	for (int x = 0; x < tw; x++) {
+		const unsigned char* s = src + x * pixel;
+		unsigned char* d;
+		if (angle == 90) {
+			// (x, y) goes to (y, w - 1 - x)
+			d = dest + ((size_t) (w - 1 - x0 - x) * h + y0) * pixel;
+			for (int y = 0; y < th; y++, s += srcStride, d += pixel) {
+				copyPixel<N>(s, d, byteCount);
+			}
+		} else {
+			// (x, y) goes to (h - 1 - y, x)
+			d = dest + ((size_t) (x0 + x) * h + (h - 1 - y0)) * pixel;
+			for (int y = 0; y < th; y++, s += srcStride, d -= pixel) {
+				copyPixel<N>(s, d, byteCount);
+			}
+		}
+	}
+}
+
+template<int N> void rotateImage(const unsigned char* src, int w, int h, int angle, unsigned char* dest,
+		int byteCount) {
+	const size_t stride = (size_t) w * byteCount;
+	for (int y0 = 0; y0 < h; y0 += ROTATION_TILE) {
+		int th = std::min(ROTATION_TILE, h - y0);
+		for (int x0 = 0; x0 < w; x0 += ROTATION_TILE) {
+			int tw = std::min(ROTATION_TILE, w - x0);
+			rotateTile<N>(src + y0 * stride + x0 * byteCount, stride, x0, y0, tw, th, w, h, angle, dest, byteCount);
+		}
+	}
+}
+
+} // namespace
+
 RawImage::RawImage() {
 	version = 0;
 	bpp = 0;
@@ -96,6 +165,11 @@ int RawImage::getHeaderSize(int version) {
 }
 
 std::tr1::shared_ptr<RawImage> RawImage::getRotated() {
+	return getRotated(90);
+}
+
+std::tr1::shared_ptr<RawImage> RawImage::getRotated(int angle) {
+	checkAngle(angle);
 
 	std::tr1::shared_ptr<RawImage> rotated(new RawImage());
 	rotated->version = version;
@@ -110,25 +184,77 @@ std::tr1::shared_ptr<RawImage> RawImage::getRotated() {
 	rotated->alpha_offset = alpha_offset;
 	rotated->alpha_length = alpha_length;
 
-	rotated->width = height;
-	rotated->height = width;
+	if (angle == 0 || angle == 180) {
+		rotated->width = width;
+		rotated->height = height;
+	} else {
+		rotated->width = height;
+		rotated->height = width;
+	}
+
+	if (angle == 0) {
+		rotated->data = data;
+		return rotated;
+	}
 
+	if (!isComplete()) {
+		throw std::runtime_error("RawImage.getRotated(int) needs width * height pixels.");
+	}
 	int count = data.size();
 	rotated->data.resize(count);
 
 	int byteCount = bpp >> 3; // bpp is in bits, we want bytes to match our array
-	int w = width;
-	int h = height;
-	for (int y = 0; y < h; y++) {
-		for (int x = 0; x < w; x++) {
-			std::copy(this->data.begin() + (y * w + x) * byteCount, this->data.begin() + (y * w + x) * byteCount + byteCount,
-					rotated->data.begin() + ((w - x - 1) * h + y) * byteCount);
-		}
+	if (count == 0 || byteCount == 0) {
+		return rotated;
+	}
+	const unsigned char* src = &data[0];
+	unsigned char* dest = &rotated->data[0];
+	switch (byteCount) {
+	case 2:
+		rotateImage<2>(src, width, height, angle, dest, byteCount);
+		break;
+	case 4:
+		rotateImage<4>(src, width, height, angle, dest, byteCount);
+		break;
+	default:
+		rotateImage<0>(src, width, height, angle, dest, byteCount);
+		break;
 	}
 
 	return rotated;
 }
 
+void RawImage::convertRotatedToARGB(int angle, unsigned int* dest) const {
+	checkAngle(angle);
+	if (angle == 0) {
+		convertToARGB(dest);
+		return;
+	}
+	if (!isComplete()) {
+		throw std::runtime_error("RawImage.convertRotatedToARGB(int) needs width * height pixels.");
+	}
+
+	PixelConverter converter(*this, PixelConverter::DEST_ARGB);
+	const size_t stride = (size_t) width * converter.getBytesPerPixel();
+
+	// each tile is converted into a small buffer, which is then rotated into place.
+	std::vector<unsigned int> tile(ROTATION_TILE * ROTATION_TILE);
+	const unsigned char* tileBytes = reinterpret_cast<const unsigned char*>(&tile[0]);
+	const size_t tileStride = ROTATION_TILE * sizeof(unsigned int);
+	for (int y0 = 0; y0 < height; y0 += ROTATION_TILE) {
+		int th = std::min(ROTATION_TILE, height - y0);
+		for (int x0 = 0; x0 < width; x0 += ROTATION_TILE) {
+			int tw = std::min(ROTATION_TILE, width - x0);
+			for (int y = 0; y < th; y++) {
+				converter.convert(&data[(y0 + y) * stride + x0 * converter.getBytesPerPixel()],
+						&tile[y * ROTATION_TILE], tw);
+			}
+			rotateTile<4>(tileBytes, tileStride, x0, y0, tw, th, width, height, angle,
+					reinterpret_cast<unsigned char*>(dest), 4);
+		}
+	}
+}
+
 unsigned int RawImage::getARGB(int index) {
 	unsigned int value;
 	if (bpp == 16) {
@@ -156,6 +282,37 @@ unsigned int RawImage::getARGB(int index) {
 	return a << 24 | r << 16 | g << 8 | b;
 }
 
+void RawImage::convertToARGB(unsigned int* dest) const {
+	PixelConverter converter(*this, PixelConverter::DEST_ARGB);
+	converter.convert(data.empty() ? nullptr : &data[0], dest, getPixelCount());
+}
+
+void RawImage::convertToRGBA(unsigned int* dest) const {
+	PixelConverter converter(*this, PixelConverter::DEST_RGBA);
+	converter.convert(data.empty() ? nullptr : &data[0], dest, getPixelCount());
+}
+
+size_t RawImage::getPixelCount() const {
+	size_t byteCount = bpp >> 3;
+	if (byteCount == 0) {
+		return 0;
+	}
+	return std::min((size_t) width * (size_t) height, data.size() / byteCount);
+}
+
+bool RawImage::isComplete() const {
+	if (width < 0 || height < 0) {
+		return false;
+	}
+	return (size_t) width * (size_t) height * (size_t) (bpp >> 3) <= data.size();
+}
+
+void RawImage::checkAngle(int angle) {
+	if (angle != 0 && angle != 90 && angle != 180 && angle != 270) {
+		throw std::invalid_argument("RawImage rotation must be 0, 90, 180 or 270 degrees.");
+	}
+}
+
 int RawImage::getMask(int length, int offset) {
 	int res = getMask(length) << offset;
 
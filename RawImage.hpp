@@ -66,10 +66,44 @@ public:
 	 * The image is rotated counter-clockwise.
 	 */
 	std::tr1::shared_ptr<RawImage> getRotated();
+	/**
+	 * Returns a version of the image rotated counter-clockwise by <var>angle</var>.
+	 * <p/>The pixels are moved tile by tile, so that both the source and the destination
+	 * stay in the cache for large frames.
+	 * @param angle 0, 90, 180 or 270.
+	 * @throws invalid_argument for any other angle.
+	 */
+	std::tr1::shared_ptr<RawImage> getRotated(int angle);
+	/**
+	 * Converts the whole image to ARGB integer values, as {@link #convertToARGB(unsigned int*)},
+	 * rotated counter-clockwise by <var>angle</var> in the same pass.
+	 * <p/>The destination is {@link #height} values wide for 90 and 270.
+	 * @param angle 0, 90, 180 or 270.
+	 * @param dest receives width * height values.
+	 * @throws invalid_argument for any other angle.
+	 */
+	void convertRotatedToARGB(int angle, unsigned int* dest) const;
 	/**
 	 * Returns an ARGB integer value for the pixel at <var>index</var> in {@link #data}.
 	 */
 	unsigned int getARGB(int index);
+	/**
+	 * Converts the whole image to ARGB integer values, as returned by {@link #getARGB(int)}.
+	 * <p/>The conversion is selected once for the pixel layout of the image, and uses SIMD
+	 * instructions for the common layouts.
+	 * @param dest receives {@link #getPixelCount()} values.
+	 */
+	void convertToARGB(unsigned int* dest) const;
+	/**
+	 * Converts the whole image to R, G, B, A bytes, with the same channel values as
+	 * {@link #getARGB(int)}.
+	 * @param dest receives {@link #getPixelCount()} values, as 4 bytes each in memory.
+	 */
+	void convertToRGBA(unsigned int* dest) const;
+	/**
+	 * Returns the number of complete pixels in {@link #data}.
+	 */
+	size_t getPixelCount() const;
 	RawImage();
 	virtual ~RawImage();
 
@@ -86,6 +120,13 @@ private:
 	 */
 	static int getMask(int length);
 
+	/**
+	 * Returns whether {@link #data} holds width * height pixels.
+	 */
+	bool isComplete() const;
+
+	static void checkAngle(int angle);
+
 };
 
 } /* namespace ddmlib */
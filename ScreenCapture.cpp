@@ -0,0 +1,277 @@
+/*
+ * ScreenCapture.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "ScreenCapture.hpp"
+#include "AdbHelper.hpp"
+#include "AdbCommandRejectedException.hpp"
+#include "Device.hpp"
+#include "DdmPreferences.hpp"
+#include "IRawOutputReceiver.hpp"
+#include "RawImage.hpp"
+#include "TransferScheduler.hpp"
+#include "Log.hpp"
+#include <Poco\CountingStream.h>
+#include <Poco\InflatingStream.h>
+#include <cstring>
+
+namespace ddmlib {
+
+namespace {
+
+// the pixel formats written by screencap, from ui/PixelFormat.h
+const int PIXEL_FORMAT_RGBA_8888 = 1;
+const int PIXEL_FORMAT_RGBX_8888 = 2;
+const int PIXEL_FORMAT_RGB_565 = 4;
+const int PIXEL_FORMAT_BGRA_8888 = 5;
+
+/** width, height and format. Newer versions of screencap add the color space. */
+const int SCREENCAP_HEADER_SIZE = 12;
+const int SCREENCAP_COLOR_SPACE_SIZE = 4;
+
+class PngCollector: public IRawOutputReceiver {
+	std::vector<unsigned char>& mPng;
+public:
+	PngCollector(std::vector<unsigned char>& png) :
+			mPng(png) {
+	}
+	void addOutput(const unsigned char* data, unsigned int length) {
+		mPng.insert(mPng.end(), data, data + length);
+	}
+	void done() {
+	}
+	bool isCancelled() {
+		return false;
+	}
+};
+
+int readInt(const unsigned char* data) {
+	return data[0] | data[1] << 8 | data[2] << 16 | data[3] << 24;
+}
+
+} // namespace
+
+ScreenCapture::ScreenCapture(std::tr1::shared_ptr<Device> device) :
+		mDevice(device), mTransport(TRANSPORT_AUTO), mLastTransport(TRANSPORT_RAW), mCompressedSupport(
+				SUPPORT_UNKNOWN), mThroughput(0), mCompressedDuration(0), mFrameSize(0), mLastWireSize(0), mCaptureCount(
+				0) {
+}
+
+ScreenCapture::~ScreenCapture() {
+}
+
+bool ScreenCapture::capture(RawImage& image) {
+	Transport transport = chooseTransport();
+	++mCaptureCount;
+
+	Poco::Timestamp start;
+	if (transport == TRANSPORT_COMPRESSED) {
+		bool result;
+		try {
+			result = captureCompressed(image);
+		} catch (AdbCommandRejectedException& e) {
+			// no exec service.
+			if (disableCompressed(e.what()) == false) {
+				throw;
+			}
+			return capture(image);
+		} catch (Poco::TimeoutException& e) {
+			if (disableCompressed(e.displayText()) == false) {
+				throw;
+			}
+			return capture(image);
+		} catch (Poco::IOException& e) {
+			if (disableCompressed(e.displayText()) == false) {
+				throw;
+			}
+			return capture(image);
+		}
+		mLastTransport = TRANSPORT_COMPRESSED;
+		if (result == false) {
+			// screencap may not know the format while the framebuffer service does.
+			if (mTransport == TRANSPORT_COMPRESSED) {
+				return false;
+			}
+			mCompressedSupport = SUPPORT_NO;
+			return capture(image);
+		}
+		mCompressedSupport = SUPPORT_YES;
+		mFrameSize = image.data.size();
+		mCompressedDuration = average(mCompressedDuration, (double) start.elapsed());
+		return true;
+	}
+
+	if (captureRaw(image) == false) {
+		return false;
+	}
+	mLastTransport = TRANSPORT_RAW;
+	mLastWireSize = image.size;
+	mFrameSize = image.size;
+	double elapsed = std::max((double) start.elapsed(), 1.0);
+	mThroughput = average(mThroughput, mFrameSize * 1000000.0 / elapsed);
+	return true;
+}
+
+void ScreenCapture::captureEncoded(IRawOutputReceiver* receiver) {
+	mDevice->executeRawCommand("screencap -p", receiver, DdmPreferences::getTimeOut());
+}
+
+void ScreenCapture::captureEncoded(std::vector<unsigned char>& png) {
+	png.clear();
+	PngCollector collector(png);
+	captureEncoded(&collector);
+	record(png.size());
+}
+
+bool ScreenCapture::disableCompressed(const std::string& reason) {
+	// the first attempt tells whether the device can compress at all.
+	if (mCompressedSupport != SUPPORT_UNKNOWN || mTransport == TRANSPORT_COMPRESSED) {
+		return false;
+	}
+	Log::w("ddms", "Compressed screen capture unavailable, using the framebuffer: " + reason);
+	mCompressedSupport = SUPPORT_NO;
+	return true;
+}
+
+ScreenCapture::Transport ScreenCapture::chooseTransport() const {
+	if (mTransport != TRANSPORT_AUTO) {
+		return mTransport;
+	}
+	if (mCompressedSupport == SUPPORT_NO) {
+		return TRANSPORT_RAW;
+	}
+
+	// measure both transports first, then the one not chosen every PROBE_INTERVAL captures.
+	if (mThroughput == 0) {
+		return TRANSPORT_RAW;
+	}
+	if (mCompressedDuration == 0) {
+		return TRANSPORT_COMPRESSED;
+	}
+
+	double rawDuration = mFrameSize * 1000000.0 / mThroughput;
+	Transport fastest = (mCompressedDuration < rawDuration) ? TRANSPORT_COMPRESSED : TRANSPORT_RAW;
+	if (mCaptureCount % PROBE_INTERVAL == PROBE_INTERVAL - 1) {
+		return (fastest == TRANSPORT_RAW) ? TRANSPORT_COMPRESSED : TRANSPORT_RAW;
+	}
+	return fastest;
+}
+
+bool ScreenCapture::captureRaw(RawImage& image) {
+	if (AdbHelper::readFrameBuffer(mDevice->getServerAddress(), mDevice.get(), image) == false) {
+		return false;
+	}
+	record(image.size);
+	return true;
+}
+
+bool ScreenCapture::captureCompressed(RawImage& image) {
+	// the stream must stay open until gzip is done: adb kills the command on a half-close.
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> chan = mDevice->openExecChannel("screencap </dev/null | gzip -1");
+	chan->setReceiveTimeout(Poco::Timespan((Poco::Timespan::TimeDiff) DdmPreferences::getTimeOut() * 1000));
+
+	bool result = false;
+	Poco::Net::SocketInputStream socketIn(*chan);
+	Poco::CountingInputStream counter(socketIn);
+	try {
+		Poco::InflatingInputStream in(counter, Poco::InflatingStreamBuf::STREAM_GZIP);
+
+		unsigned char header[SCREENCAP_HEADER_SIZE];
+		in.read(reinterpret_cast<char*>(header), sizeof(header));
+		if (in.gcount() != (std::streamsize) sizeof(header)) {
+			throw Poco::IOException("Truncated screencap header");
+		}
+		int width = readInt(header);
+		int height = readInt(header + 4);
+		if (width > 0 && height > 0 && setFormat(image, readInt(header + 8))) {
+			image.width = width;
+			image.height = height;
+			image.size = width * height * (image.bpp >> 3);
+
+			// the color space, if there is one, is only known once the stream ends: read it as
+			// part of the pixels, and move them back over it.
+			image.data.resize(image.size + SCREENCAP_COLOR_SPACE_SIZE);
+			in.read(reinterpret_cast<char*>(&image.data[0]), image.data.size());
+			std::streamsize count = in.gcount();
+			if (count == (std::streamsize) image.data.size()) {
+				memmove(&image.data[0], &image.data[SCREENCAP_COLOR_SPACE_SIZE], image.size);
+			} else if (count != image.size) {
+				throw Poco::IOException("Truncated screencap pixels");
+			}
+			image.data.resize(image.size);
+			result = true;
+		} else {
+			Log::e("Screenshot", "Unsupported screencap format: " + Poco::NumberFormatter::format(readInt(header + 8)));
+		}
+	} catch (...) {
+		chan->close();
+		throw;
+	}
+	chan->close();
+
+	mLastWireSize = counter.chars();
+	record(mLastWireSize);
+	return result;
+}
+
+bool ScreenCapture::setFormat(RawImage& image, int format) {
+	image.version = 1;
+	image.bpp = 32;
+	image.red_length = 8;
+	image.green_offset = 8;
+	image.green_length = 8;
+	image.blue_length = 8;
+	image.alpha_offset = 24;
+	image.alpha_length = 8;
+
+	switch (format) {
+	case PIXEL_FORMAT_RGBA_8888:
+		image.red_offset = 0;
+		image.blue_offset = 16;
+		return true;
+	case PIXEL_FORMAT_RGBX_8888:
+		image.red_offset = 0;
+		image.blue_offset = 16;
+		image.alpha_offset = 0;
+		image.alpha_length = 0;
+		return true;
+	case PIXEL_FORMAT_BGRA_8888:
+		image.red_offset = 16;
+		image.blue_offset = 0;
+		return true;
+	case PIXEL_FORMAT_RGB_565:
+		image.bpp = 16;
+		image.red_offset = 11;
+		image.red_length = 5;
+		image.green_offset = 5;
+		image.green_length = 6;
+		image.blue_offset = 0;
+		image.blue_length = 5;
+		image.alpha_offset = 0;
+		image.alpha_length = 0;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ScreenCapture::record(long long bytes) {
+	// the screenshots share the link with the other interactive traffic of the device.
+	std::tr1::shared_ptr<TransferScheduler> scheduler = mDevice->getTransferScheduler();
+	if (scheduler) {
+		scheduler->record(TransferScheduler::PRIORITY_INTERACTIVE, (unsigned int) bytes);
+	}
+}
+
+double ScreenCapture::average(double value, double sample) {
+	if (value == 0) {
+		return sample;
+	}
+	return (value * 3 + sample) / 4;
+}
+
+} /* namespace ddmlib */
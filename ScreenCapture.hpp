@@ -0,0 +1,151 @@
+/*
+ * ScreenCapture.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef SCREENCAPTURE_HPP_
+#define SCREENCAPTURE_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+class Device;
+class RawImage;
+class IRawOutputReceiver;
+
+/**
+ * Captures screenshots of a device, compressing them on the device when it is faster.
+ * <p/>Two transports give a {@link RawImage}:
+ * <ul>
+ * <li>raw: the adb framebuffer service, which sends the uncompressed pixels.</li>
+ * <li>compressed: <code>screencap | gzip -1</code> run through the <code>exec:</code>
+ * service. The stream is inflated while it is received, straight into the image.</li>
+ * </ul>
+ * <p/>In automatic mode, the throughput of the link is measured on the raw captures and the
+ * duration of the compressed ones, and every capture uses the transport expected to be the
+ * fastest. The other one is tried again now and then, so the choice follows the load of the
+ * link. Devices without <code>gzip</code> only use the raw transport.
+ * <p/>{@link #captureEncoded} gives the PNG encoded by <code>screencap -p</code> instead.
+ * <p/>This class is not thread-safe: use one instance per device and thread.
+ */
+class DDMLIB_API ScreenCapture {
+public:
+	enum Transport {
+		TRANSPORT_AUTO, TRANSPORT_RAW, TRANSPORT_COMPRESSED
+	};
+
+	/** Number of captures after which the transport not chosen is measured again. */
+	static const int PROBE_INTERVAL = 16;
+
+	ScreenCapture(std::tr1::shared_ptr<Device> device);
+	virtual ~ScreenCapture();
+
+	/**
+	 * Forces a transport, or restores the automatic choice with {@link #TRANSPORT_AUTO}.
+	 */
+	void setTransport(Transport transport) {
+		mTransport = transport;
+	}
+
+	Transport getTransport() const {
+		return mTransport;
+	}
+
+	/**
+	 * Captures the screen into <var>image</var>, which is only reallocated if the size of the
+	 * screen changed.
+	 * @return false if the screen format of the device is not supported.
+	 * @throws TimeoutException in case of timeout on the connection.
+	 * @throws AdbCommandRejectedException if adb rejects the command
+	 * @throws IOException in case of I/O error on the connection.
+	 */
+	bool capture(RawImage& image);
+
+	/**
+	 * Captures the screen as a PNG file encoded on the device.
+	 * @param receiver receives the bytes of the PNG file as they arrive.
+	 * @throws same as {@link #capture}.
+	 */
+	void captureEncoded(IRawOutputReceiver* receiver);
+
+	/**
+	 * Captures the screen as a PNG file encoded on the device.
+	 * @param png receives the PNG file.
+	 * @throws same as {@link #capture}.
+	 */
+	void captureEncoded(std::vector<unsigned char>& png);
+
+	/**
+	 * Returns the transport used by the last {@link #capture}.
+	 */
+	Transport getLastTransport() const {
+		return mLastTransport;
+	}
+
+	/**
+	 * Returns the number of bytes received by the last {@link #capture}.
+	 */
+	long long getLastWireSize() const {
+		return mLastWireSize;
+	}
+
+	/**
+	 * Returns the measured throughput of the link in bytes per second, 0 until a raw capture
+	 * was made.
+	 */
+	double getLinkThroughput() const {
+		return mThroughput;
+	}
+
+private:
+	enum Support {
+		SUPPORT_UNKNOWN, SUPPORT_YES, SUPPORT_NO
+	};
+
+	std::tr1::shared_ptr<Device> mDevice;
+	Transport mTransport;
+	Transport mLastTransport;
+	Support mCompressedSupport;
+
+	/** measured link throughput, in bytes per second. */
+	double mThroughput;
+	/** measured duration of the compressed captures, in microseconds. */
+	double mCompressedDuration;
+	/** size of the last frame, in bytes. */
+	long long mFrameSize;
+	long long mLastWireSize;
+	int mCaptureCount;
+
+	Transport chooseTransport() const;
+
+	bool captureRaw(RawImage& image);
+
+	/**
+	 * @throws Poco::IOException if the stream isn't a gzip compressed screencap.
+	 * @throws AdbCommandRejectedException if the device has no exec service.
+	 * @throws Poco::TimeoutException if screencap doesn't answer.
+	 */
+	bool captureCompressed(RawImage& image);
+
+	/**
+	 * Stops using the compressed transport after its first attempt failed.
+	 * @return false if the failure must be reported instead: the transport was requested, or
+	 *      already worked on this device.
+	 */
+	bool disableCompressed(const std::string& reason);
+
+	/**
+	 * Fills the header of <var>image</var> for a <code>screencap</code> pixel format.
+	 * @return false if the format isn't supported.
+	 */
+	static bool setFormat(RawImage& image, int format);
+
+	void record(long long bytes);
+
+	static double average(double value, double sample);
+};
+
+} /* namespace ddmlib */
+#endif /* SCREENCAPTURE_HPP_ */
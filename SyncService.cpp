@@ -8,10 +8,33 @@
 #include "ddmlib.hpp"
 #include "SyncService.hpp"
 #include "AdbHelper.hpp"
+#include "AdbCommandRejectedException.hpp"
 #include "Log.hpp"
 #include "ArrayHelper.hpp"
 #include "FileListingService.hpp"
 #include "SyncException.hpp"
+#include "Device.hpp"
+#include "CollectingOutputReceiver.hpp"
+#include "NullOutputReceiver.hpp"
+#include "PushManifest.hpp"
+#include "TarArchive.hpp"
+#include "PullJournal.hpp"
+#include <deque>
+#include <Poco\MD5Engine.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+// the file type bits are macros on POSIX, and clash with our own constants.
+#undef S_IFLNK
+#undef S_IFREG
+#undef S_IFBLK
+#undef S_IFDIR
+#undef S_IFCHR
+#undef S_IFIFO
+#endif
 
 namespace ddmlib {
 
@@ -51,11 +74,40 @@ const unsigned int SyncService::S_IFIFO = 0x1000; // type: fifo
  const unsigned int S_IXOTH = 0x0001; // other: execute
  */
 
+// printed after the tar commands, followed by their exit status.
+static const char TAR_STATUS_MARKER[] = "ddmlib-tar-status:";
+
 std::tr1::shared_ptr<NullSyncProgressMonitor> SyncService::sNullSyncProgressMonitor(new NullSyncProgressMonitor);
 
-SyncService::SyncService(const Poco::Net::SocketAddress& address, std::tr1::shared_ptr<Device> device) {
+SyncService::SyncService(const AdbServerAddress& address, std::tr1::shared_ptr<Device> device) {
 	mAddress = address;
 	mDevice = device;
+	mPreallocate = true;
+	mUseSplice = false;
+	mProgressInterval = 100;
+	mPipelineDepth = DEFAULT_PIPELINE_DEPTH;
+	mReplyState = REPLY_COMPLETE;
+	mReplyRemaining = 0;
+	mTransferPriority = TransferScheduler::PRIORITY_NORMAL;
+}
+
+SyncService::ProgressThrottle::ProgressThrottle(ISyncProgressMonitor *monitor, int intervalMs) :
+		mMonitor(monitor), mInterval((Poco::Timestamp::TimeDiff) intervalMs * 1000), mPending(0) {
+}
+
+void SyncService::ProgressThrottle::advance(long long work) {
+	mPending += work;
+	if (mLastUpdate.isElapsed(mInterval)) {
+		flush();
+	}
+}
+
+void SyncService::ProgressThrottle::flush() {
+	if (mPending != 0) {
+		mMonitor->advance(mPending);
+		mPending = 0;
+	}
+	mLastUpdate.update();
 }
 
 SyncService::~SyncService() {
@@ -63,7 +115,7 @@ SyncService::~SyncService() {
 
 bool SyncService::openSync() {
 	try {
-		mChannel = std::tr1::shared_ptr<Poco::Net::StreamSocket>(new Poco::Net::StreamSocket(mAddress));
+		mChannel = mAddress.connect();
 
 		// target a specific device
 		AdbHelper::setDevice(mChannel, mDevice.get());
@@ -129,16 +181,22 @@ void SyncService::pull(const std::vector<std::tr1::shared_ptr<FileListingService
 		throw SyncException(SyncException::TARGET_IS_FILE);
 	}
 
-	// get a FileListingService object
-	std::tr1::shared_ptr<FileListingService> fls(new FileListingService(mDevice));
+	// walk the remote directories once: this creates the local directories, and gives both
+	// the files to pull and the total size.
+	std::vector<PullEntry> files;
+	long long directories = collectPullEntries(entries, localPath, monitor, files);
 
 	// compute the number of file to move
-	int total = getTotalRemoteFileSize(entries, fls);
+	long long total = directories;
+	for (std::vector<PullEntry>::const_iterator file = files.begin(); file != files.end(); ++file) {
+		total += file->size;
+	}
 
 	// start the monitor
 	monitor->start(total);
+	monitor->advance(directories);
 
-	doPull(entries, localPath, fls, monitor);
+	doPullFiles(files, monitor);
 
 	monitor->stop();
 }
@@ -151,10 +209,10 @@ void SyncService::pullFile(std::tr1::shared_ptr<FileListingService::FileEntry> r
 
 void SyncService::pullFile(std::tr1::shared_ptr<FileListingService::FileEntry> remote, const std::string& localFilename,
 		ISyncProgressMonitor* monitor) {
-	int total = remote->getSizeValue();
+	long long total = remote->getSizeValue();
 	monitor->start(total);
 
-	doPullFile(remote->getFullPath(), localFilename, monitor);
+	doPullFile(remote->getFullPath(), localFilename, monitor, total);
 
 	monitor->stop();
 }
@@ -181,6 +239,108 @@ void SyncService::pullFile(const std::string& remoteFilepath, const std::string&
 	monitor->stop();
 }
 
+void SyncService::pullFileResumable(const std::string& remoteFilepath, const std::string& localFilename,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pullFileResumable(remoteFilepath, localFilename, monitor.get());
+}
+
+void SyncService::pullFileResumable(const std::string& remoteFilepath, const std::string& localFilename,
+		ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	FileStat stat;
+	if (statFile(remoteFilepath, stat) == false) {
+		throw SyncException(SyncException::NO_REMOTE_OBJECT);
+	}
+
+	// a journal of another remote file, or of another version of it, is discarded here.
+	PullJournal journal(localFilename, stat);
+
+	monitor->start(0);
+
+	bool resumed = false;
+	if (journal.getChunkCount() > 0 && mDevice) {
+		journal.open(true);
+		monitor->advance(journal.getVerifiedLength());
+		resumed = pullTail(remoteFilepath, stat, journal, monitor, timeOut);
+		if (resumed == false) {
+			Log::w("ddms", "Unable to resume the pull of " + remoteFilepath + ", pulling it again");
+		}
+	}
+
+	if (resumed == false) {
+		journal.open(false);
+		sendRecvRequest(remoteFilepath, timeOut);
+		receiveData(&journal, nullptr, 0, monitor, timeOut);
+	}
+
+	journal.finish();
+
+	monitor->stop();
+}
+
+void SyncService::pullFile(const std::string& remoteFilepath, ISyncDataConsumer* consumer,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pullFile(remoteFilepath, consumer, monitor.get());
+}
+
+void SyncService::pullFile(const std::string& remoteFilepath, ISyncDataConsumer* consumer,
+		ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	// no STAT first: a missing file is reported by the FAIL reply of the RECV request.
+	monitor->start(0);
+
+	sendRecvRequest(remoteFilepath, timeOut);
+	receiveData(consumer, nullptr, 0, monitor, timeOut);
+
+	monitor->stop();
+}
+
+size_t SyncService::pullFile(const std::string& remoteFilepath, unsigned char* buffer, size_t capacity,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	return pullFile(remoteFilepath, buffer, capacity, monitor.get());
+}
+
+size_t SyncService::pullFile(const std::string& remoteFilepath, unsigned char* buffer, size_t capacity,
+		ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	monitor->start(0);
+
+	sendRecvRequest(remoteFilepath, timeOut);
+	size_t size = receiveData(nullptr, buffer, capacity, monitor, timeOut);
+
+	monitor->stop();
+	return size;
+}
+
+void SyncService::pullFiles(const std::vector<std::string>& remoteFilepaths, const std::vector<std::string>& localFilenames,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pullFiles(remoteFilepaths, localFilenames, monitor.get());
+}
+
+void SyncService::pullFiles(const std::vector<std::string>& remoteFilepaths, const std::vector<std::string>& localFilenames,
+		ISyncProgressMonitor* monitor) {
+	if (remoteFilepaths.size() != localFilenames.size()) {
+		throw std::invalid_argument("remote and local file lists have different sizes");
+	}
+
+	std::vector<PullEntry> files(remoteFilepaths.size());
+	for (size_t i = 0; i < remoteFilepaths.size(); ++i) {
+		files[i].remotePath = remoteFilepaths[i];
+		files[i].localPath = localFilenames[i];
+		files[i].size = -1;
+	}
+
+	// the sizes are unknown, as with pullFile(std::string, ...)
+	monitor->start(0);
+
+	doPullFiles(files, monitor);
+
+	monitor->stop();
+}
+
 void SyncService::push(const std::vector<std::string>& local, std::tr1::shared_ptr<FileListingService::FileEntry> remote,
 		std::tr1::shared_ptr<ISyncProgressMonitor> monitor){
 	push(local, remote, monitor.get());
@@ -224,264 +384,1399 @@ void SyncService::pushFile(const std::string& local, const std::string& remote,
 		throw SyncException(SyncException::LOCAL_IS_DIRECTORY);
 	}
 
-	monitor->start((int) f->getSize());
+	monitor->start((long long) f->getSize());
 
 	doPushFile(local, remote, monitor);
 
 	monitor->stop();
 }
 
-int SyncService::getTotalRemoteFileSize(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
-		std::tr1::shared_ptr<FileListingService> fls) {
-	int count = 0;
-	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::const_iterator e = entries.begin(); e != entries.end(); ++e) {
-		int type = (*e)->getType();
-		if (type == FileListingService::TYPE_DIRECTORY) {
-			// get the children
-			std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > children = 
-				fls->getChildren(*e, false, std::tr1::shared_ptr<FileListingService::IListingReceiver>());
-			count += getTotalRemoteFileSize(children, fls) + 1;
-		} else if (type == FileListingService::TYPE_FILE) {
-			count += (*e)->getSizeValue();
-		}
-	}
-
-	return count;
+void SyncService::pushFile(ISyncDataProducer* producer, const std::string& remote, int mode,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pushFile(producer, remote, mode, monitor.get());
 }
 
-unsigned long long SyncService::getTotalLocalFileSize(const std::vector<Poco::File>& files) {
-	unsigned long long count = 0;
+void SyncService::pushFile(ISyncDataProducer* producer, const std::string& remote, int mode,
+		ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
 
-	for (std::vector<Poco::File>::const_iterator f = files.begin(); f != files.end(); ++f) {
-		if ((*f).exists()) {
-			if ((*f).isDirectory()) {
-				std::vector<Poco::File> fl;
-				(*f).list(fl);
-				return getTotalLocalFileSize(fl) + 1;
-			} else if ((*f).isFile()) {
-				count += (*f).getSize();
-			}
-		}
+	monitor->start(0);
+
+	if (mPushManifest) {
+		// the content isn't a local file, there's nothing to record.
+		mPushManifest->forget(remote);
 	}
 
-	return count;
-}
+	sendSendRequest(remote, mode, timeOut);
 
-void SyncService::doPull(std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > entries, const std::string& localPath,
-		std::tr1::shared_ptr<FileListingService> fileListingService, ISyncProgressMonitor* monitor) {
+	if (mBuffer.size() < SYNC_DATA_MAX + 8) {
+		mBuffer.resize(SYNC_DATA_MAX + 8);
+	}
+	std::copy(ID_DATA, ID_DATA + 4, mBuffer.begin());
 
-	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::iterator e = entries.begin(); e != entries.end(); ++e) {
-		// check if we're cancelled
+	while (true) {
+		// check if we're canceled
 		if (monitor->isCanceled() == true) {
 			throw SyncException(SyncException::CANCELED);
 		}
 
-		// get type (we only pull directory and files for now)
-		int type = (*e)->getType();
-		if (type == FileListingService::TYPE_DIRECTORY) {
-			monitor->startSubTask((*e)->getFullPath());
-
-			std::string dest = localPath + Poco::Path::separator() + (*e)->getName();
+		// the producer writes right behind the header, so header and data leave at once.
+		unsigned int count = producer->getData(&mBuffer[8], SYNC_DATA_MAX);
+		if (count == 0) {
+			break;
+		}
+		if (count > SYNC_DATA_MAX) {
+			throw SyncException(SyncException::BUFFER_OVERRUN);
+		}
 
-			// make the directory
-			Poco::File d(dest);
-			d.createDirectory();
+		ArrayHelper::swap32bitsToArray(count, mBuffer, 4);
+		pace(count);
+		AdbHelper::write(mChannel, &mBuffer[0], count + 8, timeOut);
 
-			// then recursively call the content. Since we did a ls command
-			// to get the number of files, we can use the cache
-			std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > children = fileListingService->getChildren(*e, true,
-				std::tr1::shared_ptr<FileListingService::IListingReceiver>());
-			doPull(children, dest, fileListingService, monitor);
-			monitor->advance(1);
-		} else if (type == FileListingService::TYPE_FILE) {
-			monitor->startSubTask((*e)->getFullPath());
-			std::string dest = localPath + Poco::Path::separator() + (*e)->getName();
-			doPullFile((*e)->getFullPath(), dest, monitor);
-		}
+		monitor->advance(count);
 	}
+
+	finishSend((long long) Poco::Timestamp().epochTime(), timeOut);
+
+	monitor->stop();
 }
 
+void SyncService::syncPush(const std::vector<std::string>& local, const std::string& remotePath, int flags,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	syncPush(local, remotePath, flags, monitor.get());
+}
 
-void SyncService::doPullFile(const std::string& remotePath, const std::string& localPath,
+void SyncService::syncPush(const std::vector<std::string>& local, const std::string& remotePath, int flags,
 		ISyncProgressMonitor* monitor) {
-	std::vector<unsigned char> msg;
-	std::vector<unsigned char> pullResult(8);
-
-	int timeOut = DdmPreferences::getTimeOut();
+	// make a list of File from the list of String
+	std::vector<Poco::File> files;
+	for (std::vector<std::string>::const_iterator path = local.begin(); path != local.end(); ++path) {
+		files.push_back(Poco::File(*path));
+	}
 
-	std::vector<unsigned char> remotePathContent(remotePath.size());
-	std::copy(remotePath.begin(), remotePath.end(), remotePathContent.begin());
+	// skipped files are accounted for, so the total is the same as a full push.
+	unsigned long long total = getTotalLocalFileSize(files);
 
-	if (remotePathContent.size() > REMOTE_PATH_MAX_LENGTH) {
-		throw SyncException(SyncException::REMOTE_PATH_LENGTH);
-	}
+	monitor->start(total);
 
-	// create the full request message
-	msg = createFileReq(ID_RECV, remotePathContent);
+	// the destination directory is shared with other content, only the pushed
+	// directories are mirrored.
+	doSyncPush(files, remotePath, flags, false, monitor);
 
-	// and send it.
-	AdbHelper::write(mChannel, msg, -1, timeOut);
+	monitor->stop();
+}
 
-	// read the result, in a byte array containing 2 ints
-	// (id, size)
-	AdbHelper::read(mChannel, pullResult, -1, timeOut);
+bool SyncService::pushFileIfChanged(const std::string& local, const std::string& remote, int flags,
+		std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	return pushFileIfChanged(local, remote, flags, monitor.get());
+}
 
-	// check we have the proper data back
-	if (checkResult(pullResult, ID_DATA) == false && checkResult(pullResult, ID_DONE) == false) {
-		std::string str = readErrorMessage(pullResult, timeOut);
-		throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, str);
+bool SyncService::pushFileIfChanged(const std::string& local, const std::string& remote, int flags,
+		ISyncProgressMonitor* monitor) {
+	Poco::File f(local);
+	if (f.exists() == false) {
+		throw SyncException(SyncException::NO_LOCAL_FILE);
 	}
 
-	// access the destination file
-	Poco::File f(localPath);
+	if (f.isDirectory()) {
+		throw SyncException(SyncException::LOCAL_IS_DIRECTORY);
+	}
 
-	// create the stream to write in the file. We use a new try/catch block to differentiate
-	// between file and network io exceptions.
-	Poco::FileOutputStream fos;
-	try {
-		fos.open(localPath, std::ios::out | std::ios::binary);
-	} catch (Poco::IOException& e) {
-		Log::e("ddms", std::string("Failed to open local file " + f.path() + " for writing, Reason: " + e.what()));
-		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	FileStat stat;
+	if (statFile(remote, stat) && isUnchanged(f, remote, stat, flags)) {
+		return false;
 	}
 
-	// the buffer to read the data
-	std::vector<unsigned char> data(SYNC_DATA_MAX);
+	monitor->start((long long) f.getSize());
 
-	// loop to get data until we're done.
-	while (true) {
-		// check if we're cancelled
-		if (monitor->isCanceled() == true) {
-			throw SyncException(SyncException::CANCELED);
-		}
+	doPushFile(local, remote, monitor);
 
-		// if we're done, we stop the loop
-		if (checkResult(pullResult, ID_DONE)) {
-			break;
-		}
-		if (checkResult(pullResult, ID_DATA) == false) {
-			// hmm there's an error
-			std::string str = readErrorMessage(pullResult, timeOut);
-			throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, str);
-		}
+	monitor->stop();
+	return true;
+}
 
-		unsigned int length = ArrayHelper::swap32bitFromArray(pullResult, 4);
-		if (length > SYNC_DATA_MAX) {
-			// buffer overrun!
-			// error and exit
-			throw SyncException(SyncException::BUFFER_OVERRUN);
-		}
+void SyncService::pushArchive(const std::vector<std::string>& local,
+		std::tr1::shared_ptr<FileListingService::FileEntry> remote, std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pushArchive(local, remote, monitor.get());
+}
+
+void SyncService::pushArchive(const std::vector<std::string>& local,
+		std::tr1::shared_ptr<FileListingService::FileEntry> remote, ISyncProgressMonitor* monitor) {
+	if (remote->isDirectory() == false) {
+		throw SyncException(SyncException::REMOTE_IS_FILE);
+	}
 
-		// now read the length we received
-		AdbHelper::read(mChannel, data, length, timeOut);
+	// make a list of File from the list of String
+	std::vector<Poco::File> files;
+	for (std::vector<std::string>::const_iterator path = local.begin(); path != local.end(); ++path) {
+		files.push_back(Poco::File(*path));
+	}
 
-		// get the header for the next packet.
-		AdbHelper::read(mChannel, pullResult, -1, timeOut);
+	// get the total count of the bytes to transfer
+	unsigned long long total = getTotalLocalFileSize(files);
 
-		// write the content in the file
-		for (unsigned int ix = 0; ix != length; ++ix)
-			fos.put(data[ix]);
-		fos.flush();
+	monitor->start(total);
 
-		monitor->advance(length);
-	}
+	doPushArchive(files, remote->getFullPath(), monitor);
 
-	fos.close();
+	monitor->stop();
 }
 
-void SyncService::doPush(const std::vector<Poco::File>& fileArray, const std::string& remotePath,
-		ISyncProgressMonitor* monitor) {
-	for (std::vector<Poco::File>::const_iterator f = fileArray.begin(); f != fileArray.end(); ++f) {
-		// check if we're canceled
-		if (monitor->isCanceled() == true) {
-			throw SyncException(SyncException::CANCELED);
-		}
-		if ((*f).exists()) {
-			if ((*f).isDirectory()) {
-				// append the name of the directory to the remote path
-				std::string dest = remotePath + "/" + Poco::Path((*f).path()).getFileName(); // $NON-NLS-1S
-				monitor->startSubTask(dest);
-				std::vector<Poco::File> fArray;
-				(*f).list(fArray);
-				doPush(fArray, dest, monitor);
+void SyncService::pullArchive(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, std::tr1::shared_ptr<ISyncProgressMonitor> monitor) {
+	pullArchive(entries, localPath, monitor.get());
+}
 
-				monitor->advance(1);
-			} else if ((*f).isFile()) {
-				// append the name of the file to the remote path
-				std::string remoteFile = remotePath + "/" + Poco::Path((*f).path()).getFileName();
-				monitor->startSubTask(remoteFile);
-				doPushFile((*f).path(), remoteFile, monitor);
-			}
-		}
+void SyncService::pullArchive(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, ISyncProgressMonitor* monitor) {
+	// first we check the destination is a directory and exists
+	Poco::File f(localPath);
+	if (f.exists() == false) {
+		throw SyncException(SyncException::NO_DIR_TARGET);
+	}
+	if (f.isDirectory() == false) {
+		throw SyncException(SyncException::TARGET_IS_FILE);
 	}
-}
 
-void SyncService::doPushFile(const std::string& localPath, const std::string& remotePath,
-		ISyncProgressMonitor* monitor) {
-	Poco::FileInputStream fis;
-	std::vector<unsigned char> msg;
+	// the entries are archived from their parent directory, so the archive holds their names.
+	std::map<std::string, std::vector<std::string> > names;
+	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		std::string fullPath = (*e)->getFullPath();
+		std::string::size_type slash = fullPath.rfind('/');
+		std::string parent = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : fullPath.substr(0, slash));
+		names[parent].push_back((*e)->getName());
+	}
 
-	int timeOut = DdmPreferences::getTimeOut();
+	// the LIST walk is cheap next to the archive itself.
+	monitor->start(getTotalRemoteFileSize(entries));
+
+	for (std::map<std::string, std::vector<std::string> >::const_iterator p = names.begin(); p != names.end(); ++p) {
+		// keep the command lines short enough for old adbd.
+		std::vector<std::string> batch;
+		size_t length = 0;
+		for (std::vector<std::string>::const_iterator n = p->second.begin(); n != p->second.end(); ++n) {
+			if (!batch.empty() && length + n->length() > 1000) {
+				doPullArchive(p->first, batch, localPath, monitor);
+				batch.clear();
+				length = 0;
+			}
+			batch.push_back(*n);
+			length += n->length() + 3;
+		}
+		if (!batch.empty()) {
+			doPullArchive(p->first, batch, localPath, monitor);
+		}
+	}
 
-	std::vector<unsigned char> remotePathContent(remotePath.size());
-	std::copy(remotePath.begin(), remotePath.end(), remotePathContent.begin());
+	monitor->stop();
+}
 
-	if (remotePathContent.size() > REMOTE_PATH_MAX_LENGTH) {
+bool SyncService::statFile(const std::string& path, FileStat& stat) {
+	if (path.size() > REMOTE_PATH_MAX_LENGTH) {
 		throw SyncException(SyncException::REMOTE_PATH_LENGTH);
 	}
 
-	Poco::File f(localPath);
+	int timeOut = DdmPreferences::getTimeOut();
 
-	// create the stream to read the file
-	fis.open(f.path(), std::ios::in | std::ios::binary);
+	// create the stat request message.
+	std::vector<unsigned char> msg = createFileReq(ID_STAT, path);
 
-	// create the header for the action
-	msg = createSendFileReq(ID_SEND, remotePathContent, 0644);
+	AdbHelper::write(mChannel, msg, -1 /* full length */, timeOut);
 
-	// and send it. We use a custom try/catch block to make the difference between
-	// file and network IO exceptions.
+	// read the result, in a byte array containing 4 ints
+	// (id, mode, size, time)
+	unsigned char statResult[STAT_REPLY_LENGTH];
+	AdbHelper::read(mChannel, statResult, STAT_REPLY_LENGTH, timeOut);
+	parseStatReply(statResult, stat);
+
+	// adb answers with zeroes if the file doesn't exist.
+	return stat.mode != 0;
+}
+
+void SyncService::statFiles(const std::vector<std::string>& paths, std::vector<FileStat>& stats) {
+	// check all the paths first, so that a bad one doesn't leave requests in flight.
+	for (std::vector<std::string>::const_iterator path = paths.begin(); path != paths.end(); ++path) {
+		if (path->size() > REMOTE_PATH_MAX_LENGTH) {
+			throw SyncException(SyncException::REMOTE_PATH_LENGTH);
+		}
+	}
+
+	stats.resize(paths.size());
+	if (paths.empty()) {
+		return;
+	}
+
+	int timeOut = DdmPreferences::getTimeOut();
+
+	std::vector<unsigned char> requests;
+	std::vector<unsigned char> replies(STAT_BATCH_SIZE * STAT_REPLY_LENGTH);
+
+	// the next batch is always sent before the replies of the current one are read. This
+	// bounds what is in flight both ways, so adbd never blocks on its replies while we are
+	// still writing requests.
+	size_t sent = std::min(paths.size(), (size_t) STAT_BATCH_SIZE);
+	sendStatRequests(paths, 0, sent, requests, timeOut);
+	size_t received = 0;
+	while (received < paths.size()) {
+		if (sent < paths.size()) {
+			size_t next = std::min(paths.size() - sent, (size_t) STAT_BATCH_SIZE);
+			sendStatRequests(paths, sent, next, requests, timeOut);
+			sent += next;
+		}
+
+		size_t count = std::min(paths.size() - received, (size_t) STAT_BATCH_SIZE);
+		readStatReplies(&stats[received], count, replies, timeOut);
+		received += count;
+	}
+}
+
+void SyncService::sendStatRequests(const std::vector<std::string>& paths, size_t first, size_t count,
+		std::vector<unsigned char>& buffer, int timeOut) {
+	buffer.clear();
+	for (size_t i = first; i < first + count; ++i) {
+		const std::string& path = paths[i];
+		size_t offset = buffer.size();
+		buffer.resize(offset + 8 + path.size());
+
+		// (id, length, path), as createFileReq.
+		std::copy(ID_STAT, ID_STAT + 4, buffer.begin() + offset);
+		ArrayHelper::swap32bitsToArray((unsigned int) path.size(), buffer, (int) offset + 4);
+		std::copy(path.begin(), path.end(), buffer.begin() + offset + 8);
+	}
+
+	AdbHelper::write(mChannel, &buffer[0], (int) buffer.size(), timeOut);
+}
+
+void SyncService::readStatReplies(FileStat* stats, size_t count, std::vector<unsigned char>& buffer, int timeOut) {
+	AdbHelper::read(mChannel, &buffer[0], (int) (count * STAT_REPLY_LENGTH), timeOut);
+	for (size_t i = 0; i < count; ++i) {
+		parseStatReply(&buffer[i * STAT_REPLY_LENGTH], stats[i]);
+	}
+}
+
+void SyncService::parseStatReply(const unsigned char* reply, FileStat& stat) {
+	// check we have the proper data back
+	if (std::equal(ID_STAT, ID_STAT + 4, reply) == false) {
+		throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR);
+	}
+
+	stat.mode = (unsigned int) ArrayHelper::swap32bitFromArray(reply, 4);
+	stat.size = (unsigned int) ArrayHelper::swap32bitFromArray(reply, 8);
+	stat.mtime = (unsigned int) ArrayHelper::swap32bitFromArray(reply, 12);
+}
+
+/**
+ * Sums the sizes of the files of a remote tree. Directories have a weight of 1.
+ */
+class SyncService::SizeCounter: public SyncService::IDirectoryVisitor {
+public:
+	SizeCounter() :
+			mTotal(0) {
+	}
+
+	bool visit(const std::string& /*parentPath*/, const DirEntry& entry) {
+		int type = getFileType(entry.stat.mode);
+		if (type == FileListingService::TYPE_DIRECTORY) {
+			mTotal += 1;
+			return true;
+		}
+		if (type == FileListingService::TYPE_FILE) {
+			mTotal += entry.stat.size;
+		}
+		return false;
+	}
+
+	long long getTotal() const {
+		return mTotal;
+	}
+
+private:
+	long long mTotal;
+};
+
+/**
+ * Creates the local directories of a remote tree, and lists its files.
+ */
+class SyncService::PullCollector: public SyncService::IDirectoryVisitor {
+public:
+	PullCollector(const std::string& remoteRoot, const std::string& localRoot, ISyncProgressMonitor* monitor,
+			std::vector<PullEntry>& files) :
+			mRemoteRoot(remoteRoot), mLocalRoot(localRoot), mMonitor(monitor), mFiles(files), mDirectories(0) {
+	}
+
+	bool visit(const std::string& parentPath, const DirEntry& entry) {
+		// check if we're cancelled
+		if (mMonitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+
+		std::string dest = getLocalPath(parentPath) + Poco::Path::separator() + entry.name;
+		int type = getFileType(entry.stat.mode);
+		if (type == FileListingService::TYPE_DIRECTORY) {
+			Poco::File d(dest);
+			d.createDirectory();
+			++mDirectories;
+			return true;
+		}
+		if (type == FileListingService::TYPE_FILE) {
+			PullEntry file;
+			file.remotePath = parentPath + "/" + entry.name;
+			file.localPath = dest;
+			file.size = entry.stat.size;
+			mFiles.push_back(file);
+		}
+		return false;
+	}
+
+	long long getDirectoryCount() const {
+		return mDirectories;
+	}
+
+private:
+	std::string mRemoteRoot;
+	std::string mLocalRoot;
+	ISyncProgressMonitor* mMonitor;
+	std::vector<PullEntry>& mFiles;
+	long long mDirectories;
+
+	std::string getLocalPath(const std::string& parentPath) const {
+		// the path below the root, with the local separator.
+		std::string relative = parentPath.substr(std::min(mRemoteRoot.length(), parentPath.length()));
+		if (!relative.empty() && relative[0] != '/') {
+			relative = "/" + relative;
+		}
+		std::replace(relative.begin(), relative.end(), '/', Poco::Path::separator());
+		return mLocalRoot + relative;
+	}
+};
+
+long long SyncService::getTotalRemoteFileSize(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries) {
+	long long count = 0;
+	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		int type = (*e)->getType();
+		if (type == FileListingService::TYPE_DIRECTORY) {
+			SizeCounter counter;
+			walk((*e)->getFullPath(), &counter);
+			count += counter.getTotal() + 1;
+		} else if (type == FileListingService::TYPE_FILE) {
+			count += (*e)->getSizeValue();
+		}
+	}
+
+	return count;
+}
+
+unsigned long long SyncService::getTotalLocalFileSize(const std::vector<Poco::File>& files) {
+	unsigned long long count = 0;
+
+	for (std::vector<Poco::File>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		if ((*f).exists()) {
+			if ((*f).isDirectory()) {
+				std::vector<Poco::File> fl;
+				(*f).list(fl);
+				return getTotalLocalFileSize(fl) + 1;
+			} else if ((*f).isFile()) {
+				count += (*f).getSize();
+			}
+		}
+	}
+
+	return count;
+}
+
+long long SyncService::collectPullEntries(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+		const std::string& localPath, ISyncProgressMonitor* monitor, std::vector<PullEntry>& files) {
+	long long directories = 0;
+	for (std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+		// check if we're cancelled
+		if (monitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+
+		// get type (we only pull directory and files for now)
+		int type = (*e)->getType();
+		if (type == FileListingService::TYPE_DIRECTORY) {
+			monitor->startSubTask((*e)->getFullPath());
+
+			std::string dest = localPath + Poco::Path::separator() + (*e)->getName();
+
+			// make the directory
+			Poco::File d(dest);
+			d.createDirectory();
+
+			// then the content, walked with pipelined LIST requests.
+			PullCollector collector((*e)->getFullPath(), dest, monitor, files);
+			walk((*e)->getFullPath(), &collector);
+			directories += collector.getDirectoryCount() + 1;
+		} else if (type == FileListingService::TYPE_FILE) {
+			PullEntry file;
+			file.remotePath = (*e)->getFullPath();
+			file.localPath = localPath + Poco::Path::separator() + (*e)->getName();
+			file.size = (*e)->getSizeValue();
+			files.push_back(file);
+		}
+	}
+	return directories;
+}
+
+void SyncService::doPullFiles(const std::vector<PullEntry>& files, ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	// adb serves the requests of a sync connection in order, so we can keep several RECV
+	// requests in flight and read the replies one file after the other: each file ends
+	// with DONE (or FAIL, which aborts the pull as before).
+	size_t depth = mPipelineDepth > 0 ? mPipelineDepth : 1;
+	size_t sent = 0;
+	size_t received = 0;
+	bool receiving = false;
+	mReplyState = REPLY_COMPLETE;
+	try {
+		for (; received < files.size(); ++received) {
+			receiving = false;
+			while (sent < files.size() && sent < received + depth) {
+				sendRecvRequest(files[sent].remotePath, timeOut);
+				++sent;
+			}
+
+			// check if we're cancelled
+			if (monitor->isCanceled() == true) {
+				throw SyncException(SyncException::CANCELED);
+			}
+
+			monitor->startSubTask(files[received].remotePath);
+			receiving = true;
+			receiveFile(files[received].localPath, monitor, files[received].size, timeOut);
+		}
+	} catch (...) {
+		// the replies of the requests already sent would be read by the next request.
+		drainReplies(sent - received - (receiving ? 1 : 0), timeOut);
+		throw;
+	}
+}
+
+void SyncService::sendRecvRequest(const std::string& remotePath, int timeOut) {
+	std::vector<unsigned char> remotePathContent(remotePath.size());
+	std::copy(remotePath.begin(), remotePath.end(), remotePathContent.begin());
+
+	if (remotePathContent.size() > REMOTE_PATH_MAX_LENGTH) {
+		throw SyncException(SyncException::REMOTE_PATH_LENGTH);
+	}
+
+	// create the full request message
+	std::vector<unsigned char> msg = createFileReq(ID_RECV, remotePathContent);
+
+	// and send it. A request written in part leaves the connection unusable.
+	ReplyState state = mReplyState;
+	mReplyState = REPLY_BROKEN;
 	AdbHelper::write(mChannel, msg, -1, timeOut);
+	mReplyState = state;
+}
 
-	// create the buffer used to read.
-	// we read max SYNC_DATA_MAX, but we need 2 4 bytes at the beginning.
-	if (mBuffer.empty()) {
+
+void SyncService::doPullFile(const std::string& remotePath, const std::string& localPath,
+		ISyncProgressMonitor* monitor, long long sizeHint) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	sendRecvRequest(remotePath, timeOut);
+	mReplyState = REPLY_COMPLETE;
+	try {
+		receiveFile(localPath, monitor, sizeHint, timeOut);
+	} catch (...) {
+		drainReplies(0, timeOut);
+		throw;
+	}
+}
+
+void SyncService::setReplyHeader(const std::vector<unsigned char>& header) {
+	if (checkResult(header, ID_DONE)) {
+		mReplyState = REPLY_COMPLETE;
+	} else if (checkResult(header, ID_DATA)) {
+		mReplyRemaining = ArrayHelper::swap32bitFromArray(header, 4);
+		mReplyState = mReplyRemaining <= SYNC_DATA_MAX ? REPLY_IN_DATA : REPLY_BROKEN;
+	} else {
+		// a FAIL message is complete once read, anything else can't be skipped.
+		mReplyState = REPLY_BROKEN;
+	}
+}
+
+void SyncService::drainReplies(size_t pending, int timeOut) {
+	if (mChannel == nullptr) {
+		return;
+	}
+
+	try {
+		if (mBuffer.size() < SYNC_DATA_MAX + 8) {
+			mBuffer.resize(SYNC_DATA_MAX + 8);
+		}
+		std::vector<unsigned char> header(8);
+		while (true) {
+			if (mReplyState == REPLY_BROKEN) {
+				throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR);
+			}
+			if (mReplyState == REPLY_IN_DATA) {
+				AdbHelper::read(mChannel, &mBuffer[0], mReplyRemaining, timeOut);
+				mReplyState = REPLY_AT_HEADER;
+				continue;
+			}
+			if (mReplyState == REPLY_COMPLETE) {
+				if (pending == 0) {
+					return;
+				}
+				--pending;
+				mReplyState = REPLY_AT_HEADER;
+			}
+
+			mReplyState = REPLY_BROKEN;
+			AdbHelper::read(mChannel, &header[0], 8, timeOut);
+			setReplyHeader(header);
+			if (checkResult(header, ID_FAIL)) {
+				readErrorMessage(header, timeOut);
+				mReplyState = REPLY_COMPLETE;
+			}
+		}
+	} catch (std::exception& e) {
+		// the next request would read what is left: better have it fail on a closed connection.
+		Log::w("ddms", "Unable to resynchronize the sync connection, closing it: " + std::string(e.what()));
+		try {
+			mChannel->close();
+		} catch (Poco::Exception& e2) {
+			// we're rethrowing the original failure anyway.
+		}
+	}
+}
+
+void SyncService::receiveFile(const std::string& localPath, ISyncProgressMonitor* monitor, long long sizeHint,
+		int timeOut) {
+	std::vector<unsigned char> pullResult(8);
+
+	// read the result, in a byte array containing 2 ints
+	// (id, size)
+	mReplyState = REPLY_BROKEN;
+	AdbHelper::read(mChannel, &pullResult[0], 8, timeOut);
+	setReplyHeader(pullResult);
+
+	// check we have the proper data back
+	if (checkResult(pullResult, ID_DATA) == false && checkResult(pullResult, ID_DONE) == false) {
+		std::string str = readErrorMessage(pullResult, timeOut);
+		if (checkResult(pullResult, ID_FAIL)) {
+			mReplyState = REPLY_COMPLETE;
+		}
+		throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, str);
+	}
+
+	// access the destination file
+	Poco::File f(localPath);
+
+	// create the file to write in. We use a new try/catch block to differentiate
+	// between file and network io exceptions.
+#ifndef _WIN32
+	int fd = ::open(localPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		Log::e("ddms", std::string("Failed to open local file " + f.path() + " for writing, Reason: " + strerror(errno)));
+		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	}
+#ifdef __linux__
+	if (mPreallocate && sizeHint > 0) {
+		// reserve the blocks without changing the file size, so an interrupted pull doesn't
+		// leave a file of the full size behind. Failure only means no preallocation.
+		::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t) sizeHint);
+	}
+
+	// the pipe used to splice the data from the socket to the file.
+	int pipeFds[2] = { -1, -1 };
+	if (mUseSplice && ::pipe(pipeFds) != 0) {
+		pipeFds[0] = pipeFds[1] = -1;
+	}
+#endif
+#else
+	Poco::FileOutputStream fos;
+	try {
+		fos.open(localPath, std::ios::out | std::ios::binary);
+	} catch (Poco::IOException& e) {
+		Log::e("ddms", std::string("Failed to open local file " + f.path() + " for writing, Reason: " + e.what()));
+		throw SyncException(SyncException::FILE_WRITE_ERROR);
+	}
+#endif
+
+	// the buffer to read the data
+	if (mBuffer.size() < SYNC_DATA_MAX + 8) {
 		mBuffer.resize(SYNC_DATA_MAX + 8);
 	}
-	std::copy(ID_DATA, ID_DATA + 4, mBuffer.begin());
 
-	// look while there is something to read
-	while (!fis.eof()) {
+	ProgressThrottle progress(monitor, mProgressInterval);
+
+	try {
+		// loop to get data until we're done.
+		while (true) {
+			// check if we're cancelled
+			if (monitor->isCanceled() == true) {
+				throw SyncException(SyncException::CANCELED);
+			}
+
+			// if we're done, we stop the loop
+			if (checkResult(pullResult, ID_DONE)) {
+				break;
+			}
+			if (checkResult(pullResult, ID_DATA) == false) {
+				// hmm there's an error
+				std::string str = readErrorMessage(pullResult, timeOut);
+				if (checkResult(pullResult, ID_FAIL)) {
+					mReplyState = REPLY_COMPLETE;
+				}
+				throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, str);
+			}
+
+			unsigned int length = ArrayHelper::swap32bitFromArray(pullResult, 4);
+			if (length > SYNC_DATA_MAX) {
+				// buffer overrun!
+				// error and exit
+				throw SyncException(SyncException::BUFFER_OVERRUN);
+			}
+
+			// not reading the chunk yet holds the device back too.
+			pace(length);
+
+			// a failure while the chunk is read leaves an unknown part of it behind.
+			mReplyState = REPLY_BROKEN;
+#ifdef __linux__
+			if (pipeFds[0] != -1) {
+				// move the chunk from the socket to the file through the pipe.
+				spliceToFile(pipeFds, fd, length, timeOut);
+				mReplyState = REPLY_AT_HEADER;
+			} else
+#endif
+			{
+				// now read the length we received, and write it in the file at once
+				AdbHelper::read(mChannel, &mBuffer[0], length, timeOut);
+				mReplyState = REPLY_AT_HEADER;
+#ifndef _WIN32
+				writeFully(fd, &mBuffer[0], length);
+#else
+				fos.write(reinterpret_cast<const char*>(&mBuffer[0]), length);
+				if (!fos.good()) {
+					throw SyncException(SyncException::FILE_WRITE_ERROR);
+				}
+#endif
+			}
+
+			// get the header for the next packet.
+			mReplyState = REPLY_BROKEN;
+			AdbHelper::read(mChannel, &pullResult[0], 8, timeOut);
+			setReplyHeader(pullResult);
+
+			progress.advance(length);
+		}
+		mReplyState = REPLY_COMPLETE;
+		progress.flush();
+	} catch (...) {
+#ifndef _WIN32
+		::close(fd);
+#ifdef __linux__
+		if (pipeFds[0] != -1) {
+			::close(pipeFds[0]);
+			::close(pipeFds[1]);
+		}
+#endif
+#endif
+		throw;
+	}
+
+#ifndef _WIN32
+	::close(fd);
+#ifdef __linux__
+	if (pipeFds[0] != -1) {
+		::close(pipeFds[0]);
+		::close(pipeFds[1]);
+	}
+#endif
+#else
+	fos.close();
+#endif
+}
+
+size_t SyncService::receiveData(ISyncDataConsumer* consumer, unsigned char* buffer, size_t capacity,
+		ISyncProgressMonitor* monitor, int timeOut) {
+	std::vector<unsigned char> header(8);
+
+	if (buffer == nullptr && mBuffer.size() < SYNC_DATA_MAX + 8) {
+		mBuffer.resize(SYNC_DATA_MAX + 8);
+	}
+
+	ProgressThrottle progress(monitor, mProgressInterval);
+
+	size_t received = 0;
+	while (true) {
+		// read the header of the next packet: (id, size)
+		AdbHelper::read(mChannel, &header[0], (int) header.size(), timeOut);
+
+		// if we're done, we stop the loop
+		if (checkResult(header, ID_DONE)) {
+			break;
+		}
+		if (checkResult(header, ID_DATA) == false) {
+			std::string str = readErrorMessage(header, timeOut);
+			throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, str);
+		}
+
+		unsigned int length = ArrayHelper::swap32bitFromArray(header, 4);
+		if (length > SYNC_DATA_MAX) {
+			throw SyncException(SyncException::BUFFER_OVERRUN);
+		}
+
+		pace(length);
+
+		if (buffer != nullptr) {
+			if (length > capacity - received) {
+				throw SyncException(SyncException::BUFFER_OVERRUN);
+			}
+			// straight into the caller's buffer.
+			AdbHelper::read(mChannel, buffer + received, (int) length, timeOut);
+		} else {
+			AdbHelper::read(mChannel, &mBuffer[0], (int) length, timeOut);
+			consumer->addData(&mBuffer[0], length);
+		}
+
+		received += length;
+		progress.advance(length);
+
+		// check if we're cancelled
+		if (monitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+	}
+	progress.flush();
+
+	return received;
+}
+
+/**
+ * Checks the overlap fetched again by a resumed pull, and appends the rest to the journal.
+ */
+class SyncService::TailReceiver: public IRawOutputReceiver {
+public:
+	TailReceiver(PullJournal& journal, const std::string& overlapHash, ISyncProgressMonitor* monitor) :
+			mJournal(journal), mOverlapHash(overlapHash), mMonitor(monitor), mOverlap(journal.getChunkSize()),
+			mMismatch(false) {
+	}
+
+	void addOutput(const unsigned char* data, unsigned int length) {
+		if (mMismatch) {
+			return;
+		}
+
+		if (mOverlap > 0) {
+			unsigned int count = std::min(length, mOverlap);
+			mOverlapMd5.update(data, count);
+			mOverlap -= count;
+			data += count;
+			length -= count;
+			if (mOverlap > 0) {
+				return;
+			}
+			if (Poco::DigestEngine::digestToHex(mOverlapMd5.digest()) != mOverlapHash) {
+				mMismatch = true;
+				return;
+			}
+		}
+
+		if (length > 0) {
+			mJournal.addData(data, length);
+			mMonitor->advance(length);
+		}
+	}
+
+	void done() {
+	}
+
+	bool isCancelled() {
+		return mMismatch || mMonitor->isCanceled();
+	}
+
+	bool isMismatch() const {
+		return mMismatch;
+	}
+
+	/**
+	 * Returns whether the whole overlap was received and matched.
+	 */
+	bool isVerified() const {
+		return mOverlap == 0 && mMismatch == false;
+	}
+
+private:
+	PullJournal& mJournal;
+	std::string mOverlapHash;
+	ISyncProgressMonitor* mMonitor;
+	Poco::MD5Engine mOverlapMd5;
+	unsigned int mOverlap;
+	bool mMismatch;
+};
+
+bool SyncService::pullTail(const std::string& remotePath, const FileStat& stat, PullJournal& journal,
+		ISyncProgressMonitor* monitor, int timeOut) {
+	// the tail starts with the last verified chunk, which must still match its checksum. The
+	// blocks of dd are the chunks, so any dd can skip to it.
+	size_t overlapChunk = journal.getChunkCount() - 1;
+	std::string command = "exec 2>/dev/null; dd if=" + quoteShellArgument(remotePath) + " bs="
+			+ Poco::NumberFormatter::format(journal.getChunkSize()) + " skip=" + Poco::NumberFormatter::format(overlapChunk);
+
+	// without exec on the device, the file is pulled again as a whole. I/O errors and timeouts
+	// are thrown: the verified chunks are kept for the next attempt.
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> chan;
+	try {
+		chan = mDevice->openExecChannel(command);
+	} catch (AdbCommandRejectedException& e) {
+		Log::d("ddms", "exec of dd rejected: " + std::string(e.what()));
+		return false;
+	}
+
+	TailReceiver receiver(journal, journal.getChunkHash(overlapChunk), monitor);
+	bool complete = AdbHelper::pumpRawOutput(chan, &receiver, timeOut);
+	if (receiver.isMismatch()) {
+		Log::d("ddms", "The start of " + remotePath + " changed");
+		return false;
+	}
+	if (complete == false) {
+		if (monitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+		throw Poco::TimeoutException("Timeout receiving the tail of " + remotePath);
+	}
+	if (receiver.isVerified() == false) {
+		// the file is shorter than the verified chunks now.
+		return false;
+	}
+
+	// the sync protocol only gives the low 32 bits of the size.
+	if ((unsigned int) journal.getLength() != stat.size) {
+		std::string message("incomplete tail of " + remotePath);
+		throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, message);
+	}
+	return true;
+}
+
+#ifndef _WIN32
+void SyncService::writeFully(int fd, const unsigned char* data, unsigned int length) {
+	unsigned int written = 0;
+	while (written < length) {
+		ssize_t count = ::write(fd, data + written, length - written);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			Log::e("ddms", std::string("Failed to write local file, Reason: ") + strerror(errno));
+			throw SyncException(SyncException::FILE_WRITE_ERROR);
+		}
+		written += count;
+	}
+}
+#endif
+
+#ifdef __linux__
+void SyncService::spliceToFile(int pipeFds[2], int fd, unsigned int length, int timeOut) {
+	mChannel->setReceiveTimeout(Poco::Timespan(timeOut * 1000));
+	int sockfd = mChannel->impl()->sockfd();
+
+	unsigned int remaining = length;
+	while (remaining > 0) {
+		ssize_t inPipe = ::splice(sockfd, NULL, pipeFds[1], NULL, remaining, SPLICE_F_MOVE);
+		if (inPipe < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				throw Poco::TimeoutException("read: timeout");
+			}
+			throw Poco::IOException(std::string("splice: ") + strerror(errno));
+		}
+		if (inPipe == 0) {
+			throw Poco::IOException("channel EOF");
+		}
+		remaining -= inPipe;
+
+		// drain the pipe into the file
+		while (inPipe > 0) {
+			ssize_t out = ::splice(pipeFds[0], NULL, fd, NULL, inPipe, SPLICE_F_MOVE);
+			if (out < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				Log::e("ddms", std::string("Failed to write local file, Reason: ") + strerror(errno));
+				throw SyncException(SyncException::FILE_WRITE_ERROR);
+			}
+			inPipe -= out;
+		}
+	}
+}
+#endif
+
+void SyncService::doPush(const std::vector<Poco::File>& fileArray, const std::string& remotePath,
+		ISyncProgressMonitor* monitor) {
+	for (std::vector<Poco::File>::const_iterator f = fileArray.begin(); f != fileArray.end(); ++f) {
+		// check if we're canceled
+		if (monitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+		if ((*f).exists()) {
+			if ((*f).isDirectory()) {
+				// append the name of the directory to the remote path
+				std::string dest = remotePath + "/" + Poco::Path((*f).path()).getFileName(); // $NON-NLS-1S
+				monitor->startSubTask(dest);
+				std::vector<Poco::File> fArray;
+				(*f).list(fArray);
+				doPush(fArray, dest, monitor);
+
+				monitor->advance(1);
+			} else if ((*f).isFile()) {
+				// append the name of the file to the remote path
+				std::string remoteFile = remotePath + "/" + Poco::Path((*f).path()).getFileName();
+				monitor->startSubTask(remoteFile);
+				doPushFile((*f).path(), remoteFile, monitor);
+			}
+		}
+	}
+}
+
+void SyncService::doSyncPush(const std::vector<Poco::File>& fileArray, const std::string& remotePath, int flags,
+		bool mirror, ISyncProgressMonitor* monitor) {
+	// one LIST gives the attributes of all the remote entries of the directory.
+	std::vector<DirEntry> listing;
+	listDirectory(remotePath, listing);
+	std::map<std::string, FileStat> remoteEntries;
+	for (std::vector<DirEntry>::const_iterator e = listing.begin(); e != listing.end(); ++e) {
+		remoteEntries[e->name] = e->stat;
+	}
+
+	for (std::vector<Poco::File>::const_iterator f = fileArray.begin(); f != fileArray.end(); ++f) {
 		// check if we're canceled
 		if (monitor->isCanceled() == true) {
 			throw SyncException(SyncException::CANCELED);
 		}
+		if ((*f).exists() == false) {
+			continue;
+		}
+
+		std::string name = Poco::Path((*f).path()).getFileName();
+		std::map<std::string, FileStat>::iterator remote = remoteEntries.find(name);
+
+		if ((*f).isDirectory()) {
+			// append the name of the directory to the remote path
+			std::string dest = remotePath + "/" + name; // $NON-NLS-1S
+			monitor->startSubTask(dest);
+			std::vector<Poco::File> fArray;
+			(*f).list(fArray);
+			doSyncPush(fArray, dest, flags, (flags & SYNC_DELETE_EXTRA) != 0, monitor);
+
+			monitor->advance(1);
+		} else if ((*f).isFile()) {
+			// append the name of the file to the remote path
+			std::string remoteFile = remotePath + "/" + name;
+			if (remote != remoteEntries.end() && isUnchanged(*f, remoteFile, remote->second, flags)) {
+				monitor->advance((long long) (*f).getSize());
+			} else {
+				monitor->startSubTask(remoteFile);
+				doPushFile((*f).path(), remoteFile, monitor);
+			}
+		}
 
-		// read up to SYNC_DATA_MAX
-		unsigned int readCount = 0;
-		while (readCount + 8 < SYNC_DATA_MAX) {
-			mBuffer[8 + readCount] = fis.get();
-			if (!fis.eof())
-				++readCount;
-			else
+		if (remote != remoteEntries.end()) {
+			remoteEntries.erase(remote);
+		}
+	}
+
+	if (mirror && !remoteEntries.empty()) {
+		std::vector<std::string> extra;
+		for (std::map<std::string, FileStat>::const_iterator e = remoteEntries.begin(); e != remoteEntries.end(); ++e) {
+			extra.push_back(e->first);
+		}
+		removeRemoteEntries(remotePath, extra);
+	}
+}
+
+bool SyncService::isUnchanged(const Poco::File& local, const std::string& remotePath, const FileStat& remote,
+		int flags) {
+	if (getFileType(remote.mode) != FileListingService::TYPE_FILE) {
+		return false;
+	}
+
+	// the protocol only carries the low 32 bits of the size.
+	if (remote.size != (unsigned int) local.getSize()) {
+		return false;
+	}
+
+	// doPushFile sets the remote modification time to the local one.
+	if (remote.mtime == (unsigned int) local.getLastModified().epochTime()) {
+		return true;
+	}
+
+	if ((flags & SYNC_COMPARE_HASH) == 0) {
+		return false;
+	}
+
+	std::string remoteMd5 = getRemoteMd5(remotePath);
+	return remoteMd5.empty() == false && remoteMd5 == PushManifest::computeHash(local.path());
+}
+
+void SyncService::sendListRequest(const std::string& path, int timeOut) {
+	if (path.size() > REMOTE_PATH_MAX_LENGTH) {
+		throw SyncException(SyncException::REMOTE_PATH_LENGTH);
+	}
+
+	std::vector<unsigned char> msg = createFileReq(ID_LIST, path);
+	AdbHelper::write(mChannel, msg, -1 /* full length */, timeOut);
+}
+
+void SyncService::readListReply(std::vector<DirEntry>& entries, int timeOut) {
+	// each entry is a DENT header (id, mode, size, time, name length) followed by the
+	// name. The list ends with DONE, and is empty if the directory can't be opened.
+	std::vector<unsigned char> dent(20);
+	while (true) {
+		AdbHelper::read(mChannel, &dent[0], (int) dent.size(), timeOut);
+
+		if (checkResult(dent, ID_DONE)) {
+			break;
+		}
+		if (checkResult(dent, ID_DENT) == false) {
+			throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR);
+		}
+
+		DirEntry entry;
+		entry.stat.mode = (unsigned int) ArrayHelper::swap32bitFromArray(dent, 4);
+		entry.stat.size = (unsigned int) ArrayHelper::swap32bitFromArray(dent, 8);
+		entry.stat.mtime = (unsigned int) ArrayHelper::swap32bitFromArray(dent, 12);
+		unsigned int nameLength = (unsigned int) ArrayHelper::swap32bitFromArray(dent, 16);
+
+		if (nameLength > REMOTE_PATH_MAX_LENGTH) {
+			throw SyncException(SyncException::BUFFER_OVERRUN);
+		}
+
+		entry.name.assign(nameLength, '\0');
+		if (nameLength > 0) {
+			AdbHelper::read(mChannel, reinterpret_cast<unsigned char*>(&entry.name[0]), (int) nameLength, timeOut);
+		}
+
+		if (entry.name != "." && entry.name != "..") {
+			entries.push_back(entry);
+		}
+	}
+}
+
+void SyncService::listDirectory(const std::string& path, std::vector<DirEntry>& entries) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	sendListRequest(path, timeOut);
+	readListReply(entries, timeOut);
+}
+
+void SyncService::walk(const std::string& path, IDirectoryVisitor* visitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+	size_t depth = mPipelineDepth > 0 ? mPipelineDepth : 1;
+
+	// the directories still to list, and the ones whose LIST request is in flight.
+	std::deque<std::string> pending(1, path);
+	std::deque<std::string> sent;
+	std::vector<DirEntry> entries;
+	while (!pending.empty() || !sent.empty()) {
+		while (!pending.empty() && sent.size() < depth) {
+			sendListRequest(pending.front(), timeOut);
+			sent.push_back(pending.front());
+			pending.pop_front();
+		}
+
+		// adb serves the requests in order: this is the reply to the oldest one.
+		std::string parent = sent.front();
+		sent.pop_front();
+		entries.clear();
+		readListReply(entries, timeOut);
+
+		std::string prefix = (!parent.empty() && parent[parent.length() - 1] == '/') ? parent : parent + "/";
+		for (std::vector<DirEntry>::const_iterator e = entries.begin(); e != entries.end(); ++e) {
+			if (visitor->visit(parent, *e) && getFileType(e->stat.mode) == FileListingService::TYPE_DIRECTORY) {
+				pending.push_back(prefix + e->name);
+			}
+		}
+	}
+}
+
+void SyncService::removeRemoteEntries(const std::string& remotePath, const std::vector<std::string>& names) {
+	if (!mDevice) {
+		return;
+	}
+
+	// batch the entries, keeping the command lines short enough for old adbd.
+	std::string command;
+	for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name) {
+		if (mPushManifest) {
+			mPushManifest->forget(remotePath + "/" + *name);
+		}
+
+		std::string arg = " " + quoteShellArgument(remotePath + "/" + *name);
+		if (!command.empty() && command.length() + arg.length() > 1000) {
+			mDevice->executeShellCommand(command, NullOutputReceiver::getReceiver());
+			command.clear();
+		}
+		if (command.empty()) {
+			command = "rm -rf";
+		}
+		command += arg;
+	}
+	if (!command.empty()) {
+		mDevice->executeShellCommand(command, NullOutputReceiver::getReceiver());
+	}
+}
+
+std::string SyncService::getRemoteMd5(const std::string& path) {
+	if (!mDevice) {
+		return "";
+	}
+
+	CollectingOutputReceiver receiver;
+	mDevice->executeShellCommand("md5sum " + quoteShellArgument(path) + " 2>/dev/null", &receiver);
+
+	// the output is "<hash>  <path>"
+	std::string output = Poco::trim(receiver.getOutput());
+	std::string hash = output.substr(0, output.find_first_of(" \t"));
+	if (hash.length() != 32) {
+		return "";
+	}
+	return Poco::toLower(hash);
+}
+
+void SyncService::doPushArchive(const std::vector<Poco::File>& files, const std::string& remotePath,
+		ISyncProgressMonitor* monitor) {
+	if (!mDevice) {
+		throw Poco::IOException("No device to run tar on");
+	}
+
+	int timeOut = DdmPreferences::getTimeOut();
+
+	// tar stops at the end of the archive. Its exit status follows its messages, as a broken
+	// archive doesn't show on the stream itself.
+	std::string command = "cd " + quoteShellArgument(remotePath) + " 2>&1 && tar -xf - 2>&1; echo "
+			+ TAR_STATUS_MARKER + "$?";
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> chan = mDevice->openExecChannel(command);
+
+	TarWriter writer(chan, timeOut, monitor);
+	for (std::vector<Poco::File>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		if ((*f).exists()) {
+			writer.add(*f, Poco::Path((*f).path()).getFileName());
+		}
+	}
+	writer.finish();
+
+	TarOutputCollector output;
+	if (AdbHelper::pumpRawOutput(chan, &output, timeOut) == false) {
+		throw Poco::TimeoutException("Timeout waiting for tar to finish");
+	}
+	checkTarStatus(output.getOutput());
+}
+
+void SyncService::doPullArchive(const std::string& parent, const std::vector<std::string>& names,
+		const std::string& localPath, ISyncProgressMonitor* monitor) {
+	if (!mDevice) {
+		throw Poco::IOException("No device to run tar on");
+	}
+
+	int timeOut = DdmPreferences::getTimeOut();
+
+	// nothing but the archive and the exit status must reach the stream.
+	std::string command = "exec 2>/dev/null; cd " + quoteShellArgument(parent) + " && tar -cf -";
+	for (std::vector<std::string>::const_iterator n = names.begin(); n != names.end(); ++n) {
+		command += " " + quoteShellArgument(*n);
+	}
+	command += std::string("; echo ") + TAR_STATUS_MARKER + "$?";
+
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> chan = mDevice->openExecChannel(command);
+
+	TarReader reader(localPath, monitor);
+	if (AdbHelper::pumpRawOutput(chan, &reader, timeOut) == false) {
+		reader.done();
+		if (monitor->isCanceled() == true) {
+			throw SyncException(SyncException::CANCELED);
+		}
+		throw Poco::TimeoutException("Timeout receiving the archive");
+	}
+
+	checkTarStatus(reader.getTrailer());
+	if (reader.isComplete() == false) {
+		std::string message("truncated archive");
+		throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, message);
+	}
+}
+
+void SyncService::checkTarStatus(const std::string& output) {
+	std::string::size_type marker = output.rfind(TAR_STATUS_MARKER);
+	int status = -1;
+	if (marker != std::string::npos) {
+		Poco::NumberParser::tryParse(Poco::trim(output.substr(marker + sizeof(TAR_STATUS_MARKER) - 1)), status);
+	}
+	if (status == 0) {
+		return;
+	}
+
+	// the messages of tar, without the padding of the archive.
+	std::string message = output.substr(0, marker);
+	message.erase(std::remove(message.begin(), message.end(), '\0'), message.end());
+	message = Poco::trim(message);
+	if (message.empty()) {
+		message = (status < 0) ? "tar was interrupted" : "tar exited with status " + Poco::NumberFormatter::format(status);
+	}
+	Log::e("ddms", "tar: " + message);
+	throw SyncException(SyncException::TRANSFER_PROTOCOL_ERROR, message);
+}
+
+std::string SyncService::quoteShellArgument(const std::string& arg) {
+	return "'" + Poco::replace(arg, std::string("'"), std::string("'\\''")) + "'";
+}
+
+void SyncService::doPushFile(const std::string& localPath, const std::string& remotePath,
+		ISyncProgressMonitor* monitor) {
+	int timeOut = DdmPreferences::getTimeOut();
+
+	Poco::File f(localPath);
+
+	if (mPushManifest) {
+		// the same content was already pushed there since the device booted.
+		if (mPushManifest->isPushed(localPath, remotePath)) {
+			monitor->advance((long long) f.getSize());
+			return;
+		}
+		// the remote file is about to change, whether the push succeeds or not.
+		mPushManifest->forget(remotePath);
+	}
+
+	sendSendRequest(remotePath, 0644, timeOut);
+
+	// create the buffer used to read.
+	// we read max SYNC_DATA_MAX, but we need 2 4 bytes at the beginning.
+	if (mBuffer.size() < SYNC_DATA_MAX + 8) {
+		mBuffer.resize(SYNC_DATA_MAX + 8);
+	}
+	std::copy(ID_DATA, ID_DATA + 4, mBuffer.begin());
+
+	// the manifest needs the hash of what was sent: it's computed while sending, so the file
+	// isn't read again once pushed.
+	Poco::MD5Engine md5;
+	long long sentSize = 0;
+
+	bool sent = false;
+#ifndef _WIN32
+	// send the file regions straight from the file descriptor, so the data doesn't go
+	// through the buffer at all where sendfile is available.
+	int fd = ::open(f.path().c_str(), O_RDONLY);
+	if (fd >= 0) {
+		try {
+			long long fileSize = (long long) f.getSize();
+			long long offset = 0;
+			while (offset < fileSize) {
+				// check if we're canceled
+				if (monitor->isCanceled() == true) {
+					throw SyncException(SyncException::CANCELED);
+				}
+
+				unsigned int length = (unsigned int) std::min(fileSize - offset, (long long) SYNC_DATA_MAX);
+				ArrayHelper::swap32bitsToArray(length, mBuffer, 4);
+				pace(length);
+				AdbHelper::writeFileRegion(mChannel, &mBuffer[0], 8, fd, offset, length, timeOut);
+
+				if (mPushManifest) {
+					// the region was just read for sending, it is still in the page cache.
+					unsigned int hashed = 0;
+					while (hashed < length) {
+						ssize_t count = ::pread(fd, &mBuffer[8], length - hashed, offset + hashed);
+						if (count < 0 && errno == EINTR) {
+							continue;
+						}
+						if (count <= 0) {
+							throw Poco::ReadFileException(localPath);
+						}
+						md5.update(&mBuffer[8], (unsigned int) count);
+						hashed += (unsigned int) count;
+					}
+				}
+
+				offset += length;
+				monitor->advance(length);
+			}
+			sentSize = offset;
+		} catch (...) {
+			::close(fd);
+			throw;
+		}
+		::close(fd);
+		sent = true;
+	}
+#endif
+
+	if (!sent) {
+		// create the stream to read the file
+		Poco::FileInputStream fis(f.path(), std::ios::in | std::ios::binary);
+
+		// look while there is something to read
+		while (true) {
+			// check if we're canceled
+			if (monitor->isCanceled() == true) {
+				throw SyncException(SyncException::CANCELED);
+			}
+
+			// read up to SYNC_DATA_MAX, right behind the header.
+			fis.read(reinterpret_cast<char*>(&mBuffer[8]), SYNC_DATA_MAX);
+			unsigned int readCount = (unsigned int) fis.gcount();
+			if (readCount == 0) {
 				break;
+			}
+
+			// now send the data to the device
+			// first write the amount read
+			ArrayHelper::swap32bitsToArray(readCount, mBuffer, 4);
+
+			// now write it, header and data at once
+			pace(readCount);
+			AdbHelper::write(mChannel, &mBuffer[0], readCount + 8, timeOut);
+			if (mPushManifest) {
+				md5.update(&mBuffer[8], readCount);
+			}
+			sentSize += readCount;
+
+			// and advance the monitor
+			monitor->advance(readCount);
 		}
+		// close the local file
+		fis.close();
+	}
 
-		// now send the data to the device
-		// first write the amount read
-		ArrayHelper::swap32bitsToArray(readCount, mBuffer, 4);
+	// the remote file gets the local modification time, as with adb push, so that syncPush
+	// can tell unchanged files.
+	long long mtime = (long long) f.getLastModified().epochTime();
+	finishSend(mtime, timeOut);
+
+	if (mPushManifest) {
+		PushManifest::Entry entry;
+		entry.hash = Poco::DigestEngine::digestToHex(md5.digest());
+		entry.size = sentSize;
+		entry.mtime = mtime;
+		mPushManifest->record(localPath, remotePath, entry);
+	}
+}
 
-		// now write it
-		AdbHelper::write(mChannel, mBuffer, readCount + 8, timeOut);
+void SyncService::sendSendRequest(const std::string& remotePath, int mode, int timeOut) {
+	std::vector<unsigned char> remotePathContent(remotePath.size());
+	std::copy(remotePath.begin(), remotePath.end(), remotePathContent.begin());
 
-		// and advance the monitor
-		monitor->advance(readCount);
+	if (remotePathContent.size() > REMOTE_PATH_MAX_LENGTH) {
+		throw SyncException(SyncException::REMOTE_PATH_LENGTH);
 	}
-	// close the local file
-	fis.close();
 
-	// create the DONE message
-	long long time = Poco::Timestamp().epochMicroseconds() / 1000000;
-	msg = createReq(ID_DONE, (int) time);
+	// create the header for the action
+	std::vector<unsigned char> msg = createSendFileReq(ID_SEND, remotePathContent, mode);
+
+	// and send it.
+	AdbHelper::write(mChannel, msg, -1, timeOut);
+}
+
+void SyncService::finishSend(long long mtime, int timeOut) {
+	// create the DONE message. It carries the modification time of the remote file.
+	std::vector<unsigned char> msg = createReq(ID_DONE, (int) mtime);
 
 	// and send it.
 	AdbHelper::write(mChannel, msg, -1, timeOut);
@@ -497,6 +1792,12 @@ void SyncService::doPushFile(const std::string& localPath, const std::string& re
 	}
 }
 
+void SyncService::pace(unsigned int length) {
+	if (mTransferScheduler) {
+		mTransferScheduler->acquire(mTransferPriority, length);
+	}
+}
+
 std::string SyncService::readErrorMessage(const std::vector<unsigned char>& result, int timeOut) {
 	if (checkResult(result, ID_FAIL)) {
 
@@ -9,10 +9,15 @@
 #define SYNCSERVICE_HPP_
 #include "ddmlib.hpp"
 #include "FileListingService.hpp"
+#include "AdbServerAddress.hpp"
+#include "TransferScheduler.hpp"
 
 namespace ddmlib {
 
 class Device;
+class PushManifest;
+class PullJournal;
+class FanOutPush;
 
 /**
  * Classes which implement this interface provide methods that deal
@@ -27,7 +32,7 @@ public:
 	 * Sent when the transfer starts
 	 * @param totalWork the total amount of work.
 	 */
-	virtual void start(int totalWork) =0;
+	virtual void start(long long totalWork) =0;
 	/**
 	 * Sent when the transfer is finished or interrupted.
 	 */
@@ -46,7 +51,7 @@ public:
 	 * Sent when some progress have been made.
 	 * @param work the amount of work done.
 	 */
-	virtual void advance(int work) = 0;
+	virtual void advance(long long work) = 0;
 };
 
 /**
@@ -54,13 +59,13 @@ public:
  */
 class DDMLIB_API NullSyncProgressMonitor: public ISyncProgressMonitor {
 public:
-	void advance(int work) {
+	void advance(long long work) {
 	}
 	bool isCanceled() const {
 		return false;
 	}
 
-	void start(int totalWork) {
+	void start(long long totalWork) {
 	}
 	void startSubTask(const std::string &name) {
 	}
@@ -68,7 +73,75 @@ public:
 	}
 };
 
+/**
+ * Classes which implement this interface receive the content of a file pulled into memory.
+ * @see SyncService#pullFile(std::string, ISyncDataConsumer*, ISyncProgressMonitor*)
+ */
+class DDMLIB_API ISyncDataConsumer {
+public:
+	virtual ~ISyncDataConsumer() {
+	}
+
+	/**
+	 * Called for every DATA chunk of the file, in order.
+	 * <p/>Throwing aborts the pull. The sync connection can't be used afterward.
+	 * @param data the chunk. It points into the receive buffer of the sync connection, and is
+	 *      only valid during the call.
+	 * @param length the length of the chunk, at most 64K.
+	 */
+	virtual void addData(const unsigned char* data, unsigned int length) = 0;
+};
+
+/**
+ * Classes which implement this interface provide the content of a file pushed from memory.
+ * @see SyncService#pushFile(ISyncDataProducer*, std::string, int, ISyncProgressMonitor*)
+ */
+class DDMLIB_API ISyncDataProducer {
+public:
+	virtual ~ISyncDataProducer() {
+	}
+
+	/**
+	 * Called for every DATA chunk to send, until it returns 0.
+	 * <p/>Throwing aborts the push. The sync connection can't be used afterward.
+	 * @param buffer where to write the chunk. It is the send buffer of the sync connection,
+	 *      so the chunk is sent as is.
+	 * @param capacity the size of <var>buffer</var>.
+	 * @return the length of the chunk, at most <var>capacity</var>. 0 ends the file.
+	 */
+	virtual unsigned int getData(unsigned char* buffer, unsigned int capacity) = 0;
+};
+
 class DDMLIB_API SyncService {
+	/**
+	 * Forwards the progress to a monitor at most once per interval, so that fast transfers
+	 * don't call it for every 64K chunk.
+	 */
+	class ProgressThrottle {
+		ISyncProgressMonitor *mMonitor;
+		Poco::Timestamp mLastUpdate;
+		Poco::Timestamp::TimeDiff mInterval;
+		long long mPending;
+	public:
+		ProgressThrottle(ISyncProgressMonitor *monitor, int intervalMs);
+
+		void advance(long long work);
+
+		/**
+		 * Reports the work not forwarded yet.
+		 */
+		void flush();
+	};
+
+	/**
+	 * A file to pull: remote path, local destination and expected size (-1 if unknown).
+	 */
+	struct PullEntry {
+		std::string remotePath;
+		std::string localPath;
+		long long size;
+	};
+
 	static unsigned char ID_OKAY[];
 	static unsigned char ID_FAIL[];
 	static unsigned char ID_STAT[];
@@ -107,8 +180,12 @@ class DDMLIB_API SyncService {
 	 */
 	static const unsigned int SYNC_DATA_MAX = 64 * 1024;
 	static const unsigned int REMOTE_PATH_MAX_LENGTH = 1024;
+	/** size of a STAT reply: id, mode, size, time. */
+	static const unsigned int STAT_REPLY_LENGTH = 16;
+	/** number of STAT requests written at once by {@link #statFiles}. */
+	static const unsigned int STAT_BATCH_SIZE = 256;
 
-	Poco::Net::SocketAddress mAddress;
+	AdbServerAddress mAddress;
 	std::tr1::shared_ptr<Device> mDevice;
 	std::tr1::shared_ptr<Poco::Net::StreamSocket> mChannel;
 
@@ -117,14 +194,80 @@ class DDMLIB_API SyncService {
 	 */
 	std::vector<unsigned char> mBuffer;
 
+	bool mPreallocate;
+	bool mUseSplice;
+	int mProgressInterval;
+	int mPipelineDepth;
+
+	/**
+	 * Where the reply read by {@link #receiveFile} stands, so the connection can be brought back
+	 * to the next reply after a failure.
+	 */
+	enum ReplyState {
+		/** the reply was read up to DONE or FAIL. */
+		REPLY_COMPLETE,
+		/** the next bytes are a DATA, DONE or FAIL header of the reply. */
+		REPLY_AT_HEADER,
+		/** a DATA header was read, {@link #mReplyRemaining} bytes of its data were not. */
+		REPLY_IN_DATA,
+		/** the position within the reply is unknown. */
+		REPLY_BROKEN
+	};
+	ReplyState mReplyState;
+	unsigned int mReplyRemaining;
+	std::tr1::shared_ptr<PushManifest> mPushManifest;
+	std::tr1::shared_ptr<TransferScheduler> mTransferScheduler;
+	TransferScheduler::Priority mTransferPriority;
+
 public:
+	/** Default number of RECV requests kept in flight when pulling several files. */
+	static const int DEFAULT_PIPELINE_DEPTH = 8;
+
+	/**
+	 * Attributes of a remote file, as returned by the STAT and LIST sync requests.
+	 * <p/>The sync protocol only carries the low 32 bits of the size.
+	 */
+	struct FileStat {
+		unsigned int mode;
+		unsigned int size;
+		unsigned int mtime;
+	};
+
+	/**
+	 * An entry of a remote directory, as returned by the LIST sync request.
+	 */
+	struct DirEntry {
+		std::string name;
+		FileStat stat;
+	};
+
+	/**
+	 * Classes which implement this interface receive the entries found by {@link #walk}.
+	 */
+	class DDMLIB_API IDirectoryVisitor {
+	public:
+		/**
+		 * Called for every entry of a listed directory ("." and ".." excluded).
+		 * @param parentPath the full path of the directory holding the entry.
+		 * @param entry the entry.
+		 * @return true to list the entry too, if it is a directory.
+		 */
+		virtual bool visit(const std::string& parentPath, const DirEntry& entry) = 0;
+		virtual ~IDirectoryVisitor() {
+		}
+	};
+
+	/** {@link #syncPush} flag: compare the MD5 of files with the same size but another modification time. */
+	static const int SYNC_COMPARE_HASH = 0x01;
+	/** {@link #syncPush} flag: delete the remote entries of the pushed directories which don't exist locally. */
+	static const int SYNC_DELETE_EXTRA = 0x02;
 
 	/**
 	 * Creates a Sync service object.
 	 * @param address The address to connect to
 	 * @param device the {@link Device} that the service connects to.
 	 */
-	SyncService(const Poco::Net::SocketAddress &address, std::tr1::shared_ptr<Device> device);
+	SyncService(const AdbServerAddress &address, std::tr1::shared_ptr<Device> device);
 
 	/**
 	 * Opens the sync connection. This must be called before any calls to push[File] / pull[File].
@@ -136,6 +279,78 @@ public:
 	 */
 	bool openSync();
 
+	/**
+	 * Sets whether the local file of a pull is preallocated when the remote size is known
+	 * (Linux only, uses fallocate(2)). This limits fragmentation when many files are pulled
+	 * at once. Enabled by default.
+	 */
+	void setPreallocate(bool preallocate) {
+		mPreallocate = preallocate;
+	}
+
+	/**
+	 * Sets whether pulled data is moved from the socket to the local file with splice(2),
+	 * without going through user space (Linux only). Disabled by default.
+	 */
+	void setUseSplice(bool useSplice) {
+		mUseSplice = useSplice;
+	}
+
+	/**
+	 * Sets the minimum interval between two {@link ISyncProgressMonitor#advance(long long)} calls
+	 * during a pull, in milliseconds. 0 reports every chunk. Defaults to 100ms.
+	 */
+	void setProgressInterval(int intervalMs) {
+		mProgressInterval = intervalMs;
+	}
+
+	/**
+	 * Sets how many RECV requests are sent ahead when pulling several files over this
+	 * connection. 1 disables pipelining. Defaults to {@link #DEFAULT_PIPELINE_DEPTH}.
+	 */
+	void setPipelineDepth(int depth) {
+		mPipelineDepth = depth;
+	}
+
+	/**
+	 * Sets the manifest of the content already pushed to the device. The pushes of files
+	 * recorded in it are skipped, and every successful push is recorded.
+	 * @param manifest the manifest, or null to always push.
+	 * @see Device#setUsePushManifest(bool)
+	 */
+	void setPushManifest(std::tr1::shared_ptr<PushManifest> manifest) {
+		mPushManifest = manifest;
+	}
+
+	std::tr1::shared_ptr<PushManifest> getPushManifest() const {
+		return mPushManifest;
+	}
+
+	/**
+	 * Sets the scheduler pacing the DATA frames of this connection.
+	 * @param scheduler the scheduler, or null to send and receive as fast as possible.
+	 * @see Device#getTransferScheduler()
+	 */
+	void setTransferScheduler(std::tr1::shared_ptr<TransferScheduler> scheduler) {
+		mTransferScheduler = scheduler;
+	}
+
+	std::tr1::shared_ptr<TransferScheduler> getTransferScheduler() const {
+		return mTransferScheduler;
+	}
+
+	/**
+	 * Sets the priority class of the transfers of this connection. Defaults to
+	 * {@link TransferScheduler#PRIORITY_NORMAL}.
+	 */
+	void setTransferPriority(TransferScheduler::Priority priority) {
+		mTransferPriority = priority;
+	}
+
+	TransferScheduler::Priority getTransferPriority() const {
+		return mTransferPriority;
+	}
+
 	/**
 	 * Closes the connection.
 	 */
@@ -207,6 +422,89 @@ public:
 	void pullFile(const std::string& remoteFilepath, const std::string& localFilename,
 			ISyncProgressMonitor* monitor);
 
+	/**
+	 * Pulls several files, keeping up to {@link #setPipelineDepth(int)} requests in flight so
+	 * that many small files don't cost a round trip each.
+	 * <p/>As with {@link #pullFile(std::string, std::string, ISyncProgressMonitor*)}, the
+	 * sizes are unknown and the {@link ISyncProgressMonitor} will not properly show the progress.
+	 * @param remoteFilepaths the full paths of the remote files
+	 * @param localFilenames the local destinations, in the same order.
+	 * @param monitor The progress monitor. Cannot be null.
+	 *
+	 * @throws IOException in case of an IO exception.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 * @throws SyncException in case of a sync exception. The pull stops at the first failure.
+	 */
+	void pullFiles(const std::vector<std::string>& remoteFilepaths, const std::vector<std::string>& localFilenames,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pullFiles(const std::vector<std::string>& remoteFilepaths, const std::vector<std::string>& localFilenames,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pulls a single file, so that a failed pull can be resumed.
+	 * <p/>The local file is verified by chunks as it is written, and the checksums are kept in
+	 * a journal next to it (see {@link PullJournal}). If a journal of the same remote file is
+	 * found, only the missing tail is fetched, with <code>dd</code> over the binary-clean
+	 * <code>exec:</code> service. The last verified chunk is fetched again and its checksum
+	 * compared, and the pull starts over if it differs or if the device rejects the
+	 * <code>exec:</code> service. The journal is removed once the pull completed.
+	 * <p/>As with {@link #pullFile(std::string, std::string, ISyncProgressMonitor*)}, the size
+	 * is unknown and the {@link ISyncProgressMonitor} will not properly show the progress.
+	 * @param remoteFilepath the full path to the remote file
+	 * @param localFilename The local destination.
+	 * @param monitor The progress monitor. Cannot be null.
+	 *
+	 * @throws IOException in case of an IO exception.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 * @throws SyncException in case of a sync exception. The local file and its journal are
+	 *      kept for the next attempt.
+	 */
+	void pullFileResumable(const std::string& remoteFilepath, const std::string& localFilename,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pullFileResumable(const std::string& remoteFilepath, const std::string& localFilename,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pulls a single file into memory, without a local file: the DATA payloads are passed to
+	 * <var>consumer</var> as they are received.
+	 * <p/>The size of the file is unknown and the {@link ISyncProgressMonitor} will not
+	 * properly show the progress.
+	 * @param remoteFilepath the full path to the remote file
+	 * @param consumer receives the content.
+	 * @param monitor The progress monitor. Cannot be null.
+	 *
+	 * @throws IOException in case of an IO exception.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 * @throws SyncException in case of a sync exception, or if the remote file doesn't exist.
+	 */
+	void pullFile(const std::string& remoteFilepath, ISyncDataConsumer* consumer,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pullFile(const std::string& remoteFilepath, ISyncDataConsumer* consumer, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pulls a single file into a preallocated buffer. The DATA payloads are read from the
+	 * connection straight into the buffer.
+	 * @param remoteFilepath the full path to the remote file
+	 * @param buffer the destination.
+	 * @param capacity the size of <var>buffer</var>. {@link #statFile} gives the size to
+	 *      allocate.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @return the size of the file.
+	 *
+	 * @throws IOException in case of an IO exception.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 * @throws SyncException in case of a sync exception. {@link SyncException#BUFFER_OVERRUN}
+	 *      if the file doesn't fit in the buffer; the connection can't be used afterward.
+	 */
+	size_t pullFile(const std::string& remoteFilepath, unsigned char* buffer, size_t capacity,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	size_t pullFile(const std::string& remoteFilepath, unsigned char* buffer, size_t capacity,
+			ISyncProgressMonitor* monitor);
+
 	/**
 	 * Push several files.
 	 * @param local An array of loca files to push
@@ -236,21 +534,175 @@ public:
 
 	void pushFile(const std::string& local, const std::string& remote, ISyncProgressMonitor* monitor);
 
+	/**
+	 * Pushes a single file generated in memory, without a local file. The producer writes
+	 * each chunk right into the send buffer.
+	 * <p/>The remote file gets the current time as modification time.
+	 * @param producer provides the content.
+	 * @param remote The remote filepath.
+	 * @param mode the permissions of the remote file, e.g. 0644.
+	 * @param monitor The progress monitor. Cannot be null.
+	 *
+	 * @throws SyncException if file could not be pushed
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void pushFile(ISyncDataProducer* producer, const std::string& remote, int mode,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pushFile(ISyncDataProducer* producer, const std::string& remote, int mode, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pushes files and directories (recursively), skipping the files which are already
+	 * up to date on the device.
+	 * <p/>A file is up to date if the remote file has the same size and modification time. With
+	 * {@link #SYNC_COMPARE_HASH}, files with the same size but another modification time are
+	 * compared by MD5 (requires <code>md5sum</code> on the device). The remote directories are
+	 * listed once each, so unchanged trees cost one round trip per directory.
+	 * <p/>With {@link #SYNC_DELETE_EXTRA}, the entries of the pushed directories which don't exist
+	 * locally are removed. The content of <var>remotePath</var> itself is never removed.
+	 * @param local the local files and directories.
+	 * @param remotePath the full path of the remote directory.
+	 * @param flags a combination of {@link #SYNC_COMPARE_HASH} and {@link #SYNC_DELETE_EXTRA}.
+	 * @param monitor The progress monitor. Cannot be null. Skipped files count as transferred.
+	 * @throws SyncException if file could not be pushed
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void syncPush(const std::vector<std::string>& local, const std::string& remotePath, int flags,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void syncPush(const std::vector<std::string>& local, const std::string& remotePath, int flags,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pushes a single file, unless the remote file is already up to date.
+	 * @param local the local filepath.
+	 * @param remote The remote filepath.
+	 * @param flags 0 or {@link #SYNC_COMPARE_HASH}.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @return true if the file was pushed, false if it was up to date.
+	 *
+	 * @throws SyncException if file could not be pushed
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	bool pushFileIfChanged(const std::string& local, const std::string& remote, int flags,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	bool pushFileIfChanged(const std::string& local, const std::string& remote, int flags,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pushes files and directories (recursively) as a single tar archive, extracted on the fly
+	 * by <code>tar</code> on the device.
+	 * <p/>Unlike {@link #push}, this doesn't cost a request per file, which dominates the
+	 * transfer of trees of many small files. The archive is written as the local files are
+	 * read, without temporary files. Requires <code>tar</code> on the device (toybox, busybox).
+	 * @param local An array of local files to push
+	 * @param remote the remote {@link FileEntry} representing a directory.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @throws SyncException if the files could not be pushed, with the output of tar.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void pushArchive(const std::vector<std::string>& local, std::tr1::shared_ptr<FileListingService::FileEntry> remote,
+			std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pushArchive(const std::vector<std::string>& local, std::tr1::shared_ptr<FileListingService::FileEntry> remote,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Pulls file(s) or folder(s) as tar archives created by <code>tar</code> on the device,
+	 * and extracted on the fly. One archive is transferred per remote parent directory.
+	 * @param entries the remote item(s) to pull
+	 * @param localPath The local destination directory. It must exist.
+	 * @param monitor The progress monitor. Cannot be null.
+	 * @throws SyncException if the files could not be pulled.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void pullArchive(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, std::tr1::shared_ptr<ISyncProgressMonitor> monitor);
+
+	void pullArchive(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Lists a remote directory with the LIST sync request, without running a shell command.
+	 * @param path the full path of the remote directory. Nothing is listed if it doesn't
+	 *      exist or can't be read.
+	 * @param entries receives the entries, "." and ".." excluded.
+	 * @throws SyncException if the reply is malformed.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void listDirectory(const std::string& path, std::vector<DirEntry>& entries);
+
+	/**
+	 * Walks a remote tree, breadth first. Up to {@link #setPipelineDepth(int)} LIST requests
+	 * are kept in flight, so deep trees don't cost a round trip per directory.
+	 * @param path the full path of the remote directory to walk.
+	 * @param visitor receives the entries, and selects the directories to descend into.
+	 * @throws SyncException if a reply is malformed.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void walk(const std::string& path, IDirectoryVisitor* visitor);
+
+	/**
+	 * Returns the {@link FileListingService} type of a file mode.
+	 */
+	static int getFileType(int mode);
+
+	/**
+	 * Reads the attributes of a remote file.
+	 * @param path the remote file
+	 * @param stat receives the attributes.
+	 * @return false if the remote file doesn't exist.
+	 * @throws SyncException if the device replied with something else than STAT.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	bool statFile(const std::string& path, FileStat& stat);
+
+	/**
+	 * Reads the attributes of many remote files with pipelined STAT requests.
+	 * <p/>The requests are written in batches, the next batch being sent before the replies
+	 * of the current one are read, so the whole query costs a few round trips instead of
+	 * one per file.
+	 * @param paths the remote files.
+	 * @param stats receives the attributes, in the same order. The mode of a file which
+	 *      doesn't exist is 0.
+	 * @throws SyncException if a path is too long (nothing is sent then), or if the device
+	 *      replied with something else than STAT.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading responses from the device.
+	 */
+	void statFiles(const std::vector<std::string>& paths, std::vector<FileStat>& stats);
+
 public:
 	SyncService();
 	virtual ~SyncService();
 
 private:
+	// streams shared DATA frames through the connection.
+	friend class FanOutPush;
+
+	// visitors of walk().
+	class SizeCounter;
+	class PullCollector;
+
+	// receives the tail of a resumed pull.
+	class TailReceiver;
 
 	/**
 	 * compute the recursive file size of all the files in the list. Folder
-	 * have a weight of 1.
+	 * have a weight of 1. The directories are walked with LIST requests.
 	 * @param entries
-	 * @param fls
 	 * @return
 	 */
-	int getTotalRemoteFileSize(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
-			std::tr1::shared_ptr<FileListingService> fls);
+	long long getTotalRemoteFileSize(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries);
 
 	/**
 	 * compute the recursive file size of all the files in the list. Folder
@@ -261,29 +713,84 @@ private:
 	 */
 	unsigned long long getTotalLocalFileSize(const std::vector<Poco::File>& files);
 	/**
-	 * Pulls multiple files/folders recursively.
+	 * Creates the local directories of a pull, and lists the files to pull. The remote
+	 * directories are walked with LIST requests.
 	 * @param entries The list of entry to pull
 	 * @param localPath the localpath to a directory
-	 * @param fileListingService a FileListingService object to browse through remote directories.
+	 * @param monitor the progress monitor, only used for cancellation.
+	 * @param files receives the files to pull.
+	 * @return the number of directories created.
+	 */
+	long long collectPullEntries(const std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> >& entries,
+			const std::string& localPath, ISyncProgressMonitor* monitor, std::vector<PullEntry>& files);
+
+	/**
+	 * Pulls files with pipelined RECV requests.
+	 * @param files the files to pull.
 	 * @param monitor the progress monitor. Must be started already.
-	 *
-	 * @throws SyncException if file could not be pushed
-	 * @throws IOException in case of I/O error on the connection.
-	 * @throws TimeoutException in case of a timeout reading responses from the device.
 	 */
-	void doPull(std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > entries, const std::string& localPath,
-			std::tr1::shared_ptr<FileListingService> fileListingService, ISyncProgressMonitor* monitor);
+	void doPullFiles(const std::vector<PullEntry>& files, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Sends a RECV request, without waiting for the reply.
+	 */
+	void sendRecvRequest(const std::string& remotePath, int timeOut);
+
+	/**
+	 * Receives the reply of a RECV request into a local file.
+	 * @param localPath the local destination
+	 * @param monitor the monitor. The monitor must be started already.
+	 * @param sizeHint the expected size of the file, or -1 if unknown.
+	 */
+	void receiveFile(const std::string& localPath, ISyncProgressMonitor* monitor, long long sizeHint, int timeOut);
+
+	/**
+	 * Reads and drops the rest of the reply left by a failed {@link #receiveFile}, then the
+	 * replies of <var>pending</var> RECV requests sent after it, so the connection can be used
+	 * again. If that isn't possible the connection is closed.
+	 */
+	void drainReplies(size_t pending, int timeOut);
+
+	/**
+	 * Updates {@link #mReplyState} from a header just read.
+	 */
+	void setReplyHeader(const std::vector<unsigned char>& header);
+
+	/**
+	 * Receives the reply of a RECV request into memory.
+	 * @param consumer receives the chunks, if <var>buffer</var> is null.
+	 * @param buffer the destination, or null.
+	 * @param capacity the size of <var>buffer</var>.
+	 * @param monitor the monitor. The monitor must be started already.
+	 * @return the number of bytes received.
+	 */
+	size_t receiveData(ISyncDataConsumer* consumer, unsigned char* buffer, size_t capacity,
+			ISyncProgressMonitor* monitor, int timeOut);
+
+	/**
+	 * Fetches the part of a remote file following the verified chunks of a journal.
+	 * @param journal the journal, opened for resuming.
+	 * @return false if the last verified chunk doesn't match the remote file anymore, or if
+	 *      the device rejects the exec service.
+	 * @throws SyncException if the tail is incomplete.
+	 * @throws TimeoutException, IOException if the tail transfer fails. The journal keeps
+	 *      the verified chunks.
+	 */
+	bool pullTail(const std::string& remotePath, const FileStat& stat, PullJournal& journal,
+			ISyncProgressMonitor* monitor, int timeOut);
 	/**
 	 * Pulls a remote file
 	 * @param remotePath the remote file (length max is 1024)
 	 * @param localPath the local destination
 	 * @param monitor the monitor. The monitor must be started already.
+	 * @param sizeHint the expected size of the file, or -1 if unknown. Only used to
+	 *      preallocate the local file.
 	 * @throws SyncException if file could not be pushed
 	 * @throws IOException in case of I/O error on the connection.
 	 * @throws TimeoutException in case of a timeout reading responses from the device.
 	 */
 	void doPullFile(const std::string& remotePath, const std::string& localPath,
-			ISyncProgressMonitor* monitor);
+			ISyncProgressMonitor* monitor, long long sizeHint = -1);
 	/**
 	 * Push multiple files
 	 * @param fileArray
@@ -308,6 +815,101 @@ private:
 	 */
 	void doPushFile(const std::string& localPath, const std::string& remotePath,
 			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Starts a push: sends the SEND request. The content must follow as DATA frames.
+	 * @param remotePath the remote file (length max is 1024)
+	 * @param mode the permissions of the remote file.
+	 */
+	void sendSendRequest(const std::string& remotePath, int mode, int timeOut);
+
+	/**
+	 * Ends a push: sends DONE and checks the reply.
+	 * @param mtime the modification time of the remote file, in seconds.
+	 * @throws SyncException if the device refused the file.
+	 */
+	void finishSend(long long mtime, int timeOut);
+	/**
+	 * Push multiple files, skipping the ones which are up to date.
+	 * @param fileArray
+	 * @param remotePath
+	 * @param flags the {@link #syncPush} flags.
+	 * @param mirror true to apply {@link #SYNC_DELETE_EXTRA} to <var>remotePath</var>.
+	 * @param monitor
+	 */
+	void doSyncPush(const std::vector<Poco::File>& fileArray, const std::string& remotePath, int flags,
+			bool mirror, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Returns whether a remote file has the same content as a local one.
+	 */
+	bool isUnchanged(const Poco::File& local, const std::string& remotePath, const FileStat& remote, int flags);
+
+	/**
+	 * Writes a batch of STAT requests at once.
+	 * @param buffer reused from batch to batch.
+	 */
+	void sendStatRequests(const std::vector<std::string>& paths, size_t first, size_t count,
+			std::vector<unsigned char>& buffer, int timeOut);
+
+	/**
+	 * Reads a batch of STAT replies at once, and decodes them in place.
+	 * @param buffer at least <var>count</var> replies long.
+	 */
+	void readStatReplies(FileStat* stats, size_t count, std::vector<unsigned char>& buffer, int timeOut);
+
+	/**
+	 * Decodes a STAT reply.
+	 * @throws SyncException if it isn't a STAT reply.
+	 */
+	static void parseStatReply(const unsigned char* reply, FileStat& stat);
+
+	/**
+	 * Sends a LIST request, without waiting for the reply.
+	 */
+	void sendListRequest(const std::string& path, int timeOut);
+
+	/**
+	 * Reads the reply of a LIST request, up to DONE.
+	 */
+	void readListReply(std::vector<DirEntry>& entries, int timeOut);
+
+	/**
+	 * Removes remote files and directories.
+	 * @param remotePath the remote directory holding the entries.
+	 * @param names the names of the entries.
+	 */
+	void removeRemoteEntries(const std::string& remotePath, const std::vector<std::string>& names);
+
+	/**
+	 * Returns the MD5 of a remote file as lowercase hex, or an empty string if it couldn't be computed.
+	 */
+	std::string getRemoteMd5(const std::string& path);
+
+	/**
+	 * Streams a tar archive of local files to <code>tar</code> on the device.
+	 */
+	void doPushArchive(const std::vector<Poco::File>& files, const std::string& remotePath,
+			ISyncProgressMonitor* monitor);
+
+	/**
+	 * Receives a tar archive of remote files into a local directory.
+	 * @param parent the remote directory holding the files.
+	 * @param names the names of the files in <var>parent</var>.
+	 */
+	void doPullArchive(const std::string& parent, const std::vector<std::string>& names,
+			const std::string& localPath, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Checks the exit status appended to the output of a tar command.
+	 * @throws SyncException if tar failed.
+	 */
+	static void checkTarStatus(const std::string& output);
+
+	/**
+	 * Quotes a string for the device shell.
+	 */
+	static std::string quoteShellArgument(const std::string& arg);
 	/**
 	 * Reads an error message from the opened {@link #mChannel}.
 	 * @param result the current adb result. Must contain both FAIL and the length of the message.
@@ -317,6 +919,31 @@ private:
 	 * @throws IOException
 	 */
 	std::string readErrorMessage(const std::vector<unsigned char>& result, int timeOut);
+
+	/**
+	 * Waits for the {@link TransferScheduler} to let a DATA frame through.
+	 * @param length the length of the frame payload.
+	 */
+	void pace(unsigned int length);
+
+#ifndef _WIN32
+	/**
+	 * Writes a whole buffer to a local file.
+	 * @throws SyncException if the write failed.
+	 */
+	static void writeFully(int fd, const unsigned char* data, unsigned int length);
+#endif
+#ifdef __linux__
+	/**
+	 * Moves <var>length</var> bytes from {@link #mChannel} to a local file with splice(2).
+	 * @param pipeFds the pipe used as intermediate.
+	 * @param fd the local file.
+	 * @throws SyncException if the write failed.
+	 * @throws IOException in case of I/O error on the connection.
+	 * @throws TimeoutException in case of a timeout reading from the device.
+	 */
+	void spliceToFile(int pipeFds[2], int fd, unsigned int length, int timeOut);
+#endif
 	/**
 	 * Returns the mode of the remote file.
 	 * @param path the remote file
@@ -361,7 +988,6 @@ private:
 	 * @return true if the code matches.
 	 */
 	static bool checkResult(std::vector<unsigned char> result, unsigned char* code);
-	static int getFileType(int mode);
 
 };
 
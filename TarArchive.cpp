@@ -0,0 +1,461 @@
+/*
+ * TarArchive.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "TarArchive.hpp"
+#include "SyncService.hpp"
+#include "SyncException.hpp"
+#include "AdbHelper.hpp"
+#include "Log.hpp"
+#include <string.h>
+
+namespace ddmlib {
+
+// offsets of the ustar header fields.
+static const size_t NAME_OFFSET = 0;
+static const size_t NAME_LENGTH = 100;
+static const size_t MODE_OFFSET = 100;
+static const size_t UID_OFFSET = 108;
+static const size_t GID_OFFSET = 116;
+static const size_t SIZE_OFFSET = 124;
+static const size_t MTIME_OFFSET = 136;
+static const size_t CHECKSUM_OFFSET = 148;
+static const size_t TYPE_OFFSET = 156;
+static const size_t MAGIC_OFFSET = 257;
+static const size_t PREFIX_OFFSET = 345;
+static const size_t PREFIX_LENGTH = 155;
+
+static const char USTAR_MAGIC[] = "ustar";
+static const char LONG_NAME_ENTRY[] = "././@LongLink";
+
+static unsigned int computeChecksum(const unsigned char* header) {
+	// the checksum field itself counts as spaces.
+	unsigned int sum = 0;
+	for (size_t i = 0; i < TarArchive::BLOCK_SIZE; ++i) {
+		sum += (i >= CHECKSUM_OFFSET && i < CHECKSUM_OFFSET + 8) ? ' ' : header[i];
+	}
+	return sum;
+}
+
+TarWriter::TarWriter(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, int timeOut, ISyncProgressMonitor* monitor) :
+		mChannel(chan), mTimeOut(timeOut), mMonitor(monitor), mBuffer(BUFFER_SIZE), mUsed(0), mWritten(0), mFileCount(0) {
+}
+
+void TarWriter::add(const Poco::File& file, const std::string& name) {
+	// check if we're canceled
+	if (mMonitor->isCanceled() == true) {
+		throw SyncException(SyncException::CANCELED);
+	}
+
+	if (file.isDirectory()) {
+		mMonitor->startSubTask(name);
+		writeHeader(name + "/", 0, 0755, (long long) file.getLastModified().epochTime(), TarArchive::TYPE_DIRECTORY);
+
+		std::vector<Poco::File> children;
+		file.list(children);
+		for (std::vector<Poco::File>::const_iterator child = children.begin(); child != children.end(); ++child) {
+			add(*child, name + "/" + Poco::Path((*child).path()).getFileName());
+		}
+		mMonitor->advance(1);
+	} else if (file.isFile()) {
+		addFile(file, name);
+	}
+}
+
+void TarWriter::addFile(const Poco::File& file, const std::string& name) {
+	long long size = (long long) file.getSize();
+	writeHeader(name, size, file.canExecute() ? 0755 : 0644, (long long) file.getLastModified().epochTime(),
+			TarArchive::TYPE_FILE);
+
+	Poco::FileInputStream fis(file.path(), std::ios::in | std::ios::binary);
+
+	// read the file straight into the send buffer.
+	long long remaining = size;
+	while (remaining > 0) {
+		if (mUsed == mBuffer.size()) {
+			flush();
+		}
+		size_t length = (size_t) std::min(remaining, (long long) (mBuffer.size() - mUsed));
+		fis.read(reinterpret_cast<char*>(&mBuffer[mUsed]), length);
+		if ((size_t) fis.gcount() != length) {
+			// the file shrank since its header was written, the archive can't be completed.
+			Log::e("ddms", "Failed to read local file " + file.path());
+			throw SyncException(SyncException::FILE_READ_ERROR);
+		}
+		mUsed += length;
+		remaining -= length;
+		mMonitor->advance(length);
+	}
+	padBlock(size);
+	++mFileCount;
+}
+
+void TarWriter::writeHeader(const std::string& name, long long size, int mode, long long mtime, char type) {
+	if (name.length() > NAME_LENGTH) {
+		// the name goes in an entry of its own, before the real one.
+		writeHeader(LONG_NAME_ENTRY, (long long) name.length() + 1, 0644, 0, TarArchive::TYPE_LONG_NAME);
+		append(reinterpret_cast<const unsigned char*>(name.c_str()), name.length() + 1);
+		padBlock((long long) name.length() + 1);
+	}
+
+	unsigned char header[TarArchive::BLOCK_SIZE];
+	memset(header, 0, sizeof(header));
+
+	memcpy(header + NAME_OFFSET, name.data(), std::min(name.length(), NAME_LENGTH));
+	writeNumber(header + MODE_OFFSET, 8, (unsigned long long) mode);
+	writeNumber(header + UID_OFFSET, 8, 0);
+	writeNumber(header + GID_OFFSET, 8, 0);
+	writeNumber(header + SIZE_OFFSET, 12, (unsigned long long) size);
+	writeNumber(header + MTIME_OFFSET, 12, (unsigned long long) (mtime > 0 ? mtime : 0));
+	header[TYPE_OFFSET] = (unsigned char) type;
+	memcpy(header + MAGIC_OFFSET, USTAR_MAGIC, sizeof(USTAR_MAGIC)); // "ustar\0"
+	memcpy(header + MAGIC_OFFSET + 6, "00", 2);
+
+	writeNumber(header + CHECKSUM_OFFSET, 7, computeChecksum(header));
+	header[CHECKSUM_OFFSET + 7] = ' ';
+
+	append(header, sizeof(header));
+}
+
+void TarWriter::finish() {
+	// two empty blocks end the archive, then pad to a full record: tar reads whole records.
+	appendZeros(2 * TarArchive::BLOCK_SIZE);
+	long long total = mWritten + (long long) mUsed;
+	appendZeros((size_t) ((TarArchive::RECORD_SIZE - total % TarArchive::RECORD_SIZE) % TarArchive::RECORD_SIZE));
+	flush();
+}
+
+void TarWriter::append(const unsigned char* data, size_t length) {
+	while (length > 0) {
+		if (mUsed == mBuffer.size()) {
+			flush();
+		}
+		size_t count = std::min(length, mBuffer.size() - mUsed);
+		memcpy(&mBuffer[mUsed], data, count);
+		mUsed += count;
+		data += count;
+		length -= count;
+	}
+}
+
+void TarWriter::appendZeros(size_t length) {
+	while (length > 0) {
+		if (mUsed == mBuffer.size()) {
+			flush();
+		}
+		size_t count = std::min(length, mBuffer.size() - mUsed);
+		memset(&mBuffer[mUsed], 0, count);
+		mUsed += count;
+		length -= count;
+	}
+}
+
+void TarWriter::padBlock(long long size) {
+	appendZeros((size_t) ((TarArchive::BLOCK_SIZE - size % TarArchive::BLOCK_SIZE) % TarArchive::BLOCK_SIZE));
+}
+
+void TarWriter::flush() {
+	if (mUsed > 0) {
+		AdbHelper::write(mChannel, &mBuffer[0], (int) mUsed, mTimeOut);
+		mWritten += mUsed;
+		mUsed = 0;
+	}
+}
+
+void TarWriter::writeNumber(unsigned char* field, size_t width, unsigned long long value) {
+	// octal, zero padded and NUL terminated, if it fits.
+	unsigned long long limit = 1ULL << (3 * (width - 1));
+	if (value < limit) {
+		for (size_t i = width - 1; i > 0; --i) {
+			field[i - 1] = (unsigned char) ('0' + (value & 7));
+			value >>= 3;
+		}
+		field[width - 1] = 0;
+		return;
+	}
+
+	// otherwise the GNU base-256 encoding: big endian, with the high bit of the first byte set.
+	for (size_t i = width; i > 1; --i) {
+		field[i - 1] = (unsigned char) (value & 0xFF);
+		value >>= 8;
+	}
+	field[0] = 0x80;
+}
+
+TarReader::TarReader(const std::string& localPath, ISyncProgressMonitor* monitor) :
+		mLocalPath(localPath), mMonitor(monitor), mState(HEADER), mHeader(TarArchive::BLOCK_SIZE), mHeaderUsed(0),
+		mZeroBlocks(0), mComplete(false), mContent(SKIP), mRemaining(0), mPadding(0), mOutputTime(0), mFileCount(0) {
+}
+
+TarReader::~TarReader() {
+}
+
+bool TarReader::isCancelled() {
+	return mMonitor->isCanceled();
+}
+
+void TarReader::addOutput(const unsigned char* data, unsigned int length) {
+	while (length > 0) {
+		size_t count = 0;
+		switch (mState) {
+		case HEADER:
+			count = std::min((size_t) length, TarArchive::BLOCK_SIZE - mHeaderUsed);
+			memcpy(&mHeader[mHeaderUsed], data, count);
+			mHeaderUsed += count;
+			if (mHeaderUsed == TarArchive::BLOCK_SIZE) {
+				mHeaderUsed = 0;
+				processHeader();
+			}
+			break;
+
+		case DATA:
+			count = (size_t) std::min((long long) length, mRemaining);
+			if (mContent == FILE_CONTENT) {
+				mOutput->write(reinterpret_cast<const char*>(data), count);
+				if (!mOutput->good()) {
+					Log::e("ddms", "Failed to write local file " + mOutputPath);
+					throw SyncException(SyncException::FILE_WRITE_ERROR);
+				}
+				mMonitor->advance(count);
+			} else if (mContent == LONG_NAME || mContent == PAX_HEADER) {
+				mExtendedData.append(reinterpret_cast<const char*>(data), count);
+			}
+			mRemaining -= count;
+			if (mRemaining == 0) {
+				endEntry();
+			}
+			break;
+
+		case PADDING:
+			count = (size_t) std::min((long long) length, mPadding);
+			mPadding -= count;
+			if (mPadding == 0) {
+				mState = HEADER;
+			}
+			break;
+
+		case TRAILER:
+			count = length;
+			addTrailer(data, count);
+			break;
+		}
+		data += count;
+		length -= (unsigned int) count;
+	}
+}
+
+void TarReader::done() {
+	// a partial header is the text of a command which didn't produce an archive.
+	if (mState == HEADER && mHeaderUsed > 0) {
+		addTrailer(&mHeader[0], mHeaderUsed);
+		mHeaderUsed = 0;
+	}
+	if (mOutput) {
+		mOutput->close();
+		mOutput.reset();
+	}
+}
+
+void TarReader::processHeader() {
+	const unsigned char* header = &mHeader[0];
+
+	bool empty = true;
+	for (size_t i = 0; i < TarArchive::BLOCK_SIZE && empty; ++i) {
+		empty = header[i] == 0;
+	}
+	if (empty) {
+		if (++mZeroBlocks == 2) {
+			mComplete = true;
+			mState = TRAILER;
+		}
+		return;
+	}
+	mZeroBlocks = 0;
+
+	if (parseNumber(header + CHECKSUM_OFFSET, 8) != (long long) computeChecksum(header)) {
+		// not an archive (any more).
+		mState = TRAILER;
+		addTrailer(header, TarArchive::BLOCK_SIZE);
+		return;
+	}
+
+	std::string name = parseString(header + NAME_OFFSET, NAME_LENGTH);
+	if (memcmp(header + MAGIC_OFFSET, USTAR_MAGIC, 5) == 0) {
+		std::string prefix = parseString(header + PREFIX_OFFSET, PREFIX_LENGTH);
+		if (!prefix.empty()) {
+			name = prefix + "/" + name;
+		}
+	}
+	if (!mNextName.empty()) {
+		name = mNextName;
+		mNextName.clear();
+	}
+
+	long long size = parseNumber(header + SIZE_OFFSET, 12);
+	char type = (char) header[TYPE_OFFSET];
+
+	mContent = SKIP;
+	mExtendedData.clear();
+	switch (type) {
+	case TarArchive::TYPE_LONG_NAME:
+		mContent = LONG_NAME;
+		break;
+	case TarArchive::TYPE_PAX_HEADER:
+		mContent = PAX_HEADER;
+		break;
+	case TarArchive::TYPE_DIRECTORY: {
+		std::string path = getLocalPath(name);
+		if (!path.empty()) {
+			Poco::File(path).createDirectories();
+			mMonitor->advance(1);
+		}
+		break;
+	}
+	case TarArchive::TYPE_FILE:
+	case TarArchive::TYPE_OLD_FILE:
+	case TarArchive::TYPE_CONTIGUOUS_FILE: {
+		std::string path = getLocalPath(name);
+		if (!path.empty()) {
+			mMonitor->startSubTask(name);
+			Poco::File(Poco::Path(path).parent()).createDirectories();
+			mOutputPath = path;
+			mOutputTime = parseNumber(header + MTIME_OFFSET, 12);
+			mOutput = std::tr1::shared_ptr<Poco::FileOutputStream>(
+					new Poco::FileOutputStream(path, std::ios::out | std::ios::binary | std::ios::trunc));
+			mContent = FILE_CONTENT;
+		}
+		break;
+	}
+	default:
+		Log::v("ddms", "Skipping archive entry " + name);
+		break;
+	}
+
+	mRemaining = size;
+	mPadding = (TarArchive::BLOCK_SIZE - size % TarArchive::BLOCK_SIZE) % TarArchive::BLOCK_SIZE;
+	if (mRemaining > 0) {
+		mState = DATA;
+	} else {
+		endEntry();
+	}
+}
+
+void TarReader::endEntry() {
+	switch (mContent) {
+	case FILE_CONTENT:
+		mOutput->close();
+		mOutput.reset();
+		Poco::File(mOutputPath).setLastModified(Poco::Timestamp::fromEpochTime((std::time_t) mOutputTime));
+		++mFileCount;
+		break;
+	case LONG_NAME:
+		mNextName = std::string(mExtendedData.c_str());
+		break;
+	case PAX_HEADER:
+		parsePaxHeader();
+		break;
+	default:
+		break;
+	}
+	mExtendedData.clear();
+	mContent = SKIP;
+	mState = mPadding > 0 ? PADDING : HEADER;
+}
+
+void TarReader::parsePaxHeader() {
+	// records of "<length> <key>=<value>\n", only the path matters here.
+	size_t offset = 0;
+	while (offset < mExtendedData.length()) {
+		size_t space = mExtendedData.find(' ', offset);
+		if (space == std::string::npos) {
+			break;
+		}
+		unsigned int length = 0;
+		if (!Poco::NumberParser::tryParseUnsigned(mExtendedData.substr(offset, space - offset), length) || length == 0
+				|| offset + length > mExtendedData.length()) {
+			break;
+		}
+		std::string record = mExtendedData.substr(space + 1, offset + length - space - 2);
+		if (record.compare(0, 5, "path=") == 0) {
+			mNextName = record.substr(5);
+		}
+		offset += length;
+	}
+}
+
+void TarReader::addTrailer(const unsigned char* data, size_t length) {
+	// the archive is padded with NULs up to the record size of tar (10 KiB for GNU tar): they
+	// are dropped, and what follows is kept from its end, where the exit status is.
+	for (size_t i = 0; i < length; ++i) {
+		if (data[i] != '\0') {
+			mTrailer.push_back((char) data[i]);
+		}
+	}
+	if (mTrailer.length() > MAX_TRAILER) {
+		mTrailer.erase(0, mTrailer.length() - MAX_TRAILER);
+	}
+}
+
+std::string TarReader::getLocalPath(const std::string& name) const {
+	if (name.empty() || name[0] == '/') {
+		Log::w("ddms", "Skipping archive entry with an absolute path: " + name);
+		return "";
+	}
+
+	Poco::Path path(mLocalPath);
+	path.makeDirectory();
+	Poco::StringTokenizer tokens(name, "/", Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator t = tokens.begin(); t != tokens.end(); ++t) {
+		if (*t == "..") {
+			Log::w("ddms", "Skipping archive entry outside of the destination: " + name);
+			return "";
+		}
+		if (*t != ".") {
+			path.pushDirectory(*t);
+		}
+	}
+	if (path.depth() == 0) {
+		return "";
+	}
+
+	// the last component is the file name.
+	std::string fileName = path[path.depth() - 1];
+	path.popDirectory();
+	path.setFileName(fileName);
+	return path.toString();
+}
+
+long long TarReader::parseNumber(const unsigned char* field, size_t width) {
+	long long value = 0;
+	if (field[0] & 0x80) {
+		// GNU base-256
+		value = field[0] & 0x7F;
+		for (size_t i = 1; i < width; ++i) {
+			value = (value << 8) | field[i];
+		}
+		return value;
+	}
+
+	size_t i = 0;
+	while (i < width && field[i] == ' ') {
+		++i;
+	}
+	for (; i < width && field[i] >= '0' && field[i] <= '7'; ++i) {
+		value = (value << 3) | (field[i] - '0');
+	}
+	return value;
+}
+
+std::string TarReader::parseString(const unsigned char* field, size_t width) {
+	size_t length = 0;
+	while (length < width && field[length] != 0) {
+		++length;
+	}
+	return std::string(reinterpret_cast<const char*>(field), length);
+}
+
+} /* namespace ddmlib */
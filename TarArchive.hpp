@@ -0,0 +1,195 @@
+/*
+ * TarArchive.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef TARARCHIVE_HPP_
+#define TARARCHIVE_HPP_
+#include "ddmlib.hpp"
+#include "IRawOutputReceiver.hpp"
+
+namespace ddmlib {
+
+class ISyncProgressMonitor;
+
+/**
+ * Constants of the tar format (POSIX ustar, with the GNU long name extension).
+ */
+class DDMLIB_LOCAL TarArchive {
+public:
+	static const size_t BLOCK_SIZE = 512;
+	/** tar reads and writes archives by records of 20 blocks. */
+	static const size_t RECORD_SIZE = 20 * 512;
+
+	static const char TYPE_FILE = '0';
+	static const char TYPE_OLD_FILE = '\0';
+	static const char TYPE_CONTIGUOUS_FILE = '7';
+	static const char TYPE_DIRECTORY = '5';
+	/** GNU extension: the data is the name of the next entry. */
+	static const char TYPE_LONG_NAME = 'L';
+	/** pax extended header of the next entry. */
+	static const char TYPE_PAX_HEADER = 'x';
+};
+
+/**
+ * Writes a tar archive of local files to a stream, without temporary files.
+ */
+class DDMLIB_LOCAL TarWriter {
+public:
+	/**
+	 * @param chan the stream to write the archive to.
+	 * @param timeOut the timeout of the writes, in ms.
+	 * @param monitor the progress monitor, advanced by the size of the files. Directories
+	 *      count for 1, as in {@link SyncService#push}.
+	 */
+	TarWriter(std::tr1::shared_ptr<Poco::Net::StreamSocket> chan, int timeOut, ISyncProgressMonitor* monitor);
+
+	/**
+	 * Adds a file, or a directory and its content.
+	 * @param file the local file.
+	 * @param name its path in the archive.
+	 * @throws SyncException if a file can't be read, or the transfer was canceled.
+	 */
+	void add(const Poco::File& file, const std::string& name);
+
+	/**
+	 * Ends the archive, and sends what is still buffered.
+	 */
+	void finish();
+
+	long long getFileCount() const {
+		return mFileCount;
+	}
+
+private:
+	static const size_t BUFFER_SIZE = 64 * 1024;
+
+	std::tr1::shared_ptr<Poco::Net::StreamSocket> mChannel;
+	int mTimeOut;
+	ISyncProgressMonitor* mMonitor;
+
+	std::vector<unsigned char> mBuffer;
+	size_t mUsed;
+	long long mWritten;
+	long long mFileCount;
+
+	void addFile(const Poco::File& file, const std::string& name);
+	void writeHeader(const std::string& name, long long size, int mode, long long mtime, char type);
+	void append(const unsigned char* data, size_t length);
+	void appendZeros(size_t length);
+	void padBlock(long long size);
+	void flush();
+
+	static void writeNumber(unsigned char* field, size_t width, unsigned long long value);
+};
+
+/**
+ * Extracts a tar archive into a local directory as it is received.
+ * <p/>Regular files and directories are extracted; other entries (links, devices...) are
+ * skipped. Entries with absolute paths or <code>..</code> components are skipped too.
+ * <p/>Whatever follows the end of the archive is kept, see {@link #getTrailer()}.
+ */
+class DDMLIB_LOCAL TarReader: public IRawOutputReceiver {
+public:
+	/**
+	 * @param localPath the destination directory.
+	 * @param monitor the progress monitor, advanced by the size of the extracted files.
+	 */
+	TarReader(const std::string& localPath, ISyncProgressMonitor* monitor);
+	virtual ~TarReader();
+
+	void addOutput(const unsigned char* data, unsigned int length);
+	void done();
+	bool isCancelled();
+
+	/**
+	 * Returns whether the end of the archive was received.
+	 */
+	bool isComplete() const {
+		return mComplete;
+	}
+
+	/**
+	 * Returns the data following the archive (or replacing it, if the stream wasn't an
+	 * archive at all), without NUL bytes and limited to its last 4 KiB.
+	 */
+	std::string getTrailer() const {
+		return mTrailer;
+	}
+
+	long long getFileCount() const {
+		return mFileCount;
+	}
+
+private:
+	enum State {
+		HEADER, DATA, PADDING, TRAILER
+	};
+
+	/** what the data of the current entry is for. */
+	enum Content {
+		SKIP, FILE_CONTENT, LONG_NAME, PAX_HEADER
+	};
+
+	static const size_t MAX_TRAILER = 4096;
+
+	std::string mLocalPath;
+	ISyncProgressMonitor* mMonitor;
+
+	State mState;
+	std::vector<unsigned char> mHeader;
+	size_t mHeaderUsed;
+	int mZeroBlocks;
+	bool mComplete;
+
+	Content mContent;
+	long long mRemaining;
+	long long mPadding;
+	std::string mExtendedData;
+	std::string mNextName;
+
+	std::tr1::shared_ptr<Poco::FileOutputStream> mOutput;
+	std::string mOutputPath;
+	long long mOutputTime;
+
+	std::string mTrailer;
+	long long mFileCount;
+
+	void processHeader();
+	void endEntry();
+	void addTrailer(const unsigned char* data, size_t length);
+	void parsePaxHeader();
+
+	/**
+	 * Returns the local path of an entry, or an empty string if the entry must be skipped.
+	 */
+	std::string getLocalPath(const std::string& name) const;
+
+	static long long parseNumber(const unsigned char* field, size_t width);
+	static std::string parseString(const unsigned char* field, size_t width);
+};
+
+/**
+ * Collects the output of a command run through the <code>exec:</code> service as text.
+ */
+class DDMLIB_LOCAL TarOutputCollector: public IRawOutputReceiver {
+public:
+	void addOutput(const unsigned char* data, unsigned int length) {
+		mOutput.append(reinterpret_cast<const char*>(data), length);
+	}
+	void done() {
+	}
+	bool isCancelled() {
+		return false;
+	}
+	std::string getOutput() const {
+		return mOutput;
+	}
+private:
+	std::string mOutput;
+};
+
+} /* namespace ddmlib */
+#endif /* TARARCHIVE_HPP_ */
@@ -0,0 +1,116 @@
+/*
+ * TransferScheduler.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#include "ddmlib.hpp"
+#include "TransferScheduler.hpp"
+
+namespace ddmlib {
+
+const Poco::Timestamp::TimeDiff TransferScheduler::ACTIVITY_WINDOW = 200 * 1000;
+const int TransferScheduler::WEIGHTS[PRIORITY_COUNT] = { 4, 2, 1 };
+
+TransferScheduler::TransferScheduler() :
+		mTotalLimit(0) {
+	for (int i = 0; i < PRIORITY_COUNT; ++i) {
+		mLimits[i] = 0;
+		mSeen[i] = false;
+	}
+	resetStats();
+}
+
+TransferScheduler::~TransferScheduler() {
+}
+
+void TransferScheduler::setBandwidthLimit(long long bytesPerSecond) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mTotalLimit = std::max(bytesPerSecond, 0LL);
+}
+
+long long TransferScheduler::getBandwidthLimit() {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mTotalLimit;
+}
+
+void TransferScheduler::setPriorityLimit(Priority priority, long long bytesPerSecond) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mLimits[priority] = std::max(bytesPerSecond, 0LL);
+}
+
+long long TransferScheduler::getPriorityLimit(Priority priority) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mLimits[priority];
+}
+
+void TransferScheduler::acquire(Priority priority, unsigned int bytes) {
+	Poco::Timestamp::TimeDiff wait = 0;
+	{
+		Poco::FastMutex::ScopedLock lock(mLock);
+		Poco::Timestamp now;
+		mLastActive[priority] = now;
+		mSeen[priority] = true;
+		mStats[priority].bytes += bytes;
+		mStats[priority].frames += 1;
+
+		double rate = getRate(priority, now);
+		if (rate <= 0) {
+			return;
+		}
+
+		// the frame goes at the scheduled time, and pushes the schedule by its own duration.
+		if (mNext[priority] < now) {
+			mNext[priority] = now;
+		}
+		wait = mNext[priority] - now;
+		mNext[priority] += (Poco::Timestamp::TimeDiff) (bytes * 1000000.0 / rate);
+		mStats[priority].waitTime += wait;
+	}
+
+	if (wait >= 1000) {
+		Poco::Thread::sleep((long) (wait / 1000));
+	}
+}
+
+void TransferScheduler::record(Priority priority, unsigned int bytes) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	mLastActive[priority].update();
+	mSeen[priority] = true;
+	mStats[priority].bytes += bytes;
+	mStats[priority].frames += 1;
+}
+
+TransferScheduler::Stats TransferScheduler::getStats(Priority priority) {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	return mStats[priority];
+}
+
+void TransferScheduler::resetStats() {
+	Poco::FastMutex::ScopedLock lock(mLock);
+	for (int i = 0; i < PRIORITY_COUNT; ++i) {
+		mStats[i].bytes = 0;
+		mStats[i].frames = 0;
+		mStats[i].waitTime = 0;
+	}
+}
+
+double TransferScheduler::getRate(Priority priority, const Poco::Timestamp& now) {
+	double rate = (double) mLimits[priority];
+
+	if (mTotalLimit > 0) {
+		// the active classes split the total limit by weight.
+		int weights = 0;
+		for (int i = 0; i < PRIORITY_COUNT; ++i) {
+			if (i == priority || (mSeen[i] && now - mLastActive[i] < ACTIVITY_WINDOW)) {
+				weights += WEIGHTS[i];
+			}
+		}
+		double share = (double) mTotalLimit * WEIGHTS[priority] / weights;
+		rate = (rate > 0) ? std::min(rate, share) : share;
+	}
+	return rate;
+}
+
+} /* namespace ddmlib */
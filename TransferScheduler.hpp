@@ -0,0 +1,107 @@
+/*
+ * TransferScheduler.hpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ */
+
+#ifndef TRANSFERSCHEDULER_HPP_
+#define TRANSFERSCHEDULER_HPP_
+#include "ddmlib.hpp"
+
+namespace ddmlib {
+
+/**
+ * Shares the bandwidth of the link to a device between its transfers.
+ * <p/>The transfers belong to priority classes. When a total limit is set, the classes which
+ * had traffic recently split it by weight: {@link #PRIORITY_INTERACTIVE} gets 4 shares,
+ * {@link #PRIORITY_NORMAL} 2 and {@link #PRIORITY_BULK} 1, so a bulk push slows down as soon
+ * as interactive traffic shows up, and gets the whole limit back once it stops. Each class can
+ * also have its own limit.
+ * <p/>The sync transfers call {@link #acquire} before every DATA frame, and wait for their
+ * turn. Streams which can't be paced (logcat, JDWP) can {@link #record} their traffic so that
+ * their class counts as active.
+ * <p/>Without any limit, {@link #acquire} only counts the traffic. This class is thread-safe.
+ * @see Device#getTransferScheduler()
+ */
+class DDMLIB_API TransferScheduler {
+public:
+	enum Priority {
+		PRIORITY_INTERACTIVE = 0, PRIORITY_NORMAL = 1, PRIORITY_BULK = 2
+	};
+
+	static const int PRIORITY_COUNT = 3;
+
+	/**
+	 * Traffic of a priority class since the creation of the scheduler, or the last
+	 * {@link #resetStats()}.
+	 */
+	struct Stats {
+		/** bytes let through. */
+		long long bytes;
+		/** number of frames let through. */
+		long long frames;
+		/** total time spent waiting for a turn, in microseconds. */
+		long long waitTime;
+	};
+
+	TransferScheduler();
+	virtual ~TransferScheduler();
+
+	/**
+	 * Sets the limit shared by all the classes, in bytes per second. 0 (the default) means
+	 * no limit.
+	 */
+	void setBandwidthLimit(long long bytesPerSecond);
+
+	long long getBandwidthLimit();
+
+	/**
+	 * Sets the limit of a class, in bytes per second, on top of its share of the total
+	 * limit. 0 (the default) means no limit.
+	 */
+	void setPriorityLimit(Priority priority, long long bytesPerSecond);
+
+	long long getPriorityLimit(Priority priority);
+
+	/**
+	 * Waits until <var>bytes</var> can be sent or received by a transfer of the given class.
+	 * <p/>The first frame after a pause goes through at once: idle time isn't saved up for
+	 * later bursts.
+	 */
+	void acquire(Priority priority, unsigned int bytes);
+
+	/**
+	 * Counts traffic which isn't paced, without waiting.
+	 */
+	void record(Priority priority, unsigned int bytes);
+
+	Stats getStats(Priority priority);
+
+	void resetStats();
+
+private:
+	/** a class which had traffic within this delay is active, in microseconds. */
+	static const Poco::Timestamp::TimeDiff ACTIVITY_WINDOW;
+	static const int WEIGHTS[PRIORITY_COUNT];
+
+	long long mTotalLimit;
+	long long mLimits[PRIORITY_COUNT];
+
+	/** when the next frame of each class may go. */
+	Poco::Timestamp mNext[PRIORITY_COUNT];
+	Poco::Timestamp mLastActive[PRIORITY_COUNT];
+	bool mSeen[PRIORITY_COUNT];
+
+	Stats mStats[PRIORITY_COUNT];
+	Poco::FastMutex mLock;
+
+	/**
+	 * Returns the current rate of a class, in bytes per second, 0 if unlimited. Must be called
+	 * with the lock held.
+	 */
+	double getRate(Priority priority, const Poco::Timestamp& now);
+};
+
+} /* namespace ddmlib */
+#endif /* TRANSFERSCHEDULER_HPP_ */
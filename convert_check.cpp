@@ -0,0 +1,143 @@
+/*
+ * convert_check.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ *
+ * Checks that RawImage::convertToARGB and RawImage::convertToRGBA give bit for bit the values
+ * of RawImage::getARGB, for the layouts with a dedicated conversion and for generic ones.
+ * Every 16 bit value is converted, and random pixels of 32 bit layouts, with pixel counts
+ * around the SIMD widths and for a whole frame.
+ *
+ * Usage: convert_check
+ */
+#include "RawImage.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace ddmlib;
+
+namespace {
+
+struct Layout {
+	const char* name;
+	int bpp;
+	int red_offset;
+	int red_length;
+	int green_offset;
+	int green_length;
+	int blue_offset;
+	int blue_length;
+	int alpha_offset;
+	int alpha_length;
+};
+
+const Layout LAYOUTS[] = {
+	{ "RGB 565", 16, 11, 5, 5, 6, 0, 5, 0, 0 },
+	{ "RGBA 8888", 32, 0, 8, 8, 8, 16, 8, 24, 8 },
+	{ "RGBX 8888", 32, 0, 8, 8, 8, 16, 8, 24, 0 },
+	{ "BGRA 8888", 32, 16, 8, 8, 8, 0, 8, 24, 8 },
+	{ "BGRX 8888", 32, 16, 8, 8, 8, 0, 8, 24, 0 },
+	{ "ARGB 4444", 16, 8, 4, 4, 4, 0, 4, 12, 4 },
+	{ "RGBA 5551", 16, 11, 5, 6, 5, 1, 5, 0, 1 },
+	{ "BGR 565", 16, 0, 5, 5, 6, 11, 5, 0, 0 },
+	{ "ARGB 8888", 32, 8, 8, 16, 8, 24, 8, 0, 8 },
+	{ "XBGR 8888", 32, 24, 8, 16, 8, 8, 8, 0, 0 },
+	{ "RGB 666", 32, 12, 6, 6, 6, 0, 6, 0, 0 },
+};
+
+/** pixel counts around the widths of the SIMD loops, then a 1440x2960 frame. */
+const int PIXEL_COUNTS[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1440 * 2960 };
+
+void setLayout(RawImage& image, const Layout& layout, int pixelCount) {
+	image.version = 1;
+	image.bpp = layout.bpp;
+	image.width = pixelCount;
+	image.height = 1;
+	image.size = pixelCount * (layout.bpp >> 3);
+	image.red_offset = layout.red_offset;
+	image.red_length = layout.red_length;
+	image.green_offset = layout.green_offset;
+	image.green_length = layout.green_length;
+	image.blue_offset = layout.blue_offset;
+	image.blue_length = layout.blue_length;
+	image.alpha_offset = layout.alpha_offset;
+	image.alpha_length = layout.alpha_length;
+	image.data.resize(image.size);
+}
+
+/**
+ * Compares the bulk conversions of <var>image</var> with getARGB.
+ * @return the number of mismatches.
+ */
+int check(RawImage& image, const Layout& layout) {
+	size_t count = image.getPixelCount();
+	// one more value, which must be left alone.
+	std::vector<unsigned int> argb(count + 1, 0xDEADBEEF);
+	std::vector<unsigned int> rgba(count + 1, 0xDEADBEEF);
+	image.convertToARGB(&argb[0]);
+	image.convertToRGBA(&rgba[0]);
+
+	int mismatches = 0;
+	size_t byteCount = image.bpp >> 3;
+	for (size_t i = 0; i <= count; ++i) {
+		unsigned int expectedArgb = 0xDEADBEEF;
+		unsigned int expectedRgba = 0xDEADBEEF;
+		if (i < count) {
+			expectedArgb = image.getARGB((int) (i * byteCount));
+			// R, G, B, A bytes in memory.
+			const unsigned char bytes[4] = { (unsigned char) (expectedArgb >> 16), (unsigned char) (expectedArgb >> 8),
+					(unsigned char) expectedArgb, (unsigned char) (expectedArgb >> 24) };
+			memcpy(&expectedRgba, bytes, 4);
+		}
+		if (argb[i] != expectedArgb || rgba[i] != expectedRgba) {
+			if (mismatches == 0) {
+				char line[160];
+				sprintf(line, "%s, %u pixels: pixel %u is ARGB %08x RGBA %08x, expected %08x %08x", layout.name,
+						(unsigned int) count, (unsigned int) i, argb[i], rgba[i], expectedArgb, expectedRgba);
+				std::cout << line << std::endl;
+			}
+			++mismatches;
+		}
+	}
+	return mismatches;
+}
+
+} // namespace
+
+int main() {
+	int failures = 0;
+	for (size_t l = 0; l < sizeof(LAYOUTS) / sizeof(LAYOUTS[0]); ++l) {
+		const Layout& layout = LAYOUTS[l];
+		RawImage image;
+		int mismatches = 0;
+
+		if (layout.bpp == 16) {
+			// every value.
+			setLayout(image, layout, 65536);
+			for (int v = 0; v < 65536; ++v) {
+				image.data[v * 2] = (unsigned char) v;
+				image.data[v * 2 + 1] = (unsigned char) (v >> 8);
+			}
+			mismatches += check(image, layout);
+		}
+
+		unsigned int seed = 12345;
+		for (size_t c = 0; c < sizeof(PIXEL_COUNTS) / sizeof(PIXEL_COUNTS[0]); ++c) {
+			setLayout(image, layout, PIXEL_COUNTS[c]);
+			for (size_t i = 0; i < image.data.size(); ++i) {
+				seed = seed * 1103515245 + 12345;
+				image.data[i] = (unsigned char) (seed >> 16);
+			}
+			mismatches += check(image, layout);
+		}
+
+		std::cout << layout.name << ": " << (mismatches == 0 ? "ok" : "FAILED") << std::endl;
+		if (mismatches != 0) {
+			++failures;
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
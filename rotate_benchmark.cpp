@@ -0,0 +1,216 @@
+/*
+ * rotate_benchmark.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ *
+ * Times RawImage::getRotated and RawImage::convertRotatedToARGB on synthetic frames of the
+ * common phone and tablet resolutions, against a pixel by pixel rotation in destination
+ * order, and checks that both give the same pixels.
+ *
+ * Usage: rotate_benchmark [iterations]
+ */
+#include "RawImage.hpp"
+#include <Poco/Timestamp.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace ddmlib;
+
+namespace {
+
+struct Resolution {
+	const char* name;
+	int width;
+	int height;
+};
+
+const Resolution RESOLUTIONS[] = {
+	{ "phone HD", 720, 1280 },
+	{ "phone FHD", 1080, 1920 },
+	{ "phone FHD+", 1080, 2340 },
+	{ "phone QHD+", 1440, 2960 },
+	{ "tablet 10\"", 1600, 2560 },
+	{ "tablet 4:3", 2048, 1536 },
+};
+
+const int ANGLES[] = { 90, 180, 270 };
+
+void fillImage(RawImage& image, int width, int height, int bpp) {
+	image.version = 1;
+	image.bpp = bpp;
+	image.width = width;
+	image.height = height;
+	image.size = width * height * (bpp >> 3);
+	if (bpp == 16) {
+		// RGB 565
+		image.red_offset = 11;
+		image.red_length = 5;
+		image.green_offset = 5;
+		image.green_length = 6;
+		image.blue_offset = 0;
+		image.blue_length = 5;
+		image.alpha_offset = 0;
+		image.alpha_length = 0;
+	} else {
+		// RGBA 8888
+		image.red_offset = 0;
+		image.red_length = 8;
+		image.green_offset = 8;
+		image.green_length = 8;
+		image.blue_offset = 16;
+		image.blue_length = 8;
+		image.alpha_offset = 24;
+		image.alpha_length = 8;
+	}
+
+	image.data.resize(image.size);
+	unsigned int seed = (unsigned int) (width * 31 + height);
+	for (size_t i = 0; i < image.data.size(); ++i) {
+		seed = seed * 1103515245 + 12345;
+		image.data[i] = (unsigned char) (seed >> 16);
+	}
+}
+
+/**
+ * Rotates counter-clockwise one pixel at a time, walking the destination in order.
+ */
+void rotateByPixel(const RawImage& image, int angle, std::vector<unsigned char>& dest) {
+	const int w = image.width;
+	const int h = image.height;
+	const int byteCount = image.bpp >> 3;
+	const int destWidth = (angle == 180) ? w : h;
+	const int destHeight = (angle == 180) ? h : w;
+	dest.resize(image.data.size());
+	for (int dy = 0; dy < destHeight; dy++) {
+		for (int dx = 0; dx < destWidth; dx++) {
+			int x;
+			int y;
+			if (angle == 90) {
+				x = w - 1 - dy;
+				y = dx;
+			} else if (angle == 180) {
+				x = w - 1 - dx;
+				y = h - 1 - dy;
+			} else {
+				x = dy;
+				y = h - 1 - dx;
+			}
+			std::copy(&image.data[((size_t) y * w + x) * byteCount], &image.data[((size_t) y * w + x + 1) * byteCount],
+					&dest[((size_t) dy * destWidth + dx) * byteCount]);
+		}
+	}
+}
+
+/**
+ * Returns the median duration of <var>iterations</var> runs of <var>run</var>, in ms.
+ */
+template<typename Run> double measure(Run run, int iterations) {
+	std::vector<double> durations;
+	for (int i = 0; i < iterations; ++i) {
+		Poco::Timestamp start;
+		run();
+		durations.push_back((double) start.elapsed() / 1000.0);
+	}
+	std::sort(durations.begin(), durations.end());
+	return durations[durations.size() / 2];
+}
+
+struct RotateByPixel {
+	const RawImage& image;
+	int angle;
+	std::vector<unsigned char>& dest;
+	RotateByPixel(const RawImage& image, int angle, std::vector<unsigned char>& dest) :
+			image(image), angle(angle), dest(dest) {
+	}
+	void operator()() {
+		rotateByPixel(image, angle, dest);
+	}
+};
+
+struct RotateTiled {
+	RawImage& image;
+	int angle;
+	RotateTiled(RawImage& image, int angle) :
+			image(image), angle(angle) {
+	}
+	void operator()() {
+		image.getRotated(angle);
+	}
+};
+
+struct RotateThenConvert {
+	RawImage& image;
+	int angle;
+	std::vector<unsigned int>& dest;
+	RotateThenConvert(RawImage& image, int angle, std::vector<unsigned int>& dest) :
+			image(image), angle(angle), dest(dest) {
+	}
+	void operator()() {
+		image.getRotated(angle)->convertToARGB(&dest[0]);
+	}
+};
+
+struct ConvertRotated {
+	const RawImage& image;
+	int angle;
+	std::vector<unsigned int>& dest;
+	ConvertRotated(const RawImage& image, int angle, std::vector<unsigned int>& dest) :
+			image(image), angle(angle), dest(dest) {
+	}
+	void operator()() {
+		image.convertRotatedToARGB(angle, &dest[0]);
+	}
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? atoi(argv[1]) : 11;
+	if (iterations < 1) {
+		iterations = 1;
+	}
+
+	std::cout << "median of " << iterations << " runs, in ms" << std::endl;
+	std::cout << "resolution            bpp angle   by pixel     tiled   rotate+convert     fused" << std::endl;
+
+	int failures = 0;
+	for (size_t r = 0; r < sizeof(RESOLUTIONS) / sizeof(RESOLUTIONS[0]); ++r) {
+		for (int bpp = 16; bpp <= 32; bpp += 16) {
+			RawImage image;
+			fillImage(image, RESOLUTIONS[r].width, RESOLUTIONS[r].height, bpp);
+			std::vector<unsigned char> reference;
+			std::vector<unsigned int> argb(image.getPixelCount());
+
+			for (size_t a = 0; a < sizeof(ANGLES) / sizeof(ANGLES[0]); ++a) {
+				int angle = ANGLES[a];
+
+				rotateByPixel(image, angle, reference);
+				std::tr1::shared_ptr<RawImage> rotated = image.getRotated(angle);
+				std::vector<unsigned int> expected(argb.size());
+				rotated->convertToARGB(&expected[0]);
+				image.convertRotatedToARGB(angle, &argb[0]);
+				if (rotated->data != reference || argb != expected) {
+					std::cout << RESOLUTIONS[r].name << " " << bpp << " bpp " << angle << ": pixels differ" << std::endl;
+					++failures;
+				}
+
+				double byPixel = measure(RotateByPixel(image, angle, reference), iterations);
+				double tiled = measure(RotateTiled(image, angle), iterations);
+				double rotateThenConvert = measure(RotateThenConvert(image, angle, argb), iterations);
+				double fused = measure(ConvertRotated(image, angle, argb), iterations);
+
+				char line[160];
+				sprintf(line, "%-11s %4dx%-4d %3d %5d %10.2f %9.2f %16.2f %9.2f", RESOLUTIONS[r].name,
+						RESOLUTIONS[r].width, RESOLUTIONS[r].height, bpp, angle, byPixel, tiled, rotateThenConvert,
+						fused);
+				std::cout << line << std::endl;
+			}
+		}
+	}
+	return failures == 0 ? 0 : 1;
+}
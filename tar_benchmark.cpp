@@ -0,0 +1,527 @@
+/*
+ * tar_benchmark.cpp
+ *
+ *  Created on: 18.10.2026
+ *      Author: sergey bulavintsev
+ *
+ * Compares the per-file sync transfers with the tar archive-stream mode on a synthetic tree of
+ * 50,000 small files, served by a fake adb server on the loopback interface. The fake device
+ * keeps nothing it is sent, and serves pulls from the local tree.
+ *
+ * Usage: tar_benchmark [file count]
+ */
+#include "Log.hpp"
+#include "Device.hpp"
+#include "DeviceMonitor.hpp"
+#include "AndroidDebugBridge.hpp"
+#include "SyncService.hpp"
+#include "FileListingService.hpp"
+#include "AdbServerAddress.hpp"
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/Net/StreamSocket.h>
+#include <Poco/Net/TCPServer.h>
+#include <Poco/Net/TCPServerConnection.h>
+#include <Poco/Net/TCPServerConnectionFactory.h>
+#include <Poco/File.h>
+#include <Poco/Path.h>
+#include <Poco/FileStream.h>
+#include <Poco/Timestamp.h>
+#include <Poco/NumberFormatter.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace ddmlib;
+
+namespace {
+
+const char SERIAL[] = "benchmark-0001";
+const char REMOTE_ROOT[] = "/bench";
+const int FILES_PER_DIRECTORY = 200;
+const size_t BLOCK = 512;
+const size_t RECORD = 20 * BLOCK;
+const unsigned int SYNC_DATA_MAX = 64 * 1024;
+
+// the local directory the remote paths below REMOTE_ROOT map to.
+std::string sDeviceRoot;
+
+void readFully(Poco::Net::StreamSocket& socket, unsigned char* data, size_t length) {
+	while (length > 0) {
+		int count = socket.receiveBytes(data, (int) length);
+		if (count <= 0) {
+			throw Poco::IOException("connection closed");
+		}
+		data += count;
+		length -= count;
+	}
+}
+
+void writeFully(Poco::Net::StreamSocket& socket, const void* data, size_t length) {
+	const char* p = static_cast<const char*>(data);
+	while (length > 0) {
+		int count = socket.sendBytes(p, (int) length);
+		if (count <= 0) {
+			throw Poco::IOException("connection closed");
+		}
+		p += count;
+		length -= count;
+	}
+}
+
+void writeString(Poco::Net::StreamSocket& socket, const std::string& s) {
+	writeFully(socket, s.data(), s.length());
+}
+
+unsigned int getInt(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+void putInt(unsigned char* p, unsigned int value) {
+	p[0] = value & 0xff;
+	p[1] = (value >> 8) & 0xff;
+	p[2] = (value >> 16) & 0xff;
+	p[3] = (value >> 24) & 0xff;
+}
+
+void writeReply(Poco::Net::StreamSocket& socket, const char* id, unsigned int value) {
+	unsigned char reply[8];
+	memcpy(reply, id, 4);
+	putInt(reply + 4, value);
+	writeFully(socket, reply, 8);
+}
+
+std::string toLocalPath(const std::string& remotePath) {
+	return sDeviceRoot + remotePath.substr(sizeof(REMOTE_ROOT) - 1);
+}
+
+/**
+ * Returns the words of a shell command line in single quotes, in order.
+ */
+std::vector<std::string> getQuotedWords(const std::string& command) {
+	std::vector<std::string> words;
+	std::string word;
+	bool quoted = false;
+	bool inWord = false;
+	for (size_t i = 0; i < command.length(); ++i) {
+		char c = command[i];
+		if (c == '\'') {
+			quoted = !quoted;
+			inWord = true;
+		} else if (quoted) {
+			word += c;
+		} else if (command.compare(i, 2, "\\'") == 0) {
+			word += '\'';
+			++i;
+		} else if (inWord) {
+			words.push_back(word);
+			word.clear();
+			inWord = false;
+		}
+	}
+	if (inWord) {
+		words.push_back(word);
+	}
+	return words;
+}
+
+/**
+ * Writes a ustar archive of local files, as tar -cf on the device would.
+ */
+class ArchiveWriter {
+public:
+	ArchiveWriter(Poco::Net::StreamSocket& socket) :
+			mSocket(socket), mWritten(0), mBuffer(SYNC_DATA_MAX) {
+	}
+
+	void add(const Poco::File& file, const std::string& name) {
+		if (file.isDirectory()) {
+			writeHeader(name + "/", '5', 0, 0755);
+			std::vector<std::string> children;
+			file.list(children);
+			for (std::vector<std::string>::const_iterator c = children.begin(); c != children.end(); ++c) {
+				add(Poco::File(file.path() + "/" + *c), name + "/" + *c);
+			}
+		} else {
+			long long size = (long long) file.getSize();
+			writeHeader(name, '0', size, 0644);
+			Poco::FileInputStream in(file.path(), std::ios::in | std::ios::binary);
+			long long left = size;
+			while (left > 0) {
+				in.read(reinterpret_cast<char*>(&mBuffer[0]), (std::streamsize) std::min(left, (long long) mBuffer.size()));
+				size_t count = (size_t) in.gcount();
+				if (count == 0) {
+					throw Poco::IOException("short read on " + file.path());
+				}
+				write(&mBuffer[0], count);
+				left -= count;
+			}
+			pad((size_t) ((BLOCK - size % BLOCK) % BLOCK));
+		}
+	}
+
+	void finish() {
+		pad(2 * BLOCK);
+		pad((size_t) ((RECORD - mWritten % RECORD) % RECORD));
+	}
+
+private:
+	Poco::Net::StreamSocket& mSocket;
+	long long mWritten;
+	std::vector<unsigned char> mBuffer;
+
+	void writeHeader(const std::string& name, char type, long long size, int mode) {
+		unsigned char header[BLOCK];
+		memset(header, 0, BLOCK);
+		// the synthetic names always fit.
+		memcpy(header, name.data(), std::min(name.length(), (size_t) 100));
+		sprintf(reinterpret_cast<char*>(header + 100), "%07o", mode);
+		sprintf(reinterpret_cast<char*>(header + 108), "%07o", 0);
+		sprintf(reinterpret_cast<char*>(header + 116), "%07o", 0);
+		sprintf(reinterpret_cast<char*>(header + 124), "%011llo", size);
+		sprintf(reinterpret_cast<char*>(header + 136), "%011llo", (long long) 1760000000);
+		header[156] = type;
+		memcpy(header + 257, "ustar\0" "00", 8);
+		memset(header + 148, ' ', 8);
+		unsigned int checksum = 0;
+		for (size_t i = 0; i < BLOCK; ++i) {
+			checksum += header[i];
+		}
+		sprintf(reinterpret_cast<char*>(header + 148), "%06o", checksum);
+		header[155] = ' ';
+		write(header, BLOCK);
+	}
+
+	void pad(size_t length) {
+		static const unsigned char zeros[BLOCK] = { 0 };
+		while (length > 0) {
+			size_t count = std::min(length, BLOCK);
+			write(zeros, count);
+			length -= count;
+		}
+	}
+
+	void write(const unsigned char* data, size_t length) {
+		writeFully(mSocket, data, length);
+		mWritten += length;
+	}
+};
+
+/**
+ * Reads a tar archive up to its end and its record padding, as tar -xf on the device would.
+ * @return the number of files in the archive.
+ */
+long long consumeArchive(Poco::Net::StreamSocket& socket) {
+	std::vector<unsigned char> data(SYNC_DATA_MAX);
+	unsigned char header[BLOCK];
+	long long total = 0;
+	long long files = 0;
+	int zeroBlocks = 0;
+	while (zeroBlocks < 2) {
+		readFully(socket, header, BLOCK);
+		total += BLOCK;
+		bool zero = true;
+		for (size_t i = 0; i < BLOCK && zero; ++i) {
+			zero = header[i] == 0;
+		}
+		if (zero) {
+			++zeroBlocks;
+			continue;
+		}
+		zeroBlocks = 0;
+		if (header[156] == '0' || header[156] == '\0') {
+			++files;
+		}
+		long long size = strtoll(std::string(reinterpret_cast<char*>(header + 124), 12).c_str(), NULL, 8);
+		long long left = (size + BLOCK - 1) / BLOCK * BLOCK;
+		total += left;
+		while (left > 0) {
+			size_t count = (size_t) std::min(left, (long long) data.size());
+			readFully(socket, &data[0], count);
+			left -= count;
+		}
+	}
+	size_t padding = (size_t) ((RECORD - total % RECORD) % RECORD);
+	if (padding > 0) {
+		readFully(socket, &data[0], padding);
+	}
+	return files;
+}
+
+/**
+ * One connection to the fake adb server: the transport request, then a sync or exec service.
+ */
+class FakeAdbConnection: public Poco::Net::TCPServerConnection {
+public:
+	FakeAdbConnection(const Poco::Net::StreamSocket& socket) :
+			Poco::Net::TCPServerConnection(socket) {
+	}
+
+	virtual void run() {
+		Poco::Net::StreamSocket& s = socket();
+		try {
+			std::string request = readRequest(s);
+			if (request != std::string("host:transport:") + SERIAL) {
+				fail(s, "device not found");
+				return;
+			}
+			writeString(s, "OKAY");
+
+			request = readRequest(s);
+			if (request == "sync:") {
+				writeString(s, "OKAY");
+				runSync(s);
+			} else if (request.compare(0, 5, "exec:") == 0) {
+				writeString(s, "OKAY");
+				runExec(s, request.substr(5));
+			} else {
+				fail(s, "unknown service " + request);
+			}
+		} catch (Poco::Exception& e) {
+			// the client went away.
+		}
+	}
+
+private:
+	static std::string readRequest(Poco::Net::StreamSocket& s) {
+		unsigned char length[4];
+		readFully(s, length, 4);
+		unsigned int size = strtoul(std::string(reinterpret_cast<char*>(length), 4).c_str(), NULL, 16);
+		std::vector<unsigned char> data(size + 1);
+		readFully(s, &data[0], size);
+		return std::string(reinterpret_cast<char*>(&data[0]), size);
+	}
+
+	static void fail(Poco::Net::StreamSocket& s, const std::string& message) {
+		char length[5];
+		sprintf(length, "%04x", (unsigned int) message.length());
+		writeString(s, std::string("FAIL") + length + message);
+	}
+
+	static void runSync(Poco::Net::StreamSocket& s) {
+		std::vector<unsigned char> data(SYNC_DATA_MAX + 8);
+		unsigned char header[8];
+		while (true) {
+			readFully(s, header, 8);
+			unsigned int length = getInt(header + 4);
+			if (memcmp(header, "QUIT", 4) == 0) {
+				return;
+			}
+			if (length > SYNC_DATA_MAX) {
+				throw Poco::IOException("request too long");
+			}
+			readFully(s, &data[0], length);
+			std::string path(reinterpret_cast<char*>(&data[0]), length);
+
+			if (memcmp(header, "SEND", 4) == 0) {
+				// the content is dropped.
+				while (true) {
+					readFully(s, header, 8);
+					length = getInt(header + 4);
+					if (memcmp(header, "DONE", 4) == 0) {
+						break;
+					}
+					if (memcmp(header, "DATA", 4) != 0 || length > SYNC_DATA_MAX) {
+						throw Poco::IOException("bad SEND data");
+					}
+					readFully(s, &data[0], length);
+				}
+				writeReply(s, "OKAY", 0);
+			} else if (memcmp(header, "RECV", 4) == 0) {
+				sendFile(s, path, data);
+			} else if (memcmp(header, "STAT", 4) == 0) {
+				Poco::File f(toLocalPath(path));
+				unsigned int mode = 0;
+				unsigned int size = 0;
+				if (f.exists()) {
+					mode = f.isDirectory() ? 040755 : 0100644;
+					size = f.isDirectory() ? 0 : (unsigned int) f.getSize();
+				}
+				// mode, size and modification time.
+				writeReply(s, "STAT", mode);
+				putInt(&data[0], size);
+				putInt(&data[4], 0);
+				writeFully(s, &data[0], 8);
+			} else {
+				throw Poco::IOException("unknown sync request");
+			}
+		}
+	}
+
+	static void sendFile(Poco::Net::StreamSocket& s, const std::string& path, std::vector<unsigned char>& data) {
+		std::string localPath = toLocalPath(path);
+		if (!Poco::File(localPath).exists()) {
+			std::string message = "No such file or directory";
+			writeReply(s, "FAIL", (unsigned int) message.length());
+			writeString(s, message);
+			return;
+		}
+		Poco::FileInputStream in(localPath, std::ios::in | std::ios::binary);
+		while (true) {
+			in.read(reinterpret_cast<char*>(&data[8]), SYNC_DATA_MAX);
+			unsigned int count = (unsigned int) in.gcount();
+			if (count == 0) {
+				break;
+			}
+			memcpy(&data[0], "DATA", 4);
+			putInt(&data[4], count);
+			writeFully(s, &data[0], count + 8);
+		}
+		writeReply(s, "DONE", 0);
+	}
+
+	static void runExec(Poco::Net::StreamSocket& s, const std::string& command) {
+		std::vector<std::string> words = getQuotedWords(command);
+		if (command.find("tar -xf -") != std::string::npos) {
+			consumeArchive(s);
+		} else if (command.find("tar -cf -") != std::string::npos && !words.empty()) {
+			// cd '<parent>' && tar -cf - '<name>'...
+			std::string parent = toLocalPath(words[0]);
+			ArchiveWriter writer(s);
+			for (size_t i = 1; i < words.size(); ++i) {
+				writer.add(Poco::File(parent + "/" + words[i]), words[i]);
+			}
+			writer.finish();
+		} else {
+			writeString(s, "unsupported command\n");
+			writeString(s, "ddmlib-tar-status:1\n");
+			s.shutdown();
+			return;
+		}
+		writeString(s, "ddmlib-tar-status:0\n");
+		s.shutdown();
+	}
+};
+
+/**
+ * Creates <var>count</var> files of 64 bytes to 4 KiB below <var>root</var>.
+ * @return the paths of the files, relative to <var>root</var>.
+ */
+std::vector<std::string> createTree(const std::string& root, int count) {
+	std::vector<std::string> files;
+	std::vector<char> content(4096);
+	for (size_t i = 0; i < content.size(); ++i) {
+		content[i] = (char) ('a' + i % 26);
+	}
+
+	unsigned int seed = 12345;
+	for (int i = 0; i < count; ++i) {
+		std::string dir = "d" + Poco::NumberFormatter::format0(i / FILES_PER_DIRECTORY, 4);
+		if (i % FILES_PER_DIRECTORY == 0) {
+			Poco::File(root + "/" + dir).createDirectories();
+		}
+		std::string name = dir + "/f" + Poco::NumberFormatter::format0(i % FILES_PER_DIRECTORY, 4) + ".bin";
+		seed = seed * 1103515245 + 12345;
+		size_t size = 64 + (seed >> 8) % (content.size() - 64);
+		Poco::FileOutputStream out(root + "/" + name, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.write(&content[0], (std::streamsize) size);
+		files.push_back(name);
+	}
+	return files;
+}
+
+std::tr1::shared_ptr<FileListingService::FileEntry> getRemoteDirectory(const std::string& name) {
+	std::tr1::shared_ptr<FileListingService::FileEntry> root(new FileListingService::FileEntry(
+			std::tr1::shared_ptr<FileListingService::FileEntry>(), "", FileListingService::TYPE_DIRECTORY, true));
+	std::tr1::shared_ptr<FileListingService::FileEntry> bench(new FileListingService::FileEntry(root,
+			std::string(REMOTE_ROOT).substr(1), FileListingService::TYPE_DIRECTORY, false));
+	return std::tr1::shared_ptr<FileListingService::FileEntry>(new FileListingService::FileEntry(bench, name,
+			FileListingService::TYPE_DIRECTORY, false));
+}
+
+void report(const std::string& name, const Poco::Timestamp& start, int files, long long bytes) {
+	double seconds = (double) start.elapsed() / 1000000.0;
+	char line[160];
+	sprintf(line, "%-22s %8.3f s %10.0f files/s %8.1f MiB/s", name.c_str(), seconds, files / seconds,
+			bytes / seconds / (1024.0 * 1024.0));
+	std::cout << line << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	int fileCount = argc > 1 ? atoi(argv[1]) : 50000;
+
+	Log::setLevel(Log::WARN_L.getPriority());
+
+	Poco::Path work(Poco::Path::temp());
+	work.pushDirectory("ddmlib-tar-benchmark");
+	Poco::File workDir(work);
+	if (workDir.exists()) {
+		workDir.remove(true);
+	}
+	sDeviceRoot = work.toString();
+	sDeviceRoot.erase(sDeviceRoot.length() - 1);
+
+	std::string tree = sDeviceRoot + "/tree";
+	std::cout << "creating " << fileCount << " files in " << tree << std::endl;
+	std::vector<std::string> files = createTree(tree, fileCount);
+	long long bytes = 0;
+	for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+		bytes += (long long) Poco::File(tree + "/" + *f).getSize();
+	}
+
+	Poco::Net::ServerSocket serverSocket(Poco::Net::SocketAddress("127.0.0.1", 0));
+	Poco::Net::TCPServer server(new Poco::Net::TCPServerConnectionFactoryImpl<FakeAdbConnection>(), serverSocket);
+	server.start();
+	AdbServerAddress address(Poco::Net::SocketAddress("127.0.0.1", serverSocket.address().port()));
+
+	int result = 0;
+	try {
+		std::tr1::shared_ptr<DeviceMonitor> monitor(new DeviceMonitor(std::tr1::shared_ptr<AndroidDebugBridge>(), address));
+		std::tr1::shared_ptr<Device> device(new Device(monitor, SERIAL, "device"));
+		NullSyncProgressMonitor progress;
+
+		std::vector<std::string> local(1, tree);
+		std::tr1::shared_ptr<FileListingService::FileEntry> in = getRemoteDirectory("in");
+
+		{
+			std::tr1::shared_ptr<SyncService> sync = device->getSyncService();
+			Poco::Timestamp start;
+			sync->push(local, in, &progress);
+			report("push, per file", start, fileCount, bytes);
+		}
+		{
+			std::tr1::shared_ptr<SyncService> sync = device->getSyncService();
+			Poco::Timestamp start;
+			sync->pushArchive(local, in, &progress);
+			report("push, archive", start, fileCount, bytes);
+		}
+
+		{
+			std::string dest = sDeviceRoot + "/pull-files";
+			std::vector<std::string> remotePaths;
+			std::vector<std::string> localPaths;
+			for (std::vector<std::string>::const_iterator f = files.begin(); f != files.end(); ++f) {
+				remotePaths.push_back(std::string(REMOTE_ROOT) + "/tree/" + *f);
+				localPaths.push_back(dest + "/tree/" + *f);
+				if (remotePaths.size() % FILES_PER_DIRECTORY == 1) {
+					Poco::File(Poco::Path(localPaths.back()).parent()).createDirectories();
+				}
+			}
+
+			std::tr1::shared_ptr<SyncService> sync = device->getSyncService();
+			Poco::Timestamp start;
+			sync->pullFiles(remotePaths, localPaths, &progress);
+			report("pull, per file", start, fileCount, bytes);
+		}
+		{
+			std::string dest = sDeviceRoot + "/pull-archive";
+			Poco::File(dest).createDirectories();
+			std::vector<std::tr1::shared_ptr<FileListingService::FileEntry> > entries(1, getRemoteDirectory("tree"));
+
+			std::tr1::shared_ptr<SyncService> sync = device->getSyncService();
+			Poco::Timestamp start;
+			sync->pullArchive(entries, dest, &progress);
+			report("pull, archive", start, fileCount, bytes);
+		}
+	} catch (std::exception& e) {
+		std::cerr << "benchmark failed: " << e.what() << std::endl;
+		result = 1;
+	}
+
+	server.stop();
+	workDir.remove(true);
+	return result;
+}